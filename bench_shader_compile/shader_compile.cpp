@@ -0,0 +1,490 @@
+// Include GLEW
+#include <GL/glew.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <common/shader.hpp>
+#include <common/main.h>
+#include <common/scene.h>
+#include <common/harness.h>
+#include <common/benchmark.h>
+
+#ifdef _WIN32
+#include <common/_getopt.h>
+#else
+#ifdef LINUX
+#include <getopt.h>
+#endif
+#endif
+
+namespace bench_shader_compile {
+
+// Compile/link latency of every shader in the tree. Every stage file of the test
+// directories is discovered, every VS[/TCS+TES][/GS]/FS combination of a directory that
+// compiles and links is built --iterations times cold and warm, and the compile time of
+// each stage, the link time and the time of the first draw (drivers finish compiling
+// there) go to a CSV file as histograms. Cold builds append a comment unique to the run
+// and iteration, so the driver's shader caches miss; warm builds repeat the source of an
+// untimed first build. The work is done in InitGL; the scene then draws one frame.
+
+static const char* rootDir = "..";
+static const char* csvPath = "shader_compile.csv";
+static int iterations = 5;
+static int verboseFlag = 0;
+
+void ProcessCommandLine(int argc, char* argv[])
+{
+    static struct option long_options[] =
+    {
+        {"verbose",     no_argument,       &verboseFlag, 1},
+        // Directory holding the test directories
+        {"root",        required_argument, 0, 'r'},
+        // Builds per program and mode
+        {"iterations",  required_argument, 0, 'n'},
+        {"csv",         required_argument, 0, 'o'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int c = 0;
+
+    while (1)
+    {
+        /* getopt_long stores the option index here. */
+        int option_index = 0;
+        c = getopt_long(argc, argv, "hn:o:r:v", long_options, &option_index);
+
+        /* Detect the end of the options. */
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+        case 0:
+            /* If this option set a flag, do nothing else now. */
+            break;
+
+        case 'r':
+            rootDir = optarg;
+            break;
+        case 'n':
+            iterations = std::max(atoi(optarg), 1);
+            break;
+        case 'o':
+            csvPath = optarg;
+            break;
+        case 'v':
+            verboseFlag = 1;
+            break;
+
+        case 'h':
+            error("Options:\n"
+                "  --root, -r D       : Directory holding the test directories. Default is '..'.\n"
+                "  --iterations, -n N : Cold and warm builds per program. Default is 5.\n"
+                "  --csv, -o F        : Histogram CSV file. Default is shader_compile.csv.\n"
+                "  --verbose, -v      : Log every program and why combinations are skipped.\n"
+                "  --help, -h         : Print this help.\n");
+            break;
+
+        case '?':
+            /* getopt_long already printed an error message. */
+            break;
+
+        default:
+            error("Internal errors when calling getopt_long()");
+        }
+    }
+
+    // A benchmark, not an animation: stop after the first frame unless told otherwise.
+    if (g_harnessOptions.frames == 0)
+    {
+        g_harnessOptions.frames = 1;
+    }
+}
+
+struct StageType
+{
+    const char* extension;
+    GLenum      type;
+};
+
+// In pipeline order; the index is the stage's slot in a combination.
+static const StageType stageTypes[MAX] =
+{
+    { ".vert", GL_VERTEX_SHADER },
+    { ".tesc", GL_TESS_CONTROL_SHADER },
+    { ".tese", GL_TESS_EVALUATION_SHADER },
+    { ".geom", GL_GEOMETRY_SHADER },
+    { ".frag", GL_FRAGMENT_SHADER },
+};
+
+struct StageFile
+{
+    int         stage;
+    std::string name;               ///< "<test dir>/<file>"
+    std::string source;             ///< #include expanded
+};
+
+struct Combination
+{
+    std::string name;               ///< "<test dir>/VS.vert+...+FS.frag"
+    std::vector<const StageFile*> stages;
+};
+
+struct BuildTimes
+{
+    float64     compileUs[MAX];
+    float64     linkUs;
+    float64     drawUs;
+};
+
+static GLuint VertexArrayID = 0;
+
+static std::vector<std::string> ListDirectory(const std::string& _dir)
+{
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((_dir + "/*").c_str(), &data);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (data.cFileName[0] != '.')
+                names.push_back(data.cFileName);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#else
+    DIR* dir = opendir(_dir.c_str());
+    if (dir)
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            if (entry->d_name[0] != '.')
+                names.push_back(entry->d_name);
+        }
+        closedir(dir);
+    }
+#endif
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static int StageOfFile(const std::string& _name)
+{
+    for (int i = 0; i < MAX; i++)
+    {
+        size_t length = strlen(stageTypes[i].extension);
+        if (_name.size() > length && _name.compare(_name.size() - length, length, stageTypes[i].extension) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Every stage file of every test directory, grouped by directory and stage.
+static void DiscoverShaders(std::vector<StageFile>& _files)
+{
+    std::vector<std::string> dirs = ListDirectory(rootDir);
+    for (size_t i = 0; i < dirs.size(); i++)
+    {
+        if (dirs[i].compare(0, 4, "test") != 0)
+            continue;
+
+        std::vector<std::string> names = ListDirectory(std::string(rootDir) + "/" + dirs[i]);
+        for (size_t j = 0; j < names.size(); j++)
+        {
+            int stage = StageOfFile(names[j]);
+            if (stage < 0)
+                continue;
+
+            StageFile file;
+            file.stage = stage;
+            file.name = dirs[i] + "/" + names[j];
+            file.source = ShaderVariantSource(std::string(rootDir) + "/" + file.name, std::string());
+            _files.push_back(file);
+        }
+    }
+}
+
+// VS+FS, VS+GS+FS, VS+TCS+TES+FS and VS+TCS+TES+GS+FS of every file of a directory;
+// which of them actually link is found out by building them.
+static void EnumerateCombinations(const std::vector<StageFile>& _files, std::vector<Combination>& _combinations)
+{
+    size_t begin = 0;
+    while (begin < _files.size())
+    {
+        std::string dir = _files[begin].name.substr(0, _files[begin].name.find('/'));
+        std::vector<const StageFile*> byStage[MAX];
+        size_t end = begin;
+        for (; end < _files.size() && _files[end].name.compare(0, dir.size() + 1, dir + "/") == 0; end++)
+        {
+            byStage[_files[end].stage].push_back(&_files[end]);
+        }
+        begin = end;
+
+        // A missing optional stage is one more choice: "none".
+        byStage[TESS_CONTROL].insert(byStage[TESS_CONTROL].begin(), (const StageFile*)NULL);
+        byStage[GEOMETRY].insert(byStage[GEOMETRY].begin(), (const StageFile*)NULL);
+        byStage[TESS_EVALUATION].insert(byStage[TESS_EVALUATION].begin(), (const StageFile*)NULL);
+
+        for (size_t vs = 0; vs < byStage[VERTEX].size(); vs++)
+        for (size_t tcs = 0; tcs < byStage[TESS_CONTROL].size(); tcs++)
+        for (size_t tes = 0; tes < byStage[TESS_EVALUATION].size(); tes++)
+        for (size_t gs = 0; gs < byStage[GEOMETRY].size(); gs++)
+        for (size_t fs = 0; fs < byStage[FRAGMENT].size(); fs++)
+        {
+            // Both tessellation stages or neither.
+            if ((tcs == 0) != (tes == 0))
+                continue;
+
+            const StageFile* pStages[MAX] = { byStage[VERTEX][vs], byStage[TESS_CONTROL][tcs],
+                                              byStage[TESS_EVALUATION][tes], byStage[GEOMETRY][gs],
+                                              byStage[FRAGMENT][fs] };
+            Combination combination;
+            combination.name = dir + "/";
+            for (int i = 0; i < MAX; i++)
+            {
+                if (!pStages[i])
+                    continue;
+                if (!combination.stages.empty())
+                    combination.name += "+";
+                combination.name += pStages[i]->name.substr(dir.size() + 1);
+                combination.stages.push_back(pStages[i]);
+            }
+            _combinations.push_back(combination);
+        }
+    }
+}
+
+// One build: compile every stage, link, draw a triangle (a patch with tessellation) and
+// wait for it. Every step waits for its status, so the times include compiler threads.
+// _suffix is appended to every source. False if a stage failed or the link failed.
+static bool Build(const Combination& _combination, const std::string& _suffix, BuildTimes& _times)
+{
+    memset(&_times, 0, sizeof(_times));
+    GLuint program = glCreateProgram();
+    std::vector<GLuint> shaders;
+    bool built = true;
+    bool tessellated = false;
+    for (size_t i = 0; i < _combination.stages.size() && built; i++)
+    {
+        const StageFile* pStage = _combination.stages[i];
+        std::string source = pStage->source + _suffix;
+        const char* sourcePointer = source.c_str();
+
+        uint64 begin = GetTimeNs();
+        GLuint shader = glCreateShader(stageTypes[pStage->stage].type);
+        glShaderSource(shader, 1, &sourcePointer, NULL);
+        glCompileShader(shader);
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        _times.compileUs[pStage->stage] = float64(GetTimeNs() - begin) / 1000.0;
+
+        glAttachShader(program, shader);
+        shaders.push_back(shader);
+        built = status == GL_TRUE;
+        tessellated = tessellated || pStage->stage == TESS_CONTROL;
+    }
+
+    if (built)
+    {
+        uint64 begin = GetTimeNs();
+        glLinkProgram(program);
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        _times.linkUs = float64(GetTimeNs() - begin) / 1000.0;
+        built = status == GL_TRUE;
+    }
+
+    if (built)
+    {
+        uint64 begin = GetTimeNs();
+        glUseProgram(program);
+        glDrawArrays(tessellated ? GL_PATCHES : GL_TRIANGLES, 0, 3);
+        glFinish();
+        _times.drawUs = float64(GetTimeNs() - begin) / 1000.0;
+        glUseProgram(0);
+    }
+
+    for (size_t i = 0; i < shaders.size(); i++)
+    {
+        glDetachShader(program, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
+    glDeleteProgram(program);
+    return built;
+}
+
+// Histogram buckets, upper bounds in microseconds; the last column counts the rest.
+static const float64 bucketsUs[] = { 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000 };
+
+/// Samples of one measure: "compile:vert".."compile:frag", "compile" (all stages), "link" or "first-draw".
+typedef std::map<std::string, std::vector<float64> > MeasureSamples;
+
+static void AddBuild(MeasureSamples& _samples, const Combination& _combination, const char* _mode, const BuildTimes& _times)
+{
+    std::string mode = std::string(_mode) + ",";
+    float64 compileUs = 0.0;
+    for (size_t i = 0; i < _combination.stages.size(); i++)
+    {
+        int stage = _combination.stages[i]->stage;
+        _samples[mode + "compile:" + (stageTypes[stage].extension + 1)].push_back(_times.compileUs[stage]);
+        compileUs += _times.compileUs[stage];
+    }
+    _samples[mode + "compile"].push_back(compileUs);
+    _samples[mode + "link"].push_back(_times.linkUs);
+    _samples[mode + "first-draw"].push_back(_times.drawUs);
+}
+
+static float64 Median(std::vector<float64> _samples)
+{
+    if (_samples.empty())
+        return 0.0;
+    std::sort(_samples.begin(), _samples.end());
+    return _samples[_samples.size() / 2];
+}
+
+// One row per mode and measure: count, min, median, mean, max and the bucket counts.
+static void WriteRows(FILE* _file, const std::string& _program, const MeasureSamples& _samples)
+{
+    for (MeasureSamples::const_iterator it = _samples.begin(); it != _samples.end(); ++it)
+    {
+        std::vector<float64> sorted = it->second;
+        std::sort(sorted.begin(), sorted.end());
+        float64 sum = 0.0;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            sum += sorted[i];
+        }
+        fprintf(_file, "%s,%s,%u,%.1f,%.1f,%.1f,%.1f", _program.c_str(), it->first.c_str(), uint32(sorted.size()),
+                sorted.front(), sorted[sorted.size() / 2], sum / sorted.size(), sorted.back());
+
+        size_t next = 0;
+        for (size_t b = 0; b <= ArraySize(bucketsUs); b++)
+        {
+            size_t count = 0;
+            while (next < sorted.size() && (b == ArraySize(bucketsUs) || sorted[next] <= bucketsUs[b]))
+            {
+                next++;
+                count++;
+            }
+            fprintf(_file, ",%u", uint32(count));
+        }
+        fprintf(_file, "\n");
+    }
+}
+
+bool InitGL(size_t Width, size_t Height)
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // Attribute-less draws still need a vertex array in a core profile.
+    glGenVertexArrays(1, &VertexArrayID);
+    glBindVertexArray(VertexArrayID);
+    glPatchParameteri(GL_PATCH_VERTICES, 3);
+
+    std::vector<StageFile> files;
+    DiscoverShaders(files);
+    std::vector<Combination> combinations;
+    EnumerateCombinations(files, combinations);
+    log("Shader compile benchmark: %u stage files under '%s', %u combinations, %d iterations",
+        uint32(files.size()), rootDir, uint32(combinations.size()), iterations);
+
+    FILE* file = 0;
+    fopen_s(&file, csvPath, "w");
+    if (!file)
+    {
+        error("Unable to write '%s'", csvPath);
+    }
+    fprintf(file, "program,mode,measure,count,min_us,median_us,mean_us,max_us");
+    for (size_t b = 0; b < ArraySize(bucketsUs); b++)
+    {
+        fprintf(file, ",le_%.0fus", bucketsUs[b]);
+    }
+    fprintf(file, ",gt_%.0fus\n", bucketsUs[ArraySize(bucketsUs) - 1]);
+
+    // Unique per run, so cold sources miss even a driver cache persisted by earlier runs.
+    unsigned long long runId = (unsigned long long)GetTimeNs();
+    MeasureSamples totals;
+    uint32 built = 0;
+    for (size_t i = 0; i < combinations.size(); i++)
+    {
+        const Combination& combination = combinations[i];
+        BuildTimes times;
+        if (!Build(combination, std::string(), times))
+        {
+            if (verboseFlag)
+                log("  skipped %s: does not compile or link", combination.name.c_str());
+            continue;
+        }
+
+        MeasureSamples samples;
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            char suffix[64];
+            snprintf(suffix, sizeof(suffix), "\n// cold build %llx.%u.%d\n", runId, uint32(i), iteration);
+            Build(combination, suffix, times);
+            AddBuild(samples, combination, "cold", times);
+            AddBuild(totals, combination, "cold", times);
+
+            Build(combination, std::string(), times);
+            AddBuild(samples, combination, "warm", times);
+            AddBuild(totals, combination, "warm", times);
+        }
+        WriteRows(file, combination.name, samples);
+        built++;
+
+        if (verboseFlag)
+        {
+            log("  %s: cold compile %.0f us link %.0f us draw %.0f us, warm %.0f / %.0f / %.0f us",
+                combination.name.c_str(), Median(samples["cold,compile"]), Median(samples["cold,link"]),
+                Median(samples["cold,first-draw"]), Median(samples["warm,compile"]), Median(samples["warm,link"]),
+                Median(samples["warm,first-draw"]));
+        }
+    }
+    WriteRows(file, "all", totals);
+    fclose(file);
+
+    log("Shader compile benchmark: %u programs built, %u skipped; histograms in '%s'",
+        built, uint32(combinations.size()) - built, csvPath);
+    const char* modes[] = { "cold", "warm" };
+    for (size_t i = 0; i < ArraySize(modes); i++)
+    {
+        std::string mode = std::string(modes[i]) + ",";
+        log("  %s: median compile %.0f us, link %.0f us, first draw %.0f us per program", modes[i],
+            Median(totals[mode + "compile"]), Median(totals[mode + "link"]), Median(totals[mode + "first-draw"]));
+    }
+    return true;
+}
+
+void ReSizeGLScene(size_t Width, size_t Height)
+{
+    glViewport(0, 0, GLsizei(Width), GLsizei(Height));
+}
+
+void DrawGLScene(void)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void DeInitGL(void)
+{
+    glDeleteVertexArrays(1, &VertexArrayID);
+    return;
+}
+
+} // namespace bench_shader_compile
+
+REGISTER_SCENE(bench_shader_compile);
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+#include "benchmark.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------
+uint64 GetTimeNs()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return uint64(float64(counter.QuadPart) * 1e9 / float64(frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64(ts.tv_sec) * 1000000000ull + uint64(ts.tv_nsec);
+#endif
+}
+
+void WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', file);
+        if ((unsigned char)*str >= 0x20)
+            fputc(*str, file);
+    }
+    fputc('"', file);
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void FrameStatsReset(FrameStats& stats, uint32 warmupFrames, uint32 expectedFrames)
+{
+    stats.frameMs.clear();
+    stats.frameMs.reserve(expectedFrames);
+    stats.lastFrameNs = 0;
+    stats.warmupLeft = warmupFrames;
+}
+
+uint32 FrameStatsTick(FrameStats& stats)
+{
+    uint64 now = GetTimeNs();
+
+    // The first tick only starts the clock: an interval needs two frame boundaries.
+    if (stats.lastFrameNs != 0)
+    {
+        if (stats.warmupLeft > 0)
+        {
+            stats.warmupLeft--;
+        }
+        else
+        {
+            stats.frameMs.push_back(float64(now - stats.lastFrameNs) * 1e-6);
+        }
+    }
+    stats.lastFrameNs = now;
+
+    return uint32(stats.frameMs.size());
+}
+
+// Nearest-rank percentile of an already sorted array.
+static float64 Percentile(const std::vector<float64>& sorted, float64 percent)
+{
+    size_t rank = size_t(ceil(percent / 100.0 * float64(sorted.size())));
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+FrameStatsSummary FrameStatsSummarize(const FrameStats& stats)
+{
+    FrameStatsSummary summary = {};
+    summary.frames = uint32(stats.frameMs.size());
+    if (summary.frames == 0)
+    {
+        return summary;
+    }
+
+    std::vector<float64> sorted(stats.frameMs);
+    std::sort(sorted.begin(), sorted.end());
+
+    float64 total = 0.0;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        total += sorted[i];
+    }
+
+    summary.meanMs = total / float64(summary.frames);
+    summary.medianMs = Percentile(sorted, 50.0);
+    summary.p95Ms = Percentile(sorted, 95.0);
+    summary.p99Ms = Percentile(sorted, 99.0);
+    summary.maxMs = sorted.back();
+    summary.fps = total > 0.0 ? float64(summary.frames) * 1000.0 / total : 0.0;
+
+    return summary;
+}
+
+void PrintFrameStats(const char* title, const FrameStatsSummary& summary)
+{
+    log("%s: %u frames", title, summary.frames);
+    if (summary.frames == 0)
+    {
+        return;
+    }
+    log("  frame time mean   : %8.3f ms", summary.meanMs);
+    log("  frame time median : %8.3f ms", summary.medianMs);
+    log("  frame time p95    : %8.3f ms", summary.p95Ms);
+    log("  frame time p99    : %8.3f ms", summary.p99Ms);
+    log("  frame time max    : %8.3f ms", summary.maxMs);
+    log("  FPS               : %8.1f", summary.fps);
+}
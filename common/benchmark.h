@@ -0,0 +1,45 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <stdio.h>
+#include <vector>
+
+#include "main.h"
+
+/// Monotonic wall clock in nanoseconds.
+uint64 GetTimeNs();
+
+/// Quoted, escaped JSON string; control characters are dropped.
+void WriteJsonString(FILE* file, const char* str);
+
+/// Frame time statistics of one benchmark run.
+struct FrameStatsSummary
+{
+    uint32  frames;
+    float64 meanMs;
+    float64 medianMs;
+    float64 p95Ms;
+    float64 p99Ms;
+    float64 maxMs;
+    float64 fps;
+};
+
+/// Collects frame-to-frame intervals; warmup frames are dropped, not recorded. Headless
+/// (EGL) runs keep at most 2 frames in flight, or finish every frame with --finish, so an
+/// interval is a frame of GPU work and not just the time to queue it.
+struct FrameStats
+{
+    std::vector<float64> frameMs;
+    uint64 lastFrameNs;
+    uint32 warmupLeft;
+};
+
+void FrameStatsReset(FrameStats& stats, uint32 warmupFrames, uint32 expectedFrames);
+
+/// Call once per presented frame; returns the number of measured frames so far.
+uint32 FrameStatsTick(FrameStats& stats);
+
+FrameStatsSummary FrameStatsSummarize(const FrameStats& stats);
+void PrintFrameStats(const char* title, const FrameStatsSummary& summary);
+
+#endif
@@ -0,0 +1,332 @@
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+
+#include "caps.h"
+#include "benchmark.h"
+#include "profiler.h"
+#include "hash.h"
+
+enum CapsLimitType
+{
+    CAPS_INT,
+    CAPS_INT_PAIR,      ///< two components (GL_MAX_VIEWPORT_DIMS)
+    CAPS_INT64,
+    CAPS_FLOAT,         ///< stored truncated
+};
+
+struct CapsLimit
+{
+    GLenum          pname;
+    const char*     name;
+    uint32          version;    ///< major * 10 + minor that introduced it
+    const char*     extension;  ///< alternative to the version, or NULL
+    CapsLimitType   type;
+};
+
+static const CapsLimit limitTable[] =
+{
+    { GL_MAX_TEXTURE_SIZE,                          "GL_MAX_TEXTURE_SIZE",                          10, NULL, CAPS_INT },
+    { GL_MAX_3D_TEXTURE_SIZE,                       "GL_MAX_3D_TEXTURE_SIZE",                       12, NULL, CAPS_INT },
+    { GL_MAX_CUBE_MAP_TEXTURE_SIZE,                 "GL_MAX_CUBE_MAP_TEXTURE_SIZE",                 13, NULL, CAPS_INT },
+    { GL_MAX_ARRAY_TEXTURE_LAYERS,                  "GL_MAX_ARRAY_TEXTURE_LAYERS",                  30, NULL, CAPS_INT },
+    { GL_MAX_TEXTURE_BUFFER_SIZE,                   "GL_MAX_TEXTURE_BUFFER_SIZE",                   31, NULL, CAPS_INT },
+    { GL_MAX_RECTANGLE_TEXTURE_SIZE,                "GL_MAX_RECTANGLE_TEXTURE_SIZE",                31, NULL, CAPS_INT },
+    { GL_MAX_TEXTURE_LOD_BIAS,                      "GL_MAX_TEXTURE_LOD_BIAS",                      14, NULL, CAPS_FLOAT },
+    { GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT,            "GL_MAX_TEXTURE_MAX_ANISOTROPY",                46, "GL_EXT_texture_filter_anisotropic", CAPS_FLOAT },
+    { GL_MAX_RENDERBUFFER_SIZE,                     "GL_MAX_RENDERBUFFER_SIZE",                     30, NULL, CAPS_INT },
+    { GL_MAX_SAMPLES,                               "GL_MAX_SAMPLES",                               30, NULL, CAPS_INT },
+    { GL_MAX_COLOR_TEXTURE_SAMPLES,                 "GL_MAX_COLOR_TEXTURE_SAMPLES",                 32, NULL, CAPS_INT },
+    { GL_MAX_DEPTH_TEXTURE_SAMPLES,                 "GL_MAX_DEPTH_TEXTURE_SAMPLES",                 32, NULL, CAPS_INT },
+    { GL_MAX_INTEGER_SAMPLES,                       "GL_MAX_INTEGER_SAMPLES",                       32, NULL, CAPS_INT },
+    { GL_MAX_SAMPLE_MASK_WORDS,                     "GL_MAX_SAMPLE_MASK_WORDS",                     32, NULL, CAPS_INT },
+    { GL_MAX_COLOR_ATTACHMENTS,                     "GL_MAX_COLOR_ATTACHMENTS",                     30, NULL, CAPS_INT },
+    { GL_MAX_DRAW_BUFFERS,                          "GL_MAX_DRAW_BUFFERS",                          20, NULL, CAPS_INT },
+    { GL_MAX_FRAMEBUFFER_WIDTH,                     "GL_MAX_FRAMEBUFFER_WIDTH",                     43, NULL, CAPS_INT },
+    { GL_MAX_FRAMEBUFFER_HEIGHT,                    "GL_MAX_FRAMEBUFFER_HEIGHT",                    43, NULL, CAPS_INT },
+    { GL_MAX_FRAMEBUFFER_SAMPLES,                   "GL_MAX_FRAMEBUFFER_SAMPLES",                   43, NULL, CAPS_INT },
+    { GL_MAX_VIEWPORT_DIMS,                         "GL_MAX_VIEWPORT_DIMS",                         10, NULL, CAPS_INT_PAIR },
+    { GL_MAX_VIEWPORTS,                             "GL_MAX_VIEWPORTS",                             41, NULL, CAPS_INT },
+    { GL_MAX_CLIP_DISTANCES,                        "GL_MAX_CLIP_DISTANCES",                        30, NULL, CAPS_INT },
+    { GL_MAX_ELEMENTS_VERTICES,                     "GL_MAX_ELEMENTS_VERTICES",                     12, NULL, CAPS_INT },
+    { GL_MAX_ELEMENTS_INDICES,                      "GL_MAX_ELEMENTS_INDICES",                      12, NULL, CAPS_INT },
+    { GL_MAX_VERTEX_ATTRIBS,                        "GL_MAX_VERTEX_ATTRIBS",                        20, NULL, CAPS_INT },
+    { GL_MAX_VERTEX_ATTRIB_BINDINGS,                "GL_MAX_VERTEX_ATTRIB_BINDINGS",                43, NULL, CAPS_INT },
+    { GL_MAX_VERTEX_UNIFORM_COMPONENTS,             "GL_MAX_VERTEX_UNIFORM_COMPONENTS",             20, NULL, CAPS_INT },
+    { GL_MAX_FRAGMENT_UNIFORM_COMPONENTS,           "GL_MAX_FRAGMENT_UNIFORM_COMPONENTS",           20, NULL, CAPS_INT },
+    { GL_MAX_VARYING_COMPONENTS,                    "GL_MAX_VARYING_COMPONENTS",                    30, NULL, CAPS_INT },
+    { GL_MAX_UNIFORM_LOCATIONS,                     "GL_MAX_UNIFORM_LOCATIONS",                     43, NULL, CAPS_INT },
+    { GL_MAX_UNIFORM_BUFFER_BINDINGS,               "GL_MAX_UNIFORM_BUFFER_BINDINGS",               31, NULL, CAPS_INT },
+    { GL_MAX_UNIFORM_BLOCK_SIZE,                    "GL_MAX_UNIFORM_BLOCK_SIZE",                    31, NULL, CAPS_INT },
+    { GL_MAX_VERTEX_UNIFORM_BLOCKS,                 "GL_MAX_VERTEX_UNIFORM_BLOCKS",                 31, NULL, CAPS_INT },
+    { GL_MAX_FRAGMENT_UNIFORM_BLOCKS,               "GL_MAX_FRAGMENT_UNIFORM_BLOCKS",               31, NULL, CAPS_INT },
+    { GL_MAX_GEOMETRY_UNIFORM_BLOCKS,               "GL_MAX_GEOMETRY_UNIFORM_BLOCKS",               32, NULL, CAPS_INT },
+    { GL_MAX_TESS_CONTROL_UNIFORM_BLOCKS,           "GL_MAX_TESS_CONTROL_UNIFORM_BLOCKS",           40, NULL, CAPS_INT },
+    { GL_MAX_TESS_EVALUATION_UNIFORM_BLOCKS,        "GL_MAX_TESS_EVALUATION_UNIFORM_BLOCKS",        40, NULL, CAPS_INT },
+    { GL_MAX_COMBINED_UNIFORM_BLOCKS,               "GL_MAX_COMBINED_UNIFORM_BLOCKS",               31, NULL, CAPS_INT },
+    { GL_MAX_TEXTURE_IMAGE_UNITS,                   "GL_MAX_TEXTURE_IMAGE_UNITS",                   20, NULL, CAPS_INT },
+    { GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS,            "GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS",            20, NULL, CAPS_INT },
+    { GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS,          "GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS",          20, NULL, CAPS_INT },
+    { GL_MAX_GEOMETRY_OUTPUT_VERTICES,              "GL_MAX_GEOMETRY_OUTPUT_VERTICES",              32, NULL, CAPS_INT },
+    { GL_MAX_GEOMETRY_SHADER_INVOCATIONS,           "GL_MAX_GEOMETRY_SHADER_INVOCATIONS",           40, NULL, CAPS_INT },
+    { GL_MAX_PATCH_VERTICES,                        "GL_MAX_PATCH_VERTICES",                        40, NULL, CAPS_INT },
+    { GL_MAX_TESS_GEN_LEVEL,                        "GL_MAX_TESS_GEN_LEVEL",                        40, NULL, CAPS_INT },
+    { GL_MAX_SUBROUTINES,                           "GL_MAX_SUBROUTINES",                           40, NULL, CAPS_INT },
+    { GL_MAX_TRANSFORM_FEEDBACK_BUFFERS,            "GL_MAX_TRANSFORM_FEEDBACK_BUFFERS",            40, NULL, CAPS_INT },
+    { GL_MAX_ATOMIC_COUNTER_BUFFER_BINDINGS,        "GL_MAX_ATOMIC_COUNTER_BUFFER_BINDINGS",        42, NULL, CAPS_INT },
+    { GL_MAX_IMAGE_UNITS,                           "GL_MAX_IMAGE_UNITS",                           42, NULL, CAPS_INT },
+    { GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS,        "GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS",        43, NULL, CAPS_INT },
+    { GL_MAX_SHADER_STORAGE_BLOCK_SIZE,             "GL_MAX_SHADER_STORAGE_BLOCK_SIZE",             43, NULL, CAPS_INT64 },
+    { GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS,        "GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS",        43, NULL, CAPS_INT },
+    { GL_MAX_COMPUTE_SHARED_MEMORY_SIZE,            "GL_MAX_COMPUTE_SHARED_MEMORY_SIZE",            43, NULL, CAPS_INT },
+    { GL_MAX_SERVER_WAIT_TIMEOUT,                   "GL_MAX_SERVER_WAIT_TIMEOUT",                   32, NULL, CAPS_INT64 },
+    { GL_MAX_LABEL_LENGTH,                          "GL_MAX_LABEL_LENGTH",                          43, "GL_KHR_debug", CAPS_INT },
+    { GL_MAX_DEBUG_MESSAGE_LENGTH,                  "GL_MAX_DEBUG_MESSAGE_LENGTH",                  43, "GL_KHR_debug", CAPS_INT },
+    { GL_NUM_PROGRAM_BINARY_FORMATS,                "GL_NUM_PROGRAM_BINARY_FORMATS",                41, "GL_ARB_get_program_binary", CAPS_INT },
+    { GL_NUM_SHADER_BINARY_FORMATS,                 "GL_NUM_SHADER_BINARY_FORMATS",                 41, NULL, CAPS_INT },
+};
+
+struct CapsLimitValue
+{
+    bool    supported;
+    int64   value[2];
+};
+
+// Open-addressing set of extension names keyed by a 64-bit FNV-1a hash.
+struct ExtensionSet
+{
+    std::vector<std::string>    names;
+    std::vector<uint64>         hashes;     ///< parallel to names
+    std::vector<uint32>         slots;      ///< index + 1 into names, 0 = empty
+};
+
+struct WindowSystemInfo
+{
+    std::string name;
+    std::string version;
+    std::string extensions;
+};
+
+static CapsInfo info;
+static std::string vendor, renderer, version, glslVersion;
+static ExtensionSet glExtensions;
+static ExtensionSet winsysExtensions;
+static WindowSystemInfo winsys;
+static CapsLimitValue limitValues[ArraySize(limitTable)];
+static std::unordered_map<GLenum, uint32> limitIndex;
+
+// ----------------------------------------------------------------------------------------------------------------
+static void BuildExtensionSet(ExtensionSet& _set)
+{
+    size_t size = 16;
+    while (size < _set.names.size() * 2)
+        size *= 2;
+    _set.slots.assign(size, 0);
+    _set.hashes.resize(_set.names.size());
+
+    for (size_t i = 0; i < _set.names.size(); i++)
+    {
+        uint64 hash = Fnv1a64String(_set.names[i].c_str());
+        _set.hashes[i] = hash;
+        size_t slot = size_t(hash) & (size - 1);
+        while (_set.slots[slot])
+            slot = (slot + 1) & (size - 1);
+        _set.slots[slot] = uint32(i + 1);
+    }
+}
+
+static bool FindExtension(const ExtensionSet& _set, const char* _name)
+{
+    if (_set.slots.empty())
+        return false;
+
+    uint64 hash = Fnv1a64String(_name);
+    size_t mask = _set.slots.size() - 1;
+    for (size_t slot = size_t(hash) & mask; _set.slots[slot]; slot = (slot + 1) & mask)
+    {
+        uint32 index = _set.slots[slot] - 1;
+        if (_set.hashes[index] == hash && _set.names[index] == _name)
+            return true;
+    }
+    return false;
+}
+
+static void SplitExtensions(const char* _string, ExtensionSet& _set)
+{
+    _set.names.clear();
+    const char* p = _string ? _string : "";
+    while (*p)
+    {
+        while (*p == ' ')
+            p++;
+        const char* begin = p;
+        while (*p && *p != ' ')
+            p++;
+        if (p > begin)
+            _set.names.push_back(std::string(begin, p));
+    }
+    BuildExtensionSet(_set);
+}
+
+static const char* GetString(GLenum _name)
+{
+    const GLubyte* pString = glGetString(_name);
+    return pString ? (const char*)pString : "";
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void CapsSetWindowSystem(const char* _name, const char* _version, const char* _extensions)
+{
+    winsys.name = _name ? _name : "";
+    winsys.version = _version ? _version : "";
+    winsys.extensions = _extensions ? _extensions : "";
+    SplitExtensions(winsys.extensions.c_str(), winsysExtensions);
+}
+
+void CapsInit()
+{
+    PROFILE_SCOPE("CapsInit");
+
+    vendor = GetString(GL_VENDOR);
+    renderer = GetString(GL_RENDERER);
+    version = GetString(GL_VERSION);
+    glslVersion = GetString(GL_SHADING_LANGUAGE_VERSION);
+    info.vendor = vendor.c_str();
+    info.renderer = renderer.c_str();
+    info.version = version.c_str();
+    info.glslVersion = glslVersion.c_str();
+    info.major = info.minor = info.contextFlags = info.profileMask = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &info.major);
+    glGetIntegerv(GL_MINOR_VERSION, &info.minor);
+    glGetIntegerv(GL_CONTEXT_FLAGS, &info.contextFlags);
+    if (info.major * 10 + info.minor >= 32)
+        glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &info.profileMask);
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    glExtensions.names.resize(count);
+    for (GLint i = 0; i < count; i++)
+    {
+        glExtensions.names[i] = (const char*)glGetStringi(GL_EXTENSIONS, i);
+    }
+    BuildExtensionSet(glExtensions);
+
+    uint32 contextVersion = uint32(info.major * 10 + info.minor);
+    limitIndex.clear();
+    for (uint32 i = 0; i < ArraySize(limitTable); i++)
+    {
+        const CapsLimit& limit = limitTable[i];
+        CapsLimitValue& value = limitValues[i];
+        value.supported = contextVersion >= limit.version || (limit.extension && HasExtension(limit.extension));
+        value.value[0] = value.value[1] = 0;
+        limitIndex[limit.pname] = i;
+        if (!value.supported)
+            continue;
+
+        switch (limit.type)
+        {
+        case CAPS_INT:
+        case CAPS_INT_PAIR:
+        {
+            GLint v[2] = { 0, 0 };
+            glGetIntegerv(limit.pname, v);
+            value.value[0] = v[0];
+            value.value[1] = v[1];
+            break;
+        }
+        case CAPS_INT64:
+        {
+            GLint64 v = 0;
+            glGetInteger64v(limit.pname, &v);
+            value.value[0] = v;
+            break;
+        }
+        case CAPS_FLOAT:
+        {
+            GLfloat v = 0.0f;
+            glGetFloatv(limit.pname, &v);
+            value.value[0] = int64(v);
+            break;
+        }
+        }
+    }
+
+    log("Capabilities: %u GL extensions, %u %s extensions, %u limits",
+        uint32(glExtensions.names.size()), uint32(winsysExtensions.names.size()),
+        winsys.name.empty() ? "window system" : winsys.name.c_str(), uint32(ArraySize(limitTable)));
+}
+
+const CapsInfo& GetCaps()
+{
+    return info;
+}
+
+bool HasExtension(const char* _name)
+{
+    return FindExtension(glExtensions, _name);
+}
+
+bool HasWindowSystemExtension(const char* _name)
+{
+    return FindExtension(winsysExtensions, _name);
+}
+
+int64 GetCapsLimit(uint32 _pname, int64 _default)
+{
+    std::unordered_map<GLenum, uint32>::const_iterator it = limitIndex.find(_pname);
+    if (it == limitIndex.end() || !limitValues[it->second].supported)
+        return _default;
+    return limitValues[it->second].value[0];
+}
+
+static void WriteExtensionArray(FILE* _file, const ExtensionSet& _set)
+{
+    fprintf(_file, "[");
+    for (size_t i = 0; i < _set.names.size(); i++)
+    {
+        fprintf(_file, "%s", i ? ", " : "");
+        WriteJsonString(_file, _set.names[i].c_str());
+    }
+    fprintf(_file, "]");
+}
+
+void WriteCapsJson(FILE* _file)
+{
+    fprintf(_file, "{\n    \"vendor\": ");
+    WriteJsonString(_file, info.vendor ? info.vendor : "");
+    fprintf(_file, ",\n    \"renderer\": ");
+    WriteJsonString(_file, info.renderer ? info.renderer : "");
+    fprintf(_file, ",\n    \"version\": ");
+    WriteJsonString(_file, info.version ? info.version : "");
+    fprintf(_file, ",\n    \"glslVersion\": ");
+    WriteJsonString(_file, info.glslVersion ? info.glslVersion : "");
+    fprintf(_file, ",\n    \"major\": %d,\n    \"minor\": %d,\n    \"contextFlags\": %d,\n    \"profileMask\": %d",
+            info.major, info.minor, info.contextFlags, info.profileMask);
+
+    fprintf(_file, ",\n    \"windowSystem\": { \"name\": ");
+    WriteJsonString(_file, winsys.name.c_str());
+    fprintf(_file, ", \"version\": ");
+    WriteJsonString(_file, winsys.version.c_str());
+    fprintf(_file, ", \"extensions\": ");
+    WriteExtensionArray(_file, winsysExtensions);
+    fprintf(_file, " }");
+
+    fprintf(_file, ",\n    \"limits\": {");
+    bool first = true;
+    for (uint32 i = 0; i < ArraySize(limitTable); i++)
+    {
+        if (!limitValues[i].supported)
+            continue;
+        fprintf(_file, "%s\n        \"%s\": ", first ? "" : ",", limitTable[i].name);
+        if (limitTable[i].type == CAPS_INT_PAIR)
+            fprintf(_file, "[%lld, %lld]", (long long)limitValues[i].value[0], (long long)limitValues[i].value[1]);
+        else
+            fprintf(_file, "%lld", (long long)limitValues[i].value[0]);
+        first = false;
+    }
+    fprintf(_file, "\n    },\n    \"extensions\": ");
+    WriteExtensionArray(_file, glExtensions);
+    fprintf(_file, "\n}");
+}
@@ -0,0 +1,46 @@
+#ifndef _CAPS_H_
+#define _CAPS_H_
+
+#include <stdio.h>
+
+#include "main.h"
+
+// GL capability snapshot, captured once right after glewInit: version and driver
+// strings, every GL and window-system extension in a hash set, and the GL_MAX_* limits
+// the scenes care about. Queries are O(1) and never touch the driver. The snapshot is
+// written next to every benchmark result (--results) so numbers can be traced back to
+// the driver and limits they were measured against.
+
+/// Strings of the current context.
+struct CapsInfo
+{
+    const char* vendor;
+    const char* renderer;
+    const char* version;
+    const char* glslVersion;
+    int32       major;
+    int32       minor;
+    int32       contextFlags;
+    int32       profileMask;
+};
+
+/// Window-system name, version and extension string; the backend calls this before
+/// RunScenes(). The strings are copied.
+void CapsSetWindowSystem(const char* _name, const char* _version, const char* _extensions);
+
+/// Take the snapshot. Needs a current context and GLEW.
+void CapsInit();
+
+const CapsInfo& GetCaps();
+
+bool HasExtension(const char* _name);
+bool HasWindowSystemExtension(const char* _name);
+
+/// Value of a snapshotted limit (first component for GL_MAX_VIEWPORT_DIMS);
+/// _default if the limit is not in the table or not supported by the context.
+int64 GetCapsLimit(uint32 _pname, int64 _default = 0);
+
+/// The snapshot as a JSON object.
+void WriteCapsJson(FILE* _file);
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "config_cache.h"
+
+static const size_t kConfigCacheLineSize = 1024;
+
+static void ReadCacheLines(const char* _path, std::vector<std::string>& _lines)
+{
+    FILE* file = 0;
+    fopen_s(&file, _path, "rb");
+    if (!file)
+        return;
+
+    char line[kConfigCacheLineSize];
+    while (fgets(line, sizeof(line), file))
+    {
+        size_t length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        {
+            line[--length] = '\0';
+        }
+        if (length > 0)
+        {
+            _lines.push_back(line);
+        }
+    }
+    fclose(file);
+}
+
+// "<id> <key>": returns the key part, or NULL if the line is malformed.
+static const char* ParseCacheLine(const std::string& _line, uint32& _configId)
+{
+    const char* str = _line.c_str();
+    char* end = NULL;
+    unsigned long id = strtoul(str, &end, 0);
+    if (end == str || *end != ' ')
+        return NULL;
+
+    _configId = uint32(id);
+    return end + 1;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+bool LoadCachedConfigId(const char* _path, const std::string& _key, uint32& _configId)
+{
+    std::vector<std::string> lines;
+    ReadCacheLines(_path, lines);
+
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        uint32 id = 0;
+        const char* key = ParseCacheLine(lines[i], id);
+        if (key && _key == key)
+        {
+            _configId = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+void StoreCachedConfigId(const char* _path, const std::string& _key, uint32 _configId)
+{
+    std::vector<std::string> lines;
+    ReadCacheLines(_path, lines);
+
+    // Per process, so that concurrent runs sharing the cache do not write the same file.
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", int(getpid()));
+    std::string tempPath = std::string(_path) + suffix;
+    FILE* file = 0;
+    fopen_s(&file, tempPath.c_str(), "wb");
+    if (!file)
+    {
+        warn("Unable to write config cache '%s'", tempPath.c_str());
+        return;
+    }
+
+    fprintf(file, "0x%x %s\n", _configId, _key.c_str());
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        uint32 id = 0;
+        const char* key = ParseCacheLine(lines[i], id);
+        if (key && _key != key)
+        {
+            fprintf(file, "%s\n", lines[i].c_str());
+        }
+    }
+    fclose(file);
+
+#ifdef _WIN32
+    remove(_path);  // rename() does not replace on Windows
+#endif
+    if (rename(tempPath.c_str(), _path) != 0)
+    {
+        warn("Unable to replace config cache '%s'", _path);
+        remove(tempPath.c_str());
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef _CONFIG_CACHE_H_
+#define _CONFIG_CACHE_H_
+
+#include <string>
+
+#include "main.h"
+
+// Tiny on-disk cache of the framebuffer config picked on a previous run, so startup can
+// ask the window system for exactly that config instead of searching. One line per key:
+//   <config id> <key>
+// The key names the display, the driver and the requested attributes; a stale entry is
+// harmless, the caller validates the config and falls back to a full search.
+
+/// Look up _key in the cache file; returns false if the file or the key is missing.
+bool LoadCachedConfigId(const char* _path, const std::string& _key, uint32& _configId);
+
+/// Insert or replace _key. The file is rewritten through a temporary and renamed.
+void StoreCachedConfigId(const char* _path, const std::string& _key, uint32 _configId);
+
+#endif
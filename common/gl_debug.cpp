@@ -0,0 +1,183 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gl_debug.h"
+#include "harness.h"
+
+static const size_t kGLDebugReportMessageChars = 96;
+
+struct GLDebugKey
+{
+    GLenum  source;
+    GLenum  type;
+    GLuint  id;
+    GLenum  severity;
+
+    bool operator<(const GLDebugKey& _other) const
+    {
+        if (id != _other.id) return id < _other.id;
+        if (source != _other.source) return source < _other.source;
+        if (type != _other.type) return type < _other.type;
+        return severity < _other.severity;
+    }
+};
+
+struct GLDebugEntry
+{
+    uint64      count;
+    std::string message;        ///< first occurrence
+};
+
+static bool active = false;
+static std::mutex tableMutex;   ///< the driver may call back from its own threads
+static std::map<GLDebugKey, GLDebugEntry> table;
+static std::atomic<uint32> errorCount(0);
+
+static const char* SourceName(GLenum _source)
+{
+    switch (_source)
+    {
+    case GL_DEBUG_SOURCE_API:               return "api";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:     return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER:   return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:       return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION:       return "application";
+    }
+    return "other";
+}
+
+static const char* TypeName(GLenum _type)
+{
+    switch (_type)
+    {
+    case GL_DEBUG_TYPE_ERROR:               return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "undefined";
+    case GL_DEBUG_TYPE_PORTABILITY:         return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE:         return "performance";
+    case GL_DEBUG_TYPE_MARKER:              return "marker";
+    case GL_DEBUG_TYPE_PUSH_GROUP:          return "push group";
+    case GL_DEBUG_TYPE_POP_GROUP:           return "pop group";
+    }
+    return "other";
+}
+
+static const char* SeverityName(GLenum _severity)
+{
+    switch (_severity)
+    {
+    case GL_DEBUG_SEVERITY_HIGH:            return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM:          return "medium";
+    case GL_DEBUG_SEVERITY_LOW:             return "low";
+    }
+    return "notification";
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+static void GLAPIENTRY DebugCallback(GLenum _source, GLenum _type, GLuint _id, GLenum _severity,
+                                     GLsizei _length, const GLchar* _message, const void* _userParam)
+{
+    if (_type == GL_DEBUG_TYPE_ERROR)
+        errorCount++;
+
+    GLDebugKey key = { _source, _type, _id, _severity };
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        GLDebugEntry& entry = table[key];
+        if (entry.count++)
+            return;
+        entry.message.assign(_message, _length >= 0 ? size_t(_length) : strlen(_message));
+    }
+
+    // First occurrence only; repeats just count.
+    if (_type == GL_DEBUG_TYPE_ERROR || _severity == GL_DEBUG_SEVERITY_HIGH)
+    {
+        warn("GL %s %s (%s, id %u): %s", SeverityName(_severity), TypeName(_type), SourceName(_source), _id, _message);
+    }
+    else if (_severity != GL_DEBUG_SEVERITY_NOTIFICATION)
+    {
+        log("GL %s %s (%s, id %u): %s", SeverityName(_severity), TypeName(_type), SourceName(_source), _id, _message);
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void GLDebugInit()
+{
+    if (!GLEW_VERSION_4_3 && !GLEW_KHR_debug)
+    {
+        if (g_harnessOptions.glDebug)
+            warn("--gl-debug: KHR_debug is not available, falling back to glGetError.");
+        return;
+    }
+
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+    {
+        // Without a debug context drivers may stay silent; keep polling glGetError.
+        if (g_harnessOptions.glDebug)
+            warn("--gl-debug: the context is not a debug context, falling back to glGetError.");
+        return;
+    }
+
+    glDebugMessageCallback(DebugCallback, NULL);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+    glEnable(GL_DEBUG_OUTPUT);
+    // CheckError() only compares error counts: the callback must have run for a failing
+    // call before that call returns, or errors arrive late and are blamed on a later check.
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    active = true;
+    log("GL debug output: synchronous callback installed, glGetError checks disabled");
+}
+
+bool IsGLDebugActive()
+{
+    return active;
+}
+
+uint32 GLDebugErrorCount()
+{
+    return errorCount;
+}
+
+void GLDebugReport()
+{
+    if (!active)
+        return;
+
+    std::vector<std::pair<GLDebugKey, GLDebugEntry> > entries;
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        entries.assign(table.begin(), table.end());
+    }
+    uint64 total = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        total += entries[i].second.count;
+    }
+    log("GL debug messages: %u distinct, %llu total", uint32(entries.size()), (unsigned long long)total);
+    if (entries.empty())
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<GLDebugKey, GLDebugEntry>& _a, const std::pair<GLDebugKey, GLDebugEntry>& _b)
+              { return _a.second.count > _b.second.count; });
+
+    log("  %10s  %-12s  %-11s  %-15s  %8s  %s", "count", "severity", "type", "source", "id", "message");
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const GLDebugKey& key = entries[i].first;
+        std::string message = entries[i].second.message;
+        message.erase(std::remove(message.begin(), message.end(), '\n'), message.end());
+        if (message.size() > kGLDebugReportMessageChars)
+            message = message.substr(0, kGLDebugReportMessageChars - 3) + "...";
+        log("  %10llu  %-12s  %-11s  %-15s  %8u  %s", (unsigned long long)entries[i].second.count,
+            SeverityName(key.severity), TypeName(key.type), SourceName(key.source), key.id, message.c_str());
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef _GL_DEBUG_H_
+#define _GL_DEBUG_H_
+
+#include "main.h"
+
+// KHR_debug message pipeline. With --gl-debug the window system creates a debug context
+// and GLDebugInit() installs a glDebugMessageCallback: every message is counted per
+// (source, type, id, severity), the first occurrence is logged, and the table - driver
+// performance warnings included - is printed once at the end of the run. The callback is
+// synchronous, so while it is active CheckError() counts its errors instead of calling
+// glGetError.
+
+/// Install the callback if the current context is a debug context with KHR_debug.
+void GLDebugInit();
+
+bool IsGLDebugActive();
+
+/// GL_DEBUG_TYPE_ERROR messages received so far.
+uint32 GLDebugErrorCount();
+
+/// Print the deduplicated message table.
+void GLDebugReport();
+
+#endif
@@ -0,0 +1,659 @@
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+#define GL_RECORD_IMPLEMENTATION
+#include "gl_record.h"
+#include "scene.h"
+#include "state_cache.h"
+#include "offscreen.h"
+#include "benchmark.h"
+
+enum GLOpcode
+{
+    OP_CLEAR,
+    OP_CLEAR_COLOR,
+    OP_VIEWPORT,
+    OP_ENABLE,
+    OP_DISABLE,
+    OP_POLYGON_MODE,
+    OP_BIND_TEXTURE,
+    OP_DRAW_ARRAYS,
+    OP_DRAW_ELEMENTS,
+    OP_USE_PROGRAM,
+    OP_BIND_PROGRAM_PIPELINE,
+    OP_BIND_VERTEX_ARRAY,
+    OP_BIND_BUFFER,
+    OP_BIND_BUFFER_BASE,
+    OP_GEN_BUFFERS,
+    OP_BUFFER_DATA,
+    OP_BUFFER_SUB_DATA,
+    OP_ENABLE_VERTEX_ATTRIB_ARRAY,
+    OP_DISABLE_VERTEX_ATTRIB_ARRAY,
+    OP_VERTEX_ATTRIB_POINTER,
+    OP_ACTIVE_TEXTURE,
+    OP_PATCH_PARAMETER_I,
+    OP_PATCH_PARAMETER_FV,
+    OP_UNIFORM_1I,
+    OP_UNIFORM_1F,
+    OP_UNIFORM_2F,
+    OP_UNIFORM_4F,
+    OP_UNIFORM_MATRIX_4FV,
+    OP_PROGRAM_UNIFORM_1I,
+    OP_PROGRAM_UNIFORM_1F,
+    OP_PROGRAM_UNIFORM_2F,
+    OP_PROGRAM_UNIFORM_4F,
+    OP_PROGRAM_UNIFORM_MATRIX_4FV,
+};
+
+// Name spaces of the objects a handle slot can refer to.
+enum GLObjectKind
+{
+    OBJECT_PROGRAM,
+    OBJECT_PIPELINE,
+    OBJECT_VERTEX_ARRAY,
+    OBJECT_BUFFER,
+    OBJECT_TEXTURE,
+};
+
+bool g_glRecording = false;
+
+static GLCommandBuffer* pRecording = NULL;
+static bool replayBenchmarkRunning = false;
+static std::unordered_map<uint64, uint32> slotOfObject;       ///< kind << 32 | name
+
+static void Put(const void* _data, size_t _size)
+{
+    const uint8* pData = (const uint8*)_data;
+    pRecording->stream.insert(pRecording->stream.end(), pData, pData + _size);
+}
+
+template <typename T>
+static void Put(T _value)
+{
+    Put(&_value, sizeof(_value));
+}
+
+// Float arrays are passed to GL in place, so they start 4-byte aligned in the stream.
+static void PutFloats(const GLfloat* _values, size_t _count)
+{
+    while (pRecording->stream.size() % sizeof(GLfloat))
+    {
+        pRecording->stream.push_back(0);
+    }
+    Put(_values, _count * sizeof(GLfloat));
+}
+
+static void PutOp(GLOpcode _op)
+{
+    Put(uint8(_op));
+    pRecording->commands++;
+}
+
+static uint32 NewSlot(GLObjectKind _kind, GLuint _name)
+{
+    uint32 slot = uint32(pRecording->handles.size());
+    pRecording->handles.push_back(_name);
+    slotOfObject[(uint64(_kind) << 32) | _name] = slot;
+    return slot;
+}
+
+static void PutHandle(GLObjectKind _kind, GLuint _name)
+{
+    uint32 slot = 0;
+    if (_name)
+    {
+        std::unordered_map<uint64, uint32>::const_iterator it = slotOfObject.find((uint64(_kind) << 32) | _name);
+        slot = it != slotOfObject.end() ? it->second : NewSlot(_kind, _name);
+    }
+    Put(slot);
+}
+
+// An offset into a buffer bound to _binding; a pointer to client memory cannot be replayed.
+static void PutOffset(GLenum _binding, const void* _pointer)
+{
+    GLint buffer = 0;
+    glGetIntegerv(_binding, &buffer);
+    if (!buffer && _pointer && !pRecording->unreplayable)
+    {
+        pRecording->unreplayable = "a client memory array";
+    }
+    Put(uint64(uintp(_pointer)));
+}
+
+static const GLfloat* GetFloats(const uint8*& _pCursor, const uint8* _pBegin, size_t _count)
+{
+    _pCursor += (sizeof(GLfloat) - size_t(_pCursor - _pBegin) % sizeof(GLfloat)) % sizeof(GLfloat);
+    const GLfloat* pValues = (const GLfloat*)_pCursor;
+    _pCursor += _count * sizeof(GLfloat);
+    return pValues;
+}
+
+template <typename T>
+static T Get(const uint8*& _pCursor)
+{
+    T value;
+    memcpy(&value, _pCursor, sizeof(value));
+    _pCursor += sizeof(value);
+    return value;
+}
+
+// Wrapper _fun replaces __glew_fun while recording: it records with _record, then calls GL.
+#define GL_RECORD_HOOK(_fun, _params, _args, _record)   \
+    static decltype(__glew##_fun) real##_fun = NULL;    \
+    static void GLAPIENTRY Record##_fun _params         \
+    {                                                   \
+        _record;                                        \
+        real##_fun _args;                               \
+    }
+
+GL_RECORD_HOOK(UseProgram, (GLuint _program), (_program),
+    PutOp(OP_USE_PROGRAM); PutHandle(OBJECT_PROGRAM, _program))
+GL_RECORD_HOOK(BindProgramPipeline, (GLuint _pipeline), (_pipeline),
+    PutOp(OP_BIND_PROGRAM_PIPELINE); PutHandle(OBJECT_PIPELINE, _pipeline))
+GL_RECORD_HOOK(BindVertexArray, (GLuint _array), (_array),
+    PutOp(OP_BIND_VERTEX_ARRAY); PutHandle(OBJECT_VERTEX_ARRAY, _array))
+GL_RECORD_HOOK(BindBuffer, (GLenum _target, GLuint _buffer), (_target, _buffer),
+    PutOp(OP_BIND_BUFFER); Put(_target); PutHandle(OBJECT_BUFFER, _buffer))
+GL_RECORD_HOOK(BindBufferBase, (GLenum _target, GLuint _index, GLuint _buffer), (_target, _index, _buffer),
+    PutOp(OP_BIND_BUFFER_BASE); Put(_target); Put(_index); PutHandle(OBJECT_BUFFER, _buffer))
+GL_RECORD_HOOK(BufferData, (GLenum _target, GLsizeiptr _size, const void* _data, GLenum _usage), (_target, _size, _data, _usage),
+    PutOp(OP_BUFFER_DATA); Put(_target); Put(uint64(_size)); Put(_usage); Put(uint8(_data != NULL));
+    if (_data) Put(_data, size_t(_size)))
+GL_RECORD_HOOK(BufferSubData, (GLenum _target, GLintptr _offset, GLsizeiptr _size, const void* _data), (_target, _offset, _size, _data),
+    PutOp(OP_BUFFER_SUB_DATA); Put(_target); Put(uint64(_offset)); Put(uint64(_size)); Put(_data, size_t(_size)))
+GL_RECORD_HOOK(EnableVertexAttribArray, (GLuint _index), (_index),
+    PutOp(OP_ENABLE_VERTEX_ATTRIB_ARRAY); Put(_index))
+GL_RECORD_HOOK(DisableVertexAttribArray, (GLuint _index), (_index),
+    PutOp(OP_DISABLE_VERTEX_ATTRIB_ARRAY); Put(_index))
+GL_RECORD_HOOK(VertexAttribPointer, (GLuint _index, GLint _size, GLenum _type, GLboolean _normalized, GLsizei _stride, const void* _pointer),
+    (_index, _size, _type, _normalized, _stride, _pointer),
+    PutOp(OP_VERTEX_ATTRIB_POINTER); Put(_index); Put(_size); Put(_type); Put(_normalized); Put(_stride);
+    PutOffset(GL_ARRAY_BUFFER_BINDING, _pointer))
+GL_RECORD_HOOK(ActiveTexture, (GLenum _texture), (_texture),
+    PutOp(OP_ACTIVE_TEXTURE); Put(_texture))
+GL_RECORD_HOOK(PatchParameteri, (GLenum _pname, GLint _value), (_pname, _value),
+    PutOp(OP_PATCH_PARAMETER_I); Put(_pname); Put(_value))
+GL_RECORD_HOOK(PatchParameterfv, (GLenum _pname, const GLfloat* _values), (_pname, _values),
+    PutOp(OP_PATCH_PARAMETER_FV); Put(_pname); PutFloats(_values, _pname == GL_PATCH_DEFAULT_OUTER_LEVEL ? 4 : 2))
+GL_RECORD_HOOK(Uniform1i, (GLint _location, GLint _v0), (_location, _v0),
+    PutOp(OP_UNIFORM_1I); Put(_location); Put(_v0))
+GL_RECORD_HOOK(Uniform1f, (GLint _location, GLfloat _v0), (_location, _v0),
+    PutOp(OP_UNIFORM_1F); Put(_location); Put(_v0))
+GL_RECORD_HOOK(Uniform2f, (GLint _location, GLfloat _v0, GLfloat _v1), (_location, _v0, _v1),
+    PutOp(OP_UNIFORM_2F); Put(_location); Put(_v0); Put(_v1))
+GL_RECORD_HOOK(Uniform4f, (GLint _location, GLfloat _v0, GLfloat _v1, GLfloat _v2, GLfloat _v3), (_location, _v0, _v1, _v2, _v3),
+    PutOp(OP_UNIFORM_4F); Put(_location); Put(_v0); Put(_v1); Put(_v2); Put(_v3))
+GL_RECORD_HOOK(UniformMatrix4fv, (GLint _location, GLsizei _count, GLboolean _transpose, const GLfloat* _value),
+    (_location, _count, _transpose, _value),
+    PutOp(OP_UNIFORM_MATRIX_4FV); Put(_location); Put(_count); Put(_transpose); PutFloats(_value, size_t(_count) * 16))
+GL_RECORD_HOOK(ProgramUniform1i, (GLuint _program, GLint _location, GLint _v0), (_program, _location, _v0),
+    PutOp(OP_PROGRAM_UNIFORM_1I); PutHandle(OBJECT_PROGRAM, _program); Put(_location); Put(_v0))
+GL_RECORD_HOOK(ProgramUniform1f, (GLuint _program, GLint _location, GLfloat _v0), (_program, _location, _v0),
+    PutOp(OP_PROGRAM_UNIFORM_1F); PutHandle(OBJECT_PROGRAM, _program); Put(_location); Put(_v0))
+GL_RECORD_HOOK(ProgramUniform2f, (GLuint _program, GLint _location, GLfloat _v0, GLfloat _v1), (_program, _location, _v0, _v1),
+    PutOp(OP_PROGRAM_UNIFORM_2F); PutHandle(OBJECT_PROGRAM, _program); Put(_location); Put(_v0); Put(_v1))
+GL_RECORD_HOOK(ProgramUniform4f, (GLuint _program, GLint _location, GLfloat _v0, GLfloat _v1, GLfloat _v2, GLfloat _v3),
+    (_program, _location, _v0, _v1, _v2, _v3),
+    PutOp(OP_PROGRAM_UNIFORM_4F); PutHandle(OBJECT_PROGRAM, _program); Put(_location); Put(_v0); Put(_v1); Put(_v2); Put(_v3))
+GL_RECORD_HOOK(ProgramUniformMatrix4fv, (GLuint _program, GLint _location, GLsizei _count, GLboolean _transpose, const GLfloat* _value),
+    (_program, _location, _count, _transpose, _value),
+    PutOp(OP_PROGRAM_UNIFORM_MATRIX_4FV); PutHandle(OBJECT_PROGRAM, _program); Put(_location); Put(_count); Put(_transpose);
+    PutFloats(_value, size_t(_count) * 16))
+
+// Draws the command set has no opcode for. Recording them would be possible, but no scene
+// needs them yet; until then they only keep the frame from being replayed.
+#define GL_RECORD_REJECT(_fun, _params, _args)          \
+    static decltype(__glew##_fun) real##_fun = NULL;    \
+    static void GLAPIENTRY Record##_fun _params         \
+    {                                                   \
+        RecordUnreplayable("gl" #_fun);                 \
+        real##_fun _args;                               \
+    }
+
+GL_RECORD_REJECT(DrawRangeElements, (GLenum _mode, GLuint _start, GLuint _end, GLsizei _count, GLenum _type, const void* _indices),
+    (_mode, _start, _end, _count, _type, _indices))
+GL_RECORD_REJECT(DrawArraysInstanced, (GLenum _mode, GLint _first, GLsizei _count, GLsizei _instances),
+    (_mode, _first, _count, _instances))
+GL_RECORD_REJECT(DrawElementsInstanced, (GLenum _mode, GLsizei _count, GLenum _type, const void* _indices, GLsizei _instances),
+    (_mode, _count, _type, _indices, _instances))
+GL_RECORD_REJECT(DrawElementsBaseVertex, (GLenum _mode, GLsizei _count, GLenum _type, const void* _indices, GLint _baseVertex),
+    (_mode, _count, _type, _indices, _baseVertex))
+GL_RECORD_REJECT(MultiDrawArrays, (GLenum _mode, const GLint* _first, const GLsizei* _count, GLsizei _drawCount),
+    (_mode, _first, _count, _drawCount))
+GL_RECORD_REJECT(MultiDrawElements, (GLenum _mode, const GLsizei* _count, GLenum _type, const void* const* _indices, GLsizei _drawCount),
+    (_mode, _count, _type, _indices, _drawCount))
+GL_RECORD_REJECT(DrawArraysIndirect, (GLenum _mode, const void* _indirect), (_mode, _indirect))
+GL_RECORD_REJECT(DrawElementsIndirect, (GLenum _mode, GLenum _type, const void* _indirect), (_mode, _type, _indirect))
+GL_RECORD_REJECT(DispatchCompute, (GLuint _x, GLuint _y, GLuint _z), (_x, _y, _z))
+
+// The names only exist after the call, so this one records afterwards.
+static decltype(__glewGenBuffers) realGenBuffers = NULL;
+static void GLAPIENTRY RecordGenBuffers(GLsizei _n, GLuint* _buffers)
+{
+    realGenBuffers(_n, _buffers);
+    PutOp(OP_GEN_BUFFERS);
+    Put(_n);
+    for (GLsizei i = 0; i < _n; i++)
+    {
+        uint32 slot = NewSlot(OBJECT_BUFFER, _buffers[i]);
+        pRecording->generated.push_back(slot);
+        Put(slot);
+    }
+}
+
+#define GL_RECORD_HOOKS(_apply)         \
+    _apply(UseProgram)                  \
+    _apply(BindProgramPipeline)         \
+    _apply(BindVertexArray)             \
+    _apply(BindBuffer)                  \
+    _apply(BindBufferBase)              \
+    _apply(GenBuffers)                  \
+    _apply(BufferData)                  \
+    _apply(BufferSubData)               \
+    _apply(EnableVertexAttribArray)     \
+    _apply(DisableVertexAttribArray)    \
+    _apply(VertexAttribPointer)         \
+    _apply(ActiveTexture)               \
+    _apply(PatchParameteri)             \
+    _apply(PatchParameterfv)            \
+    _apply(Uniform1i)                   \
+    _apply(Uniform1f)                   \
+    _apply(Uniform2f)                   \
+    _apply(Uniform4f)                   \
+    _apply(UniformMatrix4fv)            \
+    _apply(ProgramUniform1i)            \
+    _apply(ProgramUniform1f)            \
+    _apply(ProgramUniform2f)            \
+    _apply(ProgramUniform4f)            \
+    _apply(ProgramUniformMatrix4fv)     \
+    _apply(DrawRangeElements)           \
+    _apply(DrawArraysInstanced)         \
+    _apply(DrawElementsInstanced)       \
+    _apply(DrawElementsBaseVertex)      \
+    _apply(MultiDrawArrays)             \
+    _apply(MultiDrawElements)           \
+    _apply(DrawArraysIndirect)          \
+    _apply(DrawElementsIndirect)        \
+    _apply(DispatchCompute)
+
+#define GL_RECORD_INSTALL(_fun)     real##_fun = __glew##_fun; __glew##_fun = Record##_fun;
+#define GL_RECORD_UNINSTALL(_fun)   __glew##_fun = real##_fun;
+
+// ----------------------------------------------------------------------------------------------------------------
+void RecordClear(GLbitfield _mask)
+{
+    PutOp(OP_CLEAR); Put(_mask);
+    glClear(_mask);
+}
+
+void RecordClearColor(GLfloat _r, GLfloat _g, GLfloat _b, GLfloat _a)
+{
+    PutOp(OP_CLEAR_COLOR); Put(_r); Put(_g); Put(_b); Put(_a);
+    glClearColor(_r, _g, _b, _a);
+}
+
+void RecordViewport(GLint _x, GLint _y, GLsizei _width, GLsizei _height)
+{
+    PutOp(OP_VIEWPORT); Put(_x); Put(_y); Put(_width); Put(_height);
+    glViewport(_x, _y, _width, _height);
+}
+
+void RecordEnable(GLenum _cap)
+{
+    PutOp(OP_ENABLE); Put(_cap);
+    glEnable(_cap);
+}
+
+void RecordDisable(GLenum _cap)
+{
+    PutOp(OP_DISABLE); Put(_cap);
+    glDisable(_cap);
+}
+
+void RecordPolygonMode(GLenum _face, GLenum _mode)
+{
+    PutOp(OP_POLYGON_MODE); Put(_face); Put(_mode);
+    glPolygonMode(_face, _mode);
+}
+
+void RecordBindTexture(GLenum _target, GLuint _texture)
+{
+    PutOp(OP_BIND_TEXTURE); Put(_target); PutHandle(OBJECT_TEXTURE, _texture);
+    glBindTexture(_target, _texture);
+}
+
+void RecordDrawArrays(GLenum _mode, GLint _first, GLsizei _count)
+{
+    PutOp(OP_DRAW_ARRAYS); Put(_mode); Put(_first); Put(_count);
+    glDrawArrays(_mode, _first, _count);
+}
+
+void RecordDrawElements(GLenum _mode, GLsizei _count, GLenum _type, const void* _indices)
+{
+    PutOp(OP_DRAW_ELEMENTS); Put(_mode); Put(_count); Put(_type); PutOffset(GL_ELEMENT_ARRAY_BUFFER_BINDING, _indices);
+    glDrawElements(_mode, _count, _type, _indices);
+}
+
+void RecordUnreplayable(const char* _call)
+{
+    if (!pRecording->unreplayable)
+        pRecording->unreplayable = _call;
+}
+
+void GLRecordBegin(GLCommandBuffer& _buffer)
+{
+    _buffer.stream.clear();
+    _buffer.handles.assign(1, 0);
+    _buffer.generated.clear();
+    _buffer.commands = 0;
+    _buffer.unreplayable = NULL;
+    pRecording = &_buffer;
+    slotOfObject.clear();
+
+    GL_RECORD_HOOKS(GL_RECORD_INSTALL)
+    g_glRecording = true;
+}
+
+void GLRecordEnd()
+{
+    g_glRecording = false;
+    GL_RECORD_HOOKS(GL_RECORD_UNINSTALL)
+    pRecording = NULL;
+    slotOfObject.clear();
+}
+
+void GLReplay(GLCommandBuffer& _buffer)
+{
+    GLuint* pHandles = _buffer.handles.data();
+    const uint8* pBegin = _buffer.stream.data();
+    const uint8* pEnd = pBegin + _buffer.stream.size();
+    const uint8* pCursor = pBegin;
+    while (pCursor < pEnd)
+    {
+        switch (GLOpcode(*pCursor++))
+        {
+        case OP_CLEAR:
+            glClear(Get<GLbitfield>(pCursor));
+            break;
+        case OP_CLEAR_COLOR:
+        {
+            GLfloat r = Get<GLfloat>(pCursor), g = Get<GLfloat>(pCursor), b = Get<GLfloat>(pCursor), a = Get<GLfloat>(pCursor);
+            glClearColor(r, g, b, a);
+            break;
+        }
+        case OP_VIEWPORT:
+        {
+            GLint x = Get<GLint>(pCursor), y = Get<GLint>(pCursor);
+            GLsizei width = Get<GLsizei>(pCursor), height = Get<GLsizei>(pCursor);
+            glViewport(x, y, width, height);
+            break;
+        }
+        case OP_ENABLE:
+            glEnable(Get<GLenum>(pCursor));
+            break;
+        case OP_DISABLE:
+            glDisable(Get<GLenum>(pCursor));
+            break;
+        case OP_POLYGON_MODE:
+        {
+            GLenum face = Get<GLenum>(pCursor), mode = Get<GLenum>(pCursor);
+            glPolygonMode(face, mode);
+            break;
+        }
+        case OP_BIND_TEXTURE:
+        {
+            GLenum target = Get<GLenum>(pCursor);
+            glBindTexture(target, pHandles[Get<uint32>(pCursor)]);
+            break;
+        }
+        case OP_DRAW_ARRAYS:
+        {
+            GLenum mode = Get<GLenum>(pCursor);
+            GLint first = Get<GLint>(pCursor);
+            GLsizei count = Get<GLsizei>(pCursor);
+            glDrawArrays(mode, first, count);
+            break;
+        }
+        case OP_DRAW_ELEMENTS:
+        {
+            GLenum mode = Get<GLenum>(pCursor);
+            GLsizei count = Get<GLsizei>(pCursor);
+            GLenum type = Get<GLenum>(pCursor);
+            glDrawElements(mode, count, type, (const void*)uintp(Get<uint64>(pCursor)));
+            break;
+        }
+        case OP_USE_PROGRAM:
+            glUseProgram(pHandles[Get<uint32>(pCursor)]);
+            break;
+        case OP_BIND_PROGRAM_PIPELINE:
+            glBindProgramPipeline(pHandles[Get<uint32>(pCursor)]);
+            break;
+        case OP_BIND_VERTEX_ARRAY:
+            glBindVertexArray(pHandles[Get<uint32>(pCursor)]);
+            break;
+        case OP_BIND_BUFFER:
+        {
+            GLenum target = Get<GLenum>(pCursor);
+            glBindBuffer(target, pHandles[Get<uint32>(pCursor)]);
+            break;
+        }
+        case OP_BIND_BUFFER_BASE:
+        {
+            GLenum target = Get<GLenum>(pCursor);
+            GLuint index = Get<GLuint>(pCursor);
+            glBindBufferBase(target, index, pHandles[Get<uint32>(pCursor)]);
+            break;
+        }
+        case OP_GEN_BUFFERS:
+        {
+            GLsizei count = Get<GLsizei>(pCursor);
+            for (GLsizei i = 0; i < count; i++)
+            {
+                glGenBuffers(1, &pHandles[Get<uint32>(pCursor)]);
+            }
+            break;
+        }
+        case OP_BUFFER_DATA:
+        {
+            GLenum target = Get<GLenum>(pCursor);
+            GLsizeiptr size = GLsizeiptr(Get<uint64>(pCursor));
+            GLenum usage = Get<GLenum>(pCursor);
+            bool hasData = Get<uint8>(pCursor) != 0;
+            glBufferData(target, size, hasData ? pCursor : NULL, usage);
+            pCursor += hasData ? size : 0;
+            break;
+        }
+        case OP_BUFFER_SUB_DATA:
+        {
+            GLenum target = Get<GLenum>(pCursor);
+            GLintptr offset = GLintptr(Get<uint64>(pCursor));
+            GLsizeiptr size = GLsizeiptr(Get<uint64>(pCursor));
+            glBufferSubData(target, offset, size, pCursor);
+            pCursor += size;
+            break;
+        }
+        case OP_ENABLE_VERTEX_ATTRIB_ARRAY:
+            glEnableVertexAttribArray(Get<GLuint>(pCursor));
+            break;
+        case OP_DISABLE_VERTEX_ATTRIB_ARRAY:
+            glDisableVertexAttribArray(Get<GLuint>(pCursor));
+            break;
+        case OP_VERTEX_ATTRIB_POINTER:
+        {
+            GLuint index = Get<GLuint>(pCursor);
+            GLint size = Get<GLint>(pCursor);
+            GLenum type = Get<GLenum>(pCursor);
+            GLboolean normalized = Get<GLboolean>(pCursor);
+            GLsizei stride = Get<GLsizei>(pCursor);
+            glVertexAttribPointer(index, size, type, normalized, stride, (const void*)uintp(Get<uint64>(pCursor)));
+            break;
+        }
+        case OP_ACTIVE_TEXTURE:
+            glActiveTexture(Get<GLenum>(pCursor));
+            break;
+        case OP_PATCH_PARAMETER_I:
+        {
+            GLenum pname = Get<GLenum>(pCursor);
+            glPatchParameteri(pname, Get<GLint>(pCursor));
+            break;
+        }
+        case OP_PATCH_PARAMETER_FV:
+        {
+            GLenum pname = Get<GLenum>(pCursor);
+            glPatchParameterfv(pname, GetFloats(pCursor, pBegin, pname == GL_PATCH_DEFAULT_OUTER_LEVEL ? 4 : 2));
+            break;
+        }
+        case OP_UNIFORM_1I:
+        {
+            GLint location = Get<GLint>(pCursor);
+            glUniform1i(location, Get<GLint>(pCursor));
+            break;
+        }
+        case OP_UNIFORM_1F:
+        {
+            GLint location = Get<GLint>(pCursor);
+            glUniform1f(location, Get<GLfloat>(pCursor));
+            break;
+        }
+        case OP_UNIFORM_2F:
+        {
+            GLint location = Get<GLint>(pCursor);
+            GLfloat v0 = Get<GLfloat>(pCursor), v1 = Get<GLfloat>(pCursor);
+            glUniform2f(location, v0, v1);
+            break;
+        }
+        case OP_UNIFORM_4F:
+        {
+            GLint location = Get<GLint>(pCursor);
+            GLfloat v0 = Get<GLfloat>(pCursor), v1 = Get<GLfloat>(pCursor), v2 = Get<GLfloat>(pCursor), v3 = Get<GLfloat>(pCursor);
+            glUniform4f(location, v0, v1, v2, v3);
+            break;
+        }
+        case OP_UNIFORM_MATRIX_4FV:
+        {
+            GLint location = Get<GLint>(pCursor);
+            GLsizei count = Get<GLsizei>(pCursor);
+            GLboolean transpose = Get<GLboolean>(pCursor);
+            glUniformMatrix4fv(location, count, transpose, GetFloats(pCursor, pBegin, size_t(count) * 16));
+            break;
+        }
+        case OP_PROGRAM_UNIFORM_1I:
+        {
+            GLuint program = pHandles[Get<uint32>(pCursor)];
+            GLint location = Get<GLint>(pCursor);
+            glProgramUniform1i(program, location, Get<GLint>(pCursor));
+            break;
+        }
+        case OP_PROGRAM_UNIFORM_1F:
+        {
+            GLuint program = pHandles[Get<uint32>(pCursor)];
+            GLint location = Get<GLint>(pCursor);
+            glProgramUniform1f(program, location, Get<GLfloat>(pCursor));
+            break;
+        }
+        case OP_PROGRAM_UNIFORM_2F:
+        {
+            GLuint program = pHandles[Get<uint32>(pCursor)];
+            GLint location = Get<GLint>(pCursor);
+            GLfloat v0 = Get<GLfloat>(pCursor), v1 = Get<GLfloat>(pCursor);
+            glProgramUniform2f(program, location, v0, v1);
+            break;
+        }
+        case OP_PROGRAM_UNIFORM_4F:
+        {
+            GLuint program = pHandles[Get<uint32>(pCursor)];
+            GLint location = Get<GLint>(pCursor);
+            GLfloat v0 = Get<GLfloat>(pCursor), v1 = Get<GLfloat>(pCursor), v2 = Get<GLfloat>(pCursor), v3 = Get<GLfloat>(pCursor);
+            glProgramUniform4f(program, location, v0, v1, v2, v3);
+            break;
+        }
+        case OP_PROGRAM_UNIFORM_MATRIX_4FV:
+        {
+            GLuint program = pHandles[Get<uint32>(pCursor)];
+            GLint location = Get<GLint>(pCursor);
+            GLsizei count = Get<GLsizei>(pCursor);
+            GLboolean transpose = Get<GLboolean>(pCursor);
+            glProgramUniformMatrix4fv(program, location, count, transpose, GetFloats(pCursor, pBegin, size_t(count) * 16));
+            break;
+        }
+        default:
+            error("Corrupt GL command buffer at byte %u", uint32(pCursor - 1 - pBegin));
+        }
+    }
+
+    for (size_t i = 0; i < _buffer.generated.size(); i++)
+    {
+        glDeleteBuffers(1, &pHandles[_buffer.generated[i]]);
+    }
+}
+
+struct SubmitTimes
+{
+    float64 submitMs;       ///< per pass, until the last call returned
+    float64 finishMs;       ///< per pass, including glFinish after the last pass
+};
+
+bool IsReplayBenchmarkRunning()
+{
+    return replayBenchmarkRunning;
+}
+
+void ReplayBenchmarkScene(const Scene& _scene, uint32 _passes)
+{
+    replayBenchmarkRunning = true;
+    OffscreenBeginFrame();
+    glFinish();
+
+    // The scene's own loop: its CPU work plus the driver's.
+    SubmitTimes live;
+    uint64 begin = GetTimeNs();
+    for (uint32 i = 0; i < _passes; i++)
+    {
+        _scene.DrawGLScene();
+    }
+    uint64 submitted = GetTimeNs();
+    glFinish();
+    live.submitMs = float64(submitted - begin) / 1e6 / _passes;
+    live.finishMs = float64(GetTimeNs() - begin) / 1e6 / _passes;
+
+    // A frame as the loop above makes it: the state cache has dropped what the previous
+    // frame left set, so replaying it in a loop is valid and makes the same calls.
+    GLCommandBuffer buffer;
+    GLRecordBegin(buffer);
+    _scene.DrawGLScene();
+    GLRecordEnd();
+    replayBenchmarkRunning = false;
+    if (buffer.unreplayable)
+    {
+        warn("Replay of %s: the frame uses %s, which is not recorded; not replayed", _scene.name, buffer.unreplayable);
+        StateCacheInvalidate();
+        return;
+    }
+    glFinish();
+
+    SubmitTimes replay;
+    begin = GetTimeNs();
+    for (uint32 i = 0; i < _passes; i++)
+    {
+        GLReplay(buffer);
+    }
+    submitted = GetTimeNs();
+    glFinish();
+    replay.submitMs = float64(submitted - begin) / 1e6 / _passes;
+    replay.finishMs = float64(GetTimeNs() - begin) / 1e6 / _passes;
+
+    // The replayed buffers were deleted; let the cache find out what is bound now.
+    StateCacheInvalidate();
+
+    log("Replay of %s: %u commands, %u bytes, %u handles per frame; %u passes each", _scene.name,
+        buffer.commands, uint32(buffer.stream.size()), uint32(buffer.handles.size() - 1), _passes);
+    log("  live   : %8.4f ms submit, %8.4f ms with glFinish per frame", live.submitMs, live.finishMs);
+    log("  replay : %8.4f ms submit, %8.4f ms with glFinish per frame, %.0f calls/s submitted",
+        replay.submitMs, replay.finishMs, replay.submitMs > 0.0 ? buffer.commands / replay.submitMs * 1e3 : 0.0);
+    if (live.submitMs > 0.0)
+    {
+        log("  scene CPU share of the submission: %.1f%%",
+            100.0 * std::max(live.submitMs - replay.submitMs, 0.0) / live.submitMs);
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef _GL_RECORD_H_
+#define _GL_RECORD_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "main.h"
+
+// Recording of one frame's GL calls into a compact command buffer that can be replayed
+// without the scene. GLRecordBegin() points the GLEW entry points of the calls below at
+// recording wrappers. Each wrapper appends an opcode and its arguments (uniform values and
+// buffer contents inline, objects as handle slots) and then makes the call. GLRecordEnd()
+// restores the entry points. The GL 1.1 calls are linked directly rather than through GLEW,
+// so this header routes them through inline hooks that cost one branch when not
+// recording. Every scene gets the hooks through scene.h. Calls outside the set are made
+// but not recorded, except the draw calls the set lacks (immediate mode, display lists,
+// fixed-function client arrays, instanced, indirect and multi draws, compute dispatch):
+// those mark the frame as not replayable, since a replay without them would not draw
+// what the scene draws.
+//
+// With --replay N the harness times N live DrawGLScene() calls, records one more frame
+// and replays it N times, each loop without presenting (see ReplayBenchmarkScene). The
+// recorded frame makes the same calls as the live ones, after the state cache dropped the
+// redundant ones. The live time minus the replay time is the scene's own CPU cost. The
+// replay time is submission cost in the driver.
+
+/// Objects named by the commands. A slot holds the recorded name; slots of objects the
+/// frame created with glGenBuffers get new names on every replay.
+struct GLCommandBuffer
+{
+    std::vector<uint8>  stream;         ///< opcode, then its arguments
+    std::vector<GLuint> handles;        ///< slot 0 is name 0
+    std::vector<uint32> generated;      ///< slots created by a recorded glGenBuffers
+    uint32              commands;
+    const char*         unreplayable;   ///< first call that cannot be replayed, NULL if none
+};
+
+/// Record the calls made until GLRecordEnd() into _buffer, replacing its contents.
+void GLRecordBegin(GLCommandBuffer& _buffer);
+void GLRecordEnd();
+
+/// Make the recorded calls; buffers the frame created are created and deleted again.
+void GLReplay(GLCommandBuffer& _buffer);
+
+struct Scene;
+/// Live against replayed submission of the scene's frame, _passes times each; logged.
+void ReplayBenchmarkScene(const Scene& _scene, uint32 _passes);
+/// True while ReplayBenchmarkScene() calls DrawGLScene(). Scenes that keep statistics of
+/// their own leave these frames out; they are not part of the measured run.
+bool IsReplayBenchmarkRunning();
+
+// ----------------------------------------------------------------------------------------------------------------
+// GL 1.1 hooks. Not for gl_record.cpp, which makes the real calls.
+
+extern bool g_glRecording;
+
+void RecordClear(GLbitfield _mask);
+void RecordClearColor(GLfloat _r, GLfloat _g, GLfloat _b, GLfloat _a);
+void RecordViewport(GLint _x, GLint _y, GLsizei _width, GLsizei _height);
+void RecordEnable(GLenum _cap);
+void RecordDisable(GLenum _cap);
+void RecordPolygonMode(GLenum _face, GLenum _mode);
+void RecordBindTexture(GLenum _target, GLuint _texture);
+void RecordDrawArrays(GLenum _mode, GLint _first, GLsizei _count);
+void RecordDrawElements(GLenum _mode, GLsizei _count, GLenum _type, const void* _indices);
+/// A call the replay cannot make; named in the warning.
+void RecordUnreplayable(const char* _call);
+
+#ifndef GL_RECORD_IMPLEMENTATION
+
+inline void HookedClear(GLbitfield _mask)
+{
+    if (g_glRecording) RecordClear(_mask); else glClear(_mask);
+}
+inline void HookedClearColor(GLfloat _r, GLfloat _g, GLfloat _b, GLfloat _a)
+{
+    if (g_glRecording) RecordClearColor(_r, _g, _b, _a); else glClearColor(_r, _g, _b, _a);
+}
+inline void HookedViewport(GLint _x, GLint _y, GLsizei _width, GLsizei _height)
+{
+    if (g_glRecording) RecordViewport(_x, _y, _width, _height); else glViewport(_x, _y, _width, _height);
+}
+inline void HookedEnable(GLenum _cap)
+{
+    if (g_glRecording) RecordEnable(_cap); else glEnable(_cap);
+}
+inline void HookedDisable(GLenum _cap)
+{
+    if (g_glRecording) RecordDisable(_cap); else glDisable(_cap);
+}
+inline void HookedPolygonMode(GLenum _face, GLenum _mode)
+{
+    if (g_glRecording) RecordPolygonMode(_face, _mode); else glPolygonMode(_face, _mode);
+}
+inline void HookedBindTexture(GLenum _target, GLuint _texture)
+{
+    if (g_glRecording) RecordBindTexture(_target, _texture); else glBindTexture(_target, _texture);
+}
+inline void HookedDrawArrays(GLenum _mode, GLint _first, GLsizei _count)
+{
+    if (g_glRecording) RecordDrawArrays(_mode, _first, _count); else glDrawArrays(_mode, _first, _count);
+}
+inline void HookedDrawElements(GLenum _mode, GLsizei _count, GLenum _type, const void* _indices)
+{
+    if (g_glRecording) RecordDrawElements(_mode, _count, _type, _indices); else glDrawElements(_mode, _count, _type, _indices);
+}
+inline void HookedBegin(GLenum _mode)
+{
+    if (g_glRecording) RecordUnreplayable("glBegin");
+    glBegin(_mode);
+}
+inline void HookedCallList(GLuint _list)
+{
+    if (g_glRecording) RecordUnreplayable("glCallList");
+    glCallList(_list);
+}
+inline void HookedCallLists(GLsizei _n, GLenum _type, const void* _lists)
+{
+    if (g_glRecording) RecordUnreplayable("glCallLists");
+    glCallLists(_n, _type, _lists);
+}
+inline void HookedEnableClientState(GLenum _array)
+{
+    if (g_glRecording) RecordUnreplayable("glEnableClientState");
+    glEnableClientState(_array);
+}
+
+#define glClear         HookedClear
+#define glClearColor    HookedClearColor
+#define glViewport      HookedViewport
+#define glEnable        HookedEnable
+#define glDisable       HookedDisable
+#define glPolygonMode   HookedPolygonMode
+#define glBindTexture   HookedBindTexture
+#define glDrawArrays    HookedDrawArrays
+#define glDrawElements  HookedDrawElements
+#define glBegin         HookedBegin
+#define glCallList      HookedCallList
+#define glCallLists     HookedCallLists
+#define glEnableClientState HookedEnableClientState
+
+#endif
+
+#endif
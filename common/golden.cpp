@@ -0,0 +1,123 @@
+#include <stdio.h>
+
+#include "golden.h"
+#include "harness.h"
+#include "readback.h"
+#include "png.h"
+#include "image_compare.h"
+#include "profiler.h"
+
+struct GoldenSceneStats
+{
+    uint32  framesCompared;
+    uint32  framesFailed;
+    uint32  sizeMismatches;
+    uint32  firstFailedFrame;
+    uint64  worstMismatched;    ///< most out-of-tolerance pixels in a single frame
+    uint32  maxChannelDiff;
+    uint32  frameWidth;
+    uint32  frameHeight;
+};
+
+static bool enabled = false;
+static bool failed = false;
+static bool hasReference = false;
+static PngImage reference;
+static GoldenSceneStats stats;      ///< written by the readback worker, read after ReadbackEndScene()
+
+// ----------------------------------------------------------------------------------------------------------------
+// Readback consumer. Captured rows are bottom-up, the reference is top-down.
+static void CompareFrame(const ReadbackFrame& _frame)
+{
+    if (!hasReference)
+        return;
+
+    PROFILE_SCOPE("GoldenCompare");
+    stats.framesCompared++;
+    if (_frame.width != reference.width || _frame.height != reference.height)
+    {
+        stats.frameWidth = _frame.width;
+        stats.frameHeight = _frame.height;
+        if (!stats.framesFailed++)
+            stats.firstFailedFrame = _frame.frame;
+        stats.sizeMismatches++;
+        return;
+    }
+
+    ImageDiff diff = { 0, 0 };
+    uint8 tolerance = uint8(g_harnessOptions.goldenTolerance > 255 ? 255 : g_harnessOptions.goldenTolerance);
+    size_t rowBytes = size_t(_frame.width) * 4;
+    for (uint32 y = 0; y < _frame.height; y++)
+    {
+        const uint8* pFrameRow = _frame.pixels + size_t(y) * rowBytes;
+        const uint8* pReferenceRow = reference.pixels.data() + size_t(_frame.height - 1 - y) * rowBytes;
+        CompareRowRGBA8(pFrameRow, pReferenceRow, _frame.width, tolerance, diff);
+    }
+
+    if (diff.mismatchedPixels > g_harnessOptions.goldenBudget)
+    {
+        if (!stats.framesFailed++)
+            stats.firstFailedFrame = _frame.frame;
+    }
+    if (diff.mismatchedPixels > stats.worstMismatched)
+        stats.worstMismatched = diff.mismatchedPixels;
+    if (diff.maxChannelDiff > stats.maxChannelDiff)
+        stats.maxChannelDiff = diff.maxChannelDiff;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void GoldenInit()
+{
+    if (!g_harnessOptions.golden)
+        return;
+
+    ReadbackAddConsumer(CompareFrame);
+    enabled = true;
+    log("Golden: comparing against %s, tolerance %u, budget %u pixels (%s kernel)", g_harnessOptions.golden,
+        g_harnessOptions.goldenTolerance, g_harnessOptions.goldenBudget, GetCompareKernelName());
+}
+
+void GoldenBeginScene(const char* _sceneName)
+{
+    if (!enabled)
+        return;
+
+    stats = GoldenSceneStats();
+    reference.pixels.clear();
+    hasReference = LoadPNG(g_harnessOptions.golden, reference);
+    if (!hasReference)
+    {
+        warn("Golden: no usable reference for %s, scene not checked", _sceneName);
+    }
+}
+
+void GoldenEndScene()
+{
+    if (!enabled || !hasReference)
+        return;
+
+    if (stats.sizeMismatches)
+    {
+        warn("Golden: %u frames were %ux%u but the reference is %ux%u (try --offscreen %ux%u)",
+             stats.sizeMismatches, stats.frameWidth, stats.frameHeight,
+             reference.width, reference.height, reference.width, reference.height);
+    }
+
+    if (stats.framesFailed)
+    {
+        failed = true;
+        warn("Golden: FAILED %u/%u frames (first: frame %u), worst frame %llu pixels off, max channel diff %u",
+             stats.framesFailed, stats.framesCompared, stats.firstFailedFrame,
+             (unsigned long long)stats.worstMismatched, stats.maxChannelDiff);
+    }
+    else
+    {
+        log("Golden: passed %u frames, worst frame %llu pixels off, max channel diff %u",
+            stats.framesCompared, (unsigned long long)stats.worstMismatched, stats.maxChannelDiff);
+    }
+}
+
+bool GoldenFailed()
+{
+    return failed;
+}
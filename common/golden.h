@@ -0,0 +1,25 @@
+#ifndef _GOLDEN_H_
+#define _GOLDEN_H_
+
+#include "main.h"
+
+// Golden-image regression check selected with --golden FILE: every captured frame is
+// compared against the reference PNG (relative to the scene's directory) on the readback
+// worker, so the check runs on every frame of a soak without stalling the render loop.
+// A frame fails when more than --golden-budget pixels differ by more than
+// --golden-tolerance in any of R, G, B. Frames are compared at the render target size,
+// so references usually need --offscreen WxH to match.
+
+/// Register the compare consumer if --golden was given. Call before ReadbackInit().
+void GoldenInit();
+
+/// Load the scene's reference; the working directory must be the scene's directory.
+void GoldenBeginScene(const char* _sceneName);
+
+/// Print the scene's result. Call after ReadbackEndScene().
+void GoldenEndScene();
+
+/// True once any scene had a failing frame.
+bool GoldenFailed();
+
+#endif
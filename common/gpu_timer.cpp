@@ -0,0 +1,263 @@
+#include <string.h>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpu_timer.h"
+#include "harness.h"
+
+struct GpuFrameSlot
+{
+    GLuint      frameQuery;                             ///< GL_TIME_ELAPSED around the whole frame
+    GLuint      scopeQueries[kGpuTimerMaxScopes][2];    ///< GL_TIMESTAMP at scope begin/end
+    const char* scopeName[kGpuTimerMaxScopes];
+    uint32      scopeDepth[kGpuTimerMaxScopes];
+    uint32      scopeCount;
+    bool        pending;
+};
+
+struct GpuTimerStat
+{
+    const char* name;
+    uint32      depth;
+    uint64      count;
+    float64     totalMs;
+    float64     minMs;
+    float64     maxMs;
+};
+
+static GpuFrameSlot slots[kGpuTimerLatency];
+static uint32 frameIndex = 0;
+static bool initialized = false;
+static bool enabled = false;
+static bool inFrame = false;
+
+static uint32 scopeStack[kGpuTimerMaxScopes];
+static uint32 scopeStackDepth = 0;
+// Open scopes that were dropped; their pops must not close a recorded scope.
+static uint32 droppedScopeDepth = 0;
+
+static GpuTimerStat frameStat = { "frame", 0, 0, 0.0, 0.0, 0.0 };
+static std::vector<GpuTimerStat> scopeStats;
+static uint64 harvestedFrames = 0;
+static uint64 droppedFrames = 0;
+static uint64 droppedScopes = 0;
+
+static void AddSample(GpuTimerStat& stat, float64 ms)
+{
+    if (stat.count == 0 || ms < stat.minMs)
+        stat.minMs = ms;
+    if (stat.count == 0 || ms > stat.maxMs)
+        stat.maxMs = ms;
+    stat.totalMs += ms;
+    stat.count++;
+}
+
+static GpuTimerStat& FindScopeStat(const char* name, uint32 depth)
+{
+    for (size_t i = 0; i < scopeStats.size(); i++)
+    {
+        if (scopeStats[i].depth == depth &&
+            (scopeStats[i].name == name || strcmp(scopeStats[i].name, name) == 0))
+        {
+            return scopeStats[i];
+        }
+    }
+
+    GpuTimerStat stat = { name, depth, 0, 0.0, 0.0, 0.0 };
+    scopeStats.push_back(stat);
+    return scopeStats.back();
+}
+
+static bool IsQueryAvailable(GLuint query)
+{
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+static uint64 GetQueryResult(GLuint query)
+{
+    GLuint64 result = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+    return result;
+}
+
+// Read back one slot. Without _wait, a slot whose results are not ready yet is dropped
+// instead of blocking the render thread.
+static void HarvestSlot(GpuFrameSlot& slot, bool _wait)
+{
+    if (!slot.pending)
+        return;
+    slot.pending = false;
+
+    if (!_wait)
+    {
+        bool ready = IsQueryAvailable(slot.frameQuery);
+        for (uint32 i = 0; ready && i < slot.scopeCount; i++)
+        {
+            ready = IsQueryAvailable(slot.scopeQueries[i][1]);
+        }
+        if (!ready)
+        {
+            droppedFrames++;
+            return;
+        }
+    }
+
+    AddSample(frameStat, float64(GetQueryResult(slot.frameQuery)) * 1e-6);
+    for (uint32 i = 0; i < slot.scopeCount; i++)
+    {
+        uint64 begin = GetQueryResult(slot.scopeQueries[i][0]);
+        uint64 end = GetQueryResult(slot.scopeQueries[i][1]);
+        AddSample(FindScopeStat(slot.scopeName[i], slot.scopeDepth[i]), float64(end - begin) * 1e-6);
+    }
+    harvestedFrames++;
+}
+
+static void InitGpuTimer()
+{
+    initialized = true;
+    enabled = false;
+
+    if (!g_harnessOptions.gpuTiming)
+        return;
+
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+    {
+        warn("GPU timing disabled: GL_ARB_timer_query is not supported.");
+        return;
+    }
+
+    for (uint32 i = 0; i < kGpuTimerLatency; i++)
+    {
+        glGenQueries(1, &slots[i].frameQuery);
+        glGenQueries(kGpuTimerMaxScopes * 2, &slots[i].scopeQueries[0][0]);
+        slots[i].scopeCount = 0;
+        slots[i].pending = false;
+    }
+    enabled = true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void GpuTimerBeginFrame()
+{
+    // Lazily initialized on the first frame of each scene; GpuTimerShutdown() resets.
+    if (!initialized)
+        InitGpuTimer();
+    if (!enabled)
+        return;
+
+    GpuFrameSlot& slot = slots[frameIndex % kGpuTimerLatency];
+    HarvestSlot(slot, false);
+
+    slot.scopeCount = 0;
+    scopeStackDepth = 0;
+    droppedScopeDepth = 0;
+    glBeginQuery(GL_TIME_ELAPSED, slot.frameQuery);
+    inFrame = true;
+}
+
+void GpuTimerEndFrame()
+{
+    if (!enabled || !inFrame)
+        return;
+
+    // Close scopes a test forgot to pop, so the timestamps stay paired.
+    while (scopeStackDepth > 0)
+    {
+        GpuTimerPopScope();
+    }
+
+    GpuFrameSlot& slot = slots[frameIndex % kGpuTimerLatency];
+    glEndQuery(GL_TIME_ELAPSED);
+    slot.pending = true;
+    inFrame = false;
+    frameIndex++;
+}
+
+void GpuTimerPushScope(const char* _name)
+{
+    if (!enabled || !inFrame)
+        return;
+
+    GpuFrameSlot& slot = slots[frameIndex % kGpuTimerLatency];
+    if (slot.scopeCount >= kGpuTimerMaxScopes)
+    {
+        droppedScopes++;
+        droppedScopeDepth++;
+        return;
+    }
+
+    uint32 index = slot.scopeCount++;
+    slot.scopeName[index] = _name;
+    slot.scopeDepth[index] = scopeStackDepth;
+    glQueryCounter(slot.scopeQueries[index][0], GL_TIMESTAMP);
+    scopeStack[scopeStackDepth++] = index;
+}
+
+void GpuTimerPopScope()
+{
+    if (!enabled || !inFrame)
+        return;
+
+    // Once the frame is full every push is dropped, so the dropped scopes are the innermost.
+    if (droppedScopeDepth > 0)
+    {
+        droppedScopeDepth--;
+        return;
+    }
+    if (scopeStackDepth == 0)
+        return;
+
+    GpuFrameSlot& slot = slots[frameIndex % kGpuTimerLatency];
+    uint32 index = scopeStack[--scopeStackDepth];
+    glQueryCounter(slot.scopeQueries[index][1], GL_TIMESTAMP);
+}
+
+void GpuTimerShutdown()
+{
+    initialized = false;
+    if (!enabled)
+        return;
+
+    // At exit blocking is fine: collect what is still in flight, oldest first.
+    for (uint32 i = 0; i < kGpuTimerLatency; i++)
+    {
+        HarvestSlot(slots[(frameIndex + i) % kGpuTimerLatency], true);
+    }
+
+    log("GPU timing: %llu frames harvested, %llu dropped (results not ready after %u frames)",
+        (unsigned long long)harvestedFrames, (unsigned long long)droppedFrames, kGpuTimerLatency);
+    if (droppedScopes)
+    {
+        log("  %llu scopes dropped (more than %u per frame)", (unsigned long long)droppedScopes, kGpuTimerMaxScopes);
+    }
+
+    if (frameStat.count)
+    {
+        log("  %-20s mean %8.3f ms   min %8.3f ms   max %8.3f ms", frameStat.name,
+            frameStat.totalMs / float64(frameStat.count), frameStat.minMs, frameStat.maxMs);
+    }
+    for (size_t i = 0; i < scopeStats.size(); i++)
+    {
+        const GpuTimerStat& stat = scopeStats[i];
+        log("  %*s%-*s mean %8.3f ms   min %8.3f ms   max %8.3f ms", int(stat.depth + 1) * 2, "",
+            int(18 - stat.depth * 2), stat.name, stat.totalMs / float64(stat.count), stat.minMs, stat.maxMs);
+    }
+
+    for (uint32 i = 0; i < kGpuTimerLatency; i++)
+    {
+        glDeleteQueries(1, &slots[i].frameQuery);
+        glDeleteQueries(kGpuTimerMaxScopes * 2, &slots[i].scopeQueries[0][0]);
+    }
+    enabled = false;
+
+    // Start the next scene with a clean report.
+    frameIndex = 0;
+    scopeStats.clear();
+    frameStat.count = 0;
+    frameStat.totalMs = 0.0;
+    harvestedFrames = 0;
+    droppedFrames = 0;
+    droppedScopes = 0;
+}
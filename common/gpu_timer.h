@@ -0,0 +1,35 @@
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include "main.h"
+
+// GPU-side frame and pass timing built on GL_TIME_ELAPSED / GL_TIMESTAMP queries.
+// Queries are kept in a ring and read back kGpuTimerLatency frames later, only when
+// their results are already available, so timing never stalls the pipeline.
+// Everything is a no-op unless the harness was started with --gpu-timing.
+
+static const uint32 kGpuTimerLatency = 4;      ///< frames in flight before a slot is harvested
+static const uint32 kGpuTimerMaxScopes = 16;   ///< named scopes per frame
+
+void GpuTimerBeginFrame();
+void GpuTimerEndFrame();
+
+/// Print the accumulated per-frame and per-scope GPU times and free the queries.
+/// Needs the context to still be current.
+void GpuTimerShutdown();
+
+/// Named scopes may nest; _name must be a string literal (it is kept by pointer).
+void GpuTimerPushScope(const char* _name);
+void GpuTimerPopScope();
+
+struct GpuScope
+{
+    explicit GpuScope(const char* _name) { GpuTimerPushScope(_name); }
+    ~GpuScope() { GpuTimerPopScope(); }
+};
+
+#define GPU_SCOPE_CONCAT2(_a, _b) _a##_b
+#define GPU_SCOPE_CONCAT(_a, _b) GPU_SCOPE_CONCAT2(_a, _b)
+#define GPU_SCOPE(_name) GpuScope GPU_SCOPE_CONCAT(gpuScope_, __LINE__)(_name)
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "scene.h"
+
+HarnessOptions g_harnessOptions =
+{
+    0,      // frames
+    0,      // warmup
+    0,      // noVsync
+    0,      // gpuTiming
+    NULL,   // traceFile
+    NULL,   // scenes
+    NULL,   // sceneRoot
+    0,      // listScenes
+    NULL,   // pacing
+    0,      // targetFps
+    0,      // samples
+    NULL,   // fbConfigCache
+    NULL,   // offscreen
+    NULL,   // colorFormat
+    NULL,   // depthFormat
+    0,      // msaa
+    0,      // blit
+    NULL,   // captureDir
+    0,      // captureEvery
+    NULL,   // golden
+    2,      // goldenTolerance
+    0,      // goldenBudget
+    0,      // glDebug
+    NULL,   // resultsFile
+    NULL,   // programCache
+    0,      // hotReload
+    0,      // noStateCache
+    0,      // replay
+    0,      // finish
+};
+
+enum HarnessArgType
+{
+    HARNESS_FLAG,           ///< no argument, sets an int to 1
+    HARNESS_UINT,           ///< unsigned integer argument
+    HARNESS_STRING,         ///< string argument, kept as a pointer into argv
+};
+
+struct HarnessOption
+{
+    const char*     name;
+    HarnessArgType  type;
+    void*           pValue;
+    const char*     help;
+};
+
+static HarnessOption harnessOptions[] =
+{
+    { "frames",           HARNESS_UINT,   &g_harnessOptions.frames,          "N  : Render N measured frames, then exit and print frame statistics." },
+    { "warmup",           HARNESS_UINT,   &g_harnessOptions.warmup,          "M  : Render M frames before measuring starts." },
+    { "no-vsync",         HARNESS_FLAG,   &g_harnessOptions.noVsync,         "   : Disable the swap interval (GLX_EXT/MESA_swap_control)." },
+    { "gpu-timing",       HARNESS_FLAG,   &g_harnessOptions.gpuTiming,       "   : Measure GPU time per frame and per GPU_SCOPE with timer queries." },
+    { "trace",            HARNESS_STRING, &g_harnessOptions.traceFile,       "F  : Write a Chrome trace_event JSON profile of startup and frames to F." },
+    { "scenes",           HARNESS_STRING, &g_harnessOptions.scenes,          "L  : Comma separated scenes to run, e.g. test1,test6 (default: all linked scenes)." },
+    { "scene-root",       HARNESS_STRING, &g_harnessOptions.sceneRoot,       "D  : Directory containing the scene directories (shader files)." },
+    { "list-scenes",      HARNESS_FLAG,   &g_harnessOptions.listScenes,      "   : Print the scenes linked into this binary and exit." },
+    { "pacing",           HARNESS_STRING, &g_harnessOptions.pacing,          "P  : Frame pacing: unthrottled (default), fps or ondemand (redraw on events only)." },
+    { "target-fps",       HARNESS_UINT,   &g_harnessOptions.targetFps,       "N  : Frame rate for --pacing fps (default 60); implies --pacing fps." },
+    { "samples",          HARNESS_UINT,   &g_harnessOptions.samples,         "N  : Request an N-sample MSAA window framebuffer (GLX; default 0)." },
+    { "fbconfig-cache",   HARNESS_STRING, &g_harnessOptions.fbConfigCache,   "F  : Cache the chosen framebuffer config in F and reuse it on the next start (GLX)." },
+    { "offscreen",        HARNESS_STRING, &g_harnessOptions.offscreen,       "S  : Render every scene into an FBO of size S: WxH, 720p, 1080p, 1440p, 4k or 8k." },
+    { "color-format",     HARNESS_STRING, &g_harnessOptions.colorFormat,     "F  : Offscreen color format: rgba8 (default), rgb10a2, r11g11b10f, rgba16f, rgba32f." },
+    { "depth-format",     HARNESS_STRING, &g_harnessOptions.depthFormat,     "F  : Offscreen depth format: d24s8 (default), d32fs8, d16, d24, d32f, none." },
+    { "msaa",             HARNESS_UINT,   &g_harnessOptions.msaa,            "N  : Offscreen MSAA samples (default 0)." },
+    { "blit",             HARNESS_FLAG,   &g_harnessOptions.blit,            "   : Resolve and scale the offscreen target into the window after every frame." },
+    { "capture",          HARNESS_STRING, &g_harnessOptions.captureDir,      "D  : Read frames back through a PBO ring and write them to directory D as PPM." },
+    { "capture-every",    HARNESS_UINT,   &g_harnessOptions.captureEvery,    "N  : Capture only every Nth frame (default 1)." },
+    { "golden",           HARNESS_STRING, &g_harnessOptions.golden,          "F  : Compare every captured frame against reference PNG F (relative to the scene directory)." },
+    { "golden-tolerance", HARNESS_UINT,   &g_harnessOptions.goldenTolerance, "N  : Largest R/G/B difference that still matches (default 2)." },
+    { "golden-budget",    HARNESS_UINT,   &g_harnessOptions.goldenBudget,    "N  : Out-of-tolerance pixels a frame may have and still pass (default 0)." },
+    { "gl-debug",         HARNESS_FLAG,   &g_harnessOptions.glDebug,         "   : Create a debug context; count and report KHR_debug messages instead of calling glGetError." },
+    { "results",          HARNESS_STRING, &g_harnessOptions.resultsFile,     "F  : Write the scene results and the GL capability snapshot to F as JSON." },
+    { "program-cache",    HARNESS_STRING, &g_harnessOptions.programCache,    "D  : Cache linked program binaries in directory D and load them instead of compiling on later runs." },
+    { "hot-reload",       HARNESS_FLAG,   &g_harnessOptions.hotReload,       "   : Watch the shader files and swap in rebuilt programs while the scene runs." },
+    { "no-state-cache",   HARNESS_FLAG,   &g_harnessOptions.noStateCache,    "   : Make redundant program/bind/enable calls instead of dropping them (they are still counted)." },
+    { "replay",           HARNESS_UINT,   &g_harnessOptions.replay,          "N  : After the frames, time N live frames, record one and replay it N times without the scene." },
+    { "finish",           HARNESS_FLAG,   &g_harnessOptions.finish,          "   : Headless (EGL): glFinish after every frame, so frame times are full GPU round trips (default: wait for frame N-2)." },
+};
+
+static void PrintHarnessHelp()
+{
+    log("Harness options:");
+    for (uint32 i = 0; i < ArraySize(harnessOptions); i++)
+    {
+        log("  --%-16s %s", harnessOptions[i].name, harnessOptions[i].help);
+    }
+    log("");
+}
+
+static HarnessOption* FindHarnessOption(const char* name, size_t nameLength)
+{
+    for (uint32 i = 0; i < ArraySize(harnessOptions); i++)
+    {
+        if (strlen(harnessOptions[i].name) == nameLength &&
+            strncmp(harnessOptions[i].name, name, nameLength) == 0)
+        {
+            return &harnessOptions[i];
+        }
+    }
+    return NULL;
+}
+
+static void SetHarnessOption(HarnessOption* pOption, const char* value)
+{
+    switch (pOption->type)
+    {
+    case HARNESS_FLAG:
+        *(int*)pOption->pValue = 1;
+        break;
+
+    case HARNESS_UINT:
+    {
+        char* end = NULL;
+        unsigned long num = value ? strtoul(value, &end, 10) : 0;
+        if (!value || *value == '\0' || *end != '\0')
+        {
+            error("Option --%s expects an unsigned integer, got '%s'", pOption->name, value ? value : "");
+        }
+        *(uint32*)pOption->pValue = uint32(num);
+        break;
+    }
+
+    case HARNESS_STRING:
+        *(const char**)pOption->pValue = value;
+        break;
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void ProcessHarnessCommandLine(int& argc, char** argv)
+{
+    int out = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--") == 0)
+        {
+            // Everything after "--" belongs to the test. The "--" itself is dropped, or the
+            // test's getopt_long would stop at it and never see the rest.
+            while (++i < argc)
+            {
+                argv[out++] = argv[i];
+            }
+            break;
+        }
+
+        if (strcmp(arg, "--help") == 0)
+        {
+            PrintHarnessHelp();
+        }
+
+        HarnessOption* pOption = NULL;
+        const char* value = NULL;
+        if (arg[0] == '-' && arg[1] == '-')
+        {
+            const char* name = arg + 2;
+            const char* equal = strchr(name, '=');
+            pOption = FindHarnessOption(name, equal ? size_t(equal - name) : strlen(name));
+            value = equal ? equal + 1 : NULL;
+        }
+
+        if (!pOption)
+        {
+            argv[out++] = argv[i];
+            continue;
+        }
+
+        if (pOption->type != HARNESS_FLAG && !value)
+        {
+            if (i + 1 >= argc)
+            {
+                error("Option --%s requires an argument", pOption->name);
+            }
+            value = argv[++i];
+        }
+
+        SetHarnessOption(pOption, value);
+    }
+
+    argv[out] = NULL;
+    argc = out;
+
+    if (g_harnessOptions.listScenes)
+    {
+        const std::vector<Scene>& scenes = GetScenes();
+        for (size_t i = 0; i < scenes.size(); i++)
+        {
+            printf("%s\n", scenes[i].name);
+        }
+        exit(0);
+    }
+}
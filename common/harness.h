@@ -0,0 +1,49 @@
+#ifndef _HARNESS_H_
+#define _HARNESS_H_
+
+#include "main.h"
+
+/// Options understood by the common harness itself (not by the individual tests).
+struct HarnessOptions
+{
+    uint32 frames;              ///< measured frames to render before exiting; 0 = run until closed
+    uint32 warmup;              ///< frames rendered before measuring starts
+    int    noVsync;             ///< disable swap interval
+    int    gpuTiming;           ///< GL timer queries around every frame and GPU_SCOPE
+    const char* traceFile;      ///< Chrome trace_event JSON output of the CPU profiler
+    const char* scenes;         ///< comma separated scenes to run (oglbench); NULL = all linked scenes
+    const char* sceneRoot;      ///< directory holding the scene directories; overrides OGLTEST_SCENE_ROOT
+    int    listScenes;          ///< print the linked scenes and exit
+    const char* pacing;         ///< frame pacing policy: unthrottled, fps or ondemand (see pacing.h)
+    uint32 targetFps;           ///< frame rate held by --pacing fps
+    uint32 samples;             ///< MSAA samples of the window's framebuffer config (GLX)
+    const char* fbConfigCache;  ///< file caching the chosen framebuffer config per display/driver
+    const char* offscreen;      ///< WxH or preset of the offscreen FBO every scene renders into
+    const char* colorFormat;    ///< offscreen color format (see offscreen.cpp)
+    const char* depthFormat;    ///< offscreen depth/stencil format, or "none"
+    uint32 msaa;                ///< offscreen MSAA samples
+    int    blit;                ///< resolve and scale the offscreen target into the window every frame
+    const char* captureDir;     ///< read frames back asynchronously and write them here as PPM
+    uint32 captureEvery;        ///< capture every Nth frame (0/1 = every frame)
+    const char* golden;         ///< reference PNG every captured frame is compared against
+    uint32 goldenTolerance;     ///< largest R/G/B difference that still matches
+    uint32 goldenBudget;        ///< out-of-tolerance pixels allowed per frame
+    int    glDebug;             ///< create a debug context and report through KHR_debug
+    const char* resultsFile;    ///< JSON file receiving the scene results and the capability snapshot
+    const char* programCache;   ///< directory of cached program binaries (see program_cache.h)
+    int    hotReload;           ///< rebuild watched programs when their shader files change (see hot_reload.h)
+    int    noStateCache;        ///< make redundant state calls anyway; they are still counted (see state_cache.h)
+    uint32 replay;              ///< after the frames, time N live and N replayed frames of the scene (see gl_record.h)
+    int    finish;              ///< headless: glFinish after every frame instead of allowing 2 frames in flight
+};
+
+extern HarnessOptions g_harnessOptions;
+
+/// Parse and strip the harness options from argv, so the test's ProcessCommandLine()
+/// only sees its own options. "--help" is printed and passed through to the test.
+void ProcessHarnessCommandLine(int& argc, char** argv);
+
+/// true if the harness was asked to render a fixed number of frames.
+inline bool IsBenchmarkMode() { return g_harnessOptions.frames != 0; }
+
+#endif
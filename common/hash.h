@@ -0,0 +1,44 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+
+#include "main.h"
+
+// FNV-1a, the hash of every cache key, content hash and name lookup in the harness. It is
+// not collision resistant; the keys it builds are compared against their inputs where a
+// collision would matter (program cache entries carry a checksum).
+
+static const uint64 kFnv1a64Basis = 0xcbf29ce484222325ull;
+static const uint32 kFnv1a32Basis = 0x811c9dc5u;
+
+/// Continue the 64-bit hash _hash over _size bytes; start from kFnv1a64Basis.
+inline uint64 Fnv1a64(uint64 _hash, const void* _data, size_t _size)
+{
+    const uint8* bytes = (const uint8*)_data;
+    for (size_t i = 0; i < _size; i++)
+    {
+        _hash ^= bytes[i];
+        _hash *= 0x100000001b3ull;
+    }
+    return _hash;
+}
+
+/// 64-bit hash of a NUL-terminated string, without the terminator.
+inline uint64 Fnv1a64String(const char* _str, uint64 _hash = kFnv1a64Basis)
+{
+    for (; *_str; _str++)
+    {
+        _hash ^= uint8(*_str);
+        _hash *= 0x100000001b3ull;
+    }
+    return _hash;
+}
+
+/// 32-bit hash of a NUL-terminated string, usable in constant expressions.
+constexpr uint32 Fnv1a32String(const char* _str, uint32 _hash = kFnv1a32Basis)
+{
+    return *_str ? Fnv1a32String(_str + 1, (_hash ^ uint8(*_str)) * 0x01000193u) : _hash;
+}
+
+#endif
@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "hot_reload.h"
+#include "harness.h"
+#include "profiler.h"
+#include "shader.hpp"
+#include "program_reflection.h"
+#include "state_cache.h"
+
+static const int kHotReloadPollMs = 100;       ///< longest wait for file events; also the stop latency
+static const int kHotReloadSettleMs = 150;     ///< quiet time after the last change before rebuilding
+
+struct ProgramRecipe
+{
+    ProgramDesc                 desc;
+    std::vector<std::string>    files;      ///< stage and #include files
+};
+
+struct WatchedProgram
+{
+    GLuint*             pProgram;
+    ProgramReloadedProc onReload;
+    ProgramRecipe       recipe;
+    bool                dirty;          ///< a file changed since the last rebuild started
+    std::string         changedFile;    ///< the last one that did
+};
+
+/// Built by the reload thread, waiting for its fence and the next frame boundary.
+struct ReloadedProgram
+{
+    size_t      watch;
+    GLuint      program;
+    GLsync      fence;
+};
+
+static bool enabled = false;
+static SharedContextProcs contextProcs = { NULL, NULL, NULL };
+
+static std::thread worker;
+static std::atomic<bool> stopWorker(false);
+static std::atomic<uint32> reloadedCount(0);   ///< reloaded.size(), read without the lock every frame
+
+// Guarded by reloadMutex. shader.cpp calls HotReloadTrackProgram() with its own lock held,
+// so nothing here may build programs or call back into a scene while holding reloadMutex.
+static std::mutex reloadMutex;
+static std::unordered_map<GLuint, ProgramRecipe> recipes;
+static std::vector<WatchedProgram> watched;
+static std::vector<ReloadedProgram> reloaded;
+static uint32 scene = 0;                ///< bumped at the end of every scene
+static bool watchListChanged = false;
+static uint32 failedBuilds = 0;
+
+static uint32 swappedPrograms = 0;      ///< render thread only
+
+// ----------------------------------------------------------------------------------------------------------------
+// The files of every watched program; false if they did not change since the last call.
+static bool GetWatchedFiles(std::unordered_set<std::string>& _files)
+{
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    if (!watchListChanged)
+        return false;
+
+    watchListChanged = false;
+    _files.clear();
+    for (size_t i = 0; i < watched.size(); i++)
+    {
+        _files.insert(watched[i].recipe.files.begin(), watched[i].recipe.files.end());
+    }
+    return true;
+}
+
+static bool MarkChanged(const std::string& _path)
+{
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    bool any = false;
+    for (size_t i = 0; i < watched.size(); i++)
+    {
+        const std::vector<std::string>& files = watched[i].recipe.files;
+        if (std::find(files.begin(), files.end(), _path) != files.end())
+        {
+            debug("Hot reload: '%s' changed", _path.c_str());
+            watched[i].dirty = true;
+            watched[i].changedFile = _path;
+            any = true;
+        }
+    }
+    return any;
+}
+
+// Reload thread. Builds every dirty program in one batch, then fences each result for the
+// render thread; a rebuild that finishes after its scene ended is thrown away.
+static void RebuildDirtyPrograms()
+{
+    PROFILE_SCOPE("HotReloadRebuild");
+    std::vector<size_t> indices;
+    std::vector<ProgramRecipe> builds;
+    std::vector<std::string> changedFiles;
+    uint32 buildScene = 0;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        buildScene = scene;
+        for (size_t i = 0; i < watched.size(); i++)
+        {
+            if (!watched[i].dirty)
+                continue;
+            watched[i].dirty = false;
+            indices.push_back(i);
+            builds.push_back(watched[i].recipe);
+            changedFiles.push_back(watched[i].changedFile);
+        }
+    }
+    if (builds.empty())
+        return;
+
+    std::vector<GLuint> programs(builds.size(), 0);
+    ProgramBatch batch;
+    batch.linkErrorsFatal = false;
+    for (size_t i = 0; i < builds.size(); i++)
+    {
+        AddToProgramBatch(batch, &programs[i], builds[i].desc);
+    }
+    BuildProgramBatch(batch);
+
+    std::vector<GLsync> fences(programs.size(), (GLsync)0);
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        if (programs[i])
+            fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glFlush();      // the render context can only see a fence once it was flushed
+
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        if (!programs[i])
+        {
+            // The compile or link log above names the failing file; this names the edit.
+            warn("Hot reload: program using '%s' failed to build after it changed, keeping the running program.",
+                 changedFiles[i].c_str());
+            failedBuilds++;
+        }
+        else if (buildScene != scene)
+        {
+            glDeleteSync(fences[i]);
+            glDeleteProgram(programs[i]);
+        }
+        else
+        {
+            ReloadedProgram result = { indices[i], programs[i], fences[i] };
+            reloaded.push_back(result);
+        }
+    }
+    reloadedCount = uint32(reloaded.size());
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+// File watching. Directories are watched rather than files: editors often write a
+// temporary and rename it over the original, which a watch on the file itself would lose.
+#ifdef __linux__
+
+static int inotifyFd = -1;
+static std::unordered_set<std::string> watchedDirs;
+static std::unordered_map<int, std::string> watchDescriptors;  ///< -> directory
+
+static bool OpenWatcher()
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+    {
+        warn("Hot reload: inotify_init1 failed, shader files are not watched.");
+        return false;
+    }
+    return true;
+}
+
+static void CloseWatcher()
+{
+    close(inotifyFd);
+    inotifyFd = -1;
+    watchedDirs.clear();
+    watchDescriptors.clear();
+}
+
+// Directories stay watched once added; events of files nobody uses are simply ignored.
+static void UpdateWatches(const std::unordered_set<std::string>& _files)
+{
+    for (std::unordered_set<std::string>::const_iterator it = _files.begin(); it != _files.end(); ++it)
+    {
+        std::string dir = it->substr(0, it->rfind('/'));
+        if (!watchedDirs.insert(dir).second)
+            continue;
+        int wd = inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+        {
+            warn("Hot reload: unable to watch '%s'", dir.c_str());
+            continue;
+        }
+        watchDescriptors[wd] = dir;
+    }
+}
+
+static void WaitForChanges(const std::unordered_set<std::string>& _files, std::vector<std::string>& _changed)
+{
+    (void)_files;
+    struct pollfd pfd = { inotifyFd, POLLIN, 0 };
+    if (poll(&pfd, 1, kHotReloadPollMs) <= 0)
+        return;
+
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+    {
+        for (const char* p = buffer; p < buffer + length;)
+        {
+            const struct inotify_event* pEvent = (const struct inotify_event*)p;
+            std::unordered_map<int, std::string>::const_iterator dir = watchDescriptors.find(pEvent->wd);
+            if (pEvent->len > 0 && dir != watchDescriptors.end())
+            {
+                _changed.push_back(dir->second + "/" + pEvent->name);
+            }
+            p += sizeof(struct inotify_event) + pEvent->len;
+        }
+    }
+}
+
+#else
+
+// No inotify: poll size and modification time of every watched file.
+static std::unordered_map<std::string, uint64> stamps;
+
+static bool GetFileStamp(const std::string& _path, uint64& _stamp)
+{
+    struct stat info;
+    if (stat(_path.c_str(), &info) != 0)
+        return false;
+    _stamp = (uint64(info.st_mtime) << 32) ^ uint64(info.st_size);
+    return true;
+}
+
+static bool OpenWatcher()
+{
+    return true;
+}
+
+static void CloseWatcher()
+{
+    stamps.clear();
+}
+
+static void UpdateWatches(const std::unordered_set<std::string>& _files)
+{
+    for (std::unordered_set<std::string>::const_iterator it = _files.begin(); it != _files.end(); ++it)
+    {
+        uint64 stamp = 0;
+        if (stamps.find(*it) == stamps.end() && GetFileStamp(*it, stamp))
+            stamps[*it] = stamp;
+    }
+}
+
+static void WaitForChanges(const std::unordered_set<std::string>& _files, std::vector<std::string>& _changed)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(kHotReloadPollMs));
+    for (std::unordered_set<std::string>::const_iterator it = _files.begin(); it != _files.end(); ++it)
+    {
+        uint64 stamp = 0;
+        if (GetFileStamp(*it, stamp) && stamps[*it] != stamp)
+        {
+            stamps[*it] = stamp;
+            _changed.push_back(*it);
+        }
+    }
+}
+
+#endif
+
+static void WorkerMain()
+{
+    ProfilerSetThreadName("hot reload");
+    if (!contextProcs.MakeCurrent(true))
+    {
+        warn("Hot reload: unable to bind the shared context, programs are not reloaded.");
+        return;
+    }
+
+    if (OpenWatcher())
+    {
+        std::unordered_set<std::string> files;
+        std::vector<std::string> changed;
+        std::chrono::steady_clock::time_point lastChange;
+        bool pending = false;
+        while (!stopWorker)
+        {
+            if (GetWatchedFiles(files))
+            {
+                UpdateWatches(files);
+            }
+
+            changed.clear();
+            WaitForChanges(files, changed);
+            for (size_t i = 0; i < changed.size(); i++)
+            {
+                if (MarkChanged(changed[i]))
+                {
+                    pending = true;
+                    lastChange = std::chrono::steady_clock::now();
+                }
+            }
+
+            // Saving usually is a burst of events; build once the files are quiet.
+            if (pending && std::chrono::steady_clock::now() - lastChange >= std::chrono::milliseconds(kHotReloadSettleMs))
+            {
+                pending = false;
+                RebuildDirtyPrograms();
+            }
+        }
+        CloseWatcher();
+    }
+
+    contextProcs.MakeCurrent(false);
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void HotReloadSetContextProcs(const SharedContextProcs& _procs)
+{
+    contextProcs = _procs;
+}
+
+void HotReloadInit()
+{
+    if (!g_harnessOptions.hotReload)
+        return;
+
+    if (!contextProcs.Create)
+    {
+        warn("--hot-reload: this window system cannot share a context, hot reload disabled.");
+        return;
+    }
+    if (!contextProcs.Create())
+    {
+        warn("--hot-reload: unable to create a shared context, hot reload disabled.");
+        return;
+    }
+
+    enabled = true;
+    stopWorker = false;
+    worker = std::thread(WorkerMain);
+    log("Hot reload: watching the shader files of the scenes' programs");
+}
+
+void HotReloadShutdown()
+{
+    if (!enabled)
+        return;
+
+    stopWorker = true;
+    worker.join();
+    HotReloadEndScene();
+    contextProcs.Destroy();
+    enabled = false;
+    log("Hot reload: %u programs swapped in, %u rebuilds failed", swappedPrograms, failedBuilds);
+}
+
+bool IsHotReloadEnabled()
+{
+    return enabled;
+}
+
+void WatchProgram(GLuint* _pProgram, ProgramReloadedProc _onReload)
+{
+    if (!enabled || !_pProgram || !*_pProgram)
+        return;
+
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    std::unordered_map<GLuint, ProgramRecipe>::const_iterator it = recipes.find(*_pProgram);
+    if (it == recipes.end())
+    {
+        warn("Hot reload: program %u was not built from shader files, it is not watched.", *_pProgram);
+        return;
+    }
+
+    WatchedProgram program = { _pProgram, _onReload, it->second, false, std::string() };
+    watched.push_back(program);
+    watchListChanged = true;
+}
+
+void HotReloadApplyPending()
+{
+    if (reloadedCount.load(std::memory_order_relaxed) == 0)
+        return;
+
+    PROFILE_SCOPE("HotReloadApply");
+    struct Swap
+    {
+        GLuint*             pProgram;
+        ProgramReloadedProc onReload;
+        GLuint              program;
+    };
+    std::vector<Swap> swaps;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        for (size_t i = 0; i < reloaded.size();)
+        {
+            ReloadedProgram& result = reloaded[i];
+            if (glClientWaitSync(result.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                i++;
+                continue;
+            }
+            glDeleteSync(result.fence);
+
+            // The new program may include other files than the one it replaces.
+            WatchedProgram& program = watched[result.watch];
+            std::unordered_map<GLuint, ProgramRecipe>::iterator recipe = recipes.find(result.program);
+            if (recipe != recipes.end())
+            {
+                program.recipe = recipe->second;
+                watchListChanged = true;
+            }
+            Swap swap = { program.pProgram, program.onReload, result.program };
+            swaps.push_back(swap);
+            reloaded.erase(reloaded.begin() + i);
+        }
+        reloadedCount = uint32(reloaded.size());
+    }
+
+    for (size_t i = 0; i < swaps.size(); i++)
+    {
+        GLuint old = *swaps[i].pProgram;
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        *swaps[i].pProgram = swaps[i].program;
+        if (GLuint(current) == old)
+        {
+            StateUseProgram(swaps[i].program);
+        }
+        ForgetProgramReflection(old);
+        glDeleteProgram(old);
+        {
+            std::lock_guard<std::mutex> lock(reloadMutex);
+            recipes.erase(old);
+        }
+        if (swaps[i].onReload)
+        {
+            swaps[i].onReload(swaps[i].program);
+        }
+        log("Hot reload: program %u replaced by %u", old, swaps[i].program);
+        swappedPrograms++;
+    }
+}
+
+void HotReloadEndScene()
+{
+    if (!enabled)
+        return;
+
+    std::vector<ReloadedProgram> dropped;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex);
+        scene++;
+        watched.clear();
+        recipes.clear();
+        dropped.swap(reloaded);
+        reloadedCount = 0;
+        watchListChanged = true;
+    }
+    for (size_t i = 0; i < dropped.size(); i++)
+    {
+        glDeleteSync(dropped[i].fence);
+        glDeleteProgram(dropped[i].program);
+    }
+}
+
+void HotReloadTrackProgram(GLuint _program, const ProgramDesc& _desc, const std::vector<std::string>& _files)
+{
+    std::lock_guard<std::mutex> lock(reloadMutex);
+    ProgramRecipe& recipe = recipes[_program];
+    recipe.desc = _desc;
+    recipe.files = _files;
+}
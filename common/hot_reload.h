@@ -0,0 +1,57 @@
+#ifndef _HOT_RELOAD_H_
+#define _HOT_RELOAD_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "main.h"
+
+struct ProgramDesc;
+
+// Shader hot reload (--hot-reload). Scenes hand the programs they want reloaded to
+// WatchProgram(). A reload thread watches the directories of every file those programs
+// were built from, #include files too (inotify on Linux, a stat poll elsewhere), and
+// rebuilds a program once its files have been quiet for a moment, in a context sharing
+// objects with the render context. The new program is fenced and swapped in by the render
+// thread at the next frame boundary whose fence has signaled; it never waits for the
+// compiler. A program that fails to compile or link is reported and the old one stays.
+
+/// Called on the render thread after _program replaced the watched program, e.g. to
+/// query uniform locations and set uniform block bindings again.
+typedef void (*ProgramReloadedProc)(GLuint _program);
+
+/// Window-system hooks for the reload thread's context.
+struct SharedContextProcs
+{
+    bool (*Create)();                   ///< render thread, its context current: share objects with it
+    bool (*MakeCurrent)(bool _current); ///< reload thread: bind the context, or release it
+    void (*Destroy)();                  ///< render thread, after the reload thread released it
+};
+
+/// Backends able to create a shared context call this before RunScenes().
+void HotReloadSetContextProcs(const SharedContextProcs& _procs);
+
+/// Create the shared context and start the reload thread if --hot-reload was given.
+void HotReloadInit();
+void HotReloadShutdown();
+
+bool IsHotReloadEnabled();
+
+/// Rebuild *_pProgram whenever one of its files changes and store the new program there.
+/// The program must come from the CreateProgram family or a ProgramBatch, the pointer must
+/// stay valid until the scene ends. The old program is deleted, and rebound first if it is
+/// the current program. No-op without --hot-reload.
+void WatchProgram(GLuint* _pProgram, ProgramReloadedProc _onReload = NULL);
+
+/// Swap in the programs rebuilt since the last call. Render thread, between frames.
+void HotReloadApplyPending();
+
+/// Forget the scene's watched programs; rebuilds still in flight are dropped.
+void HotReloadEndScene();
+
+/// Record how a program was built (shader.cpp, for every program it links from files).
+/// _desc names the stages by absolute path, _files lists them and their #include files.
+void HotReloadTrackProgram(GLuint _program, const ProgramDesc& _desc, const std::vector<std::string>& _files);
+
+#endif
@@ -0,0 +1,187 @@
+#include "image_compare.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define COMPARE_HAS_SIMD 1
+#define COMPARE_TARGET(_isa)
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COMPARE_HAS_SIMD 1
+#define COMPARE_TARGET(_isa) __attribute__((target(_isa)))
+#else
+#define COMPARE_HAS_SIMD 0
+#endif
+
+typedef void (*CompareRowProc)(const uint8* _a, const uint8* _b, uint32 _pixels, uint8 _tolerance, ImageDiff& _diff);
+
+static CompareRowProc compareRow = NULL;
+static const char* compareKernelName = "";
+
+static uint32 PopCount(uint32 v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return (((v + (v >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+static void CompareRowScalar(const uint8* _a, const uint8* _b, uint32 _pixels, uint8 _tolerance, ImageDiff& _diff)
+{
+    for (uint32 i = 0; i < _pixels; i++, _a += 4, _b += 4)
+    {
+        uint32 worst = 0;
+        for (uint32 c = 0; c < 3; c++)
+        {
+            uint32 d = _a[c] > _b[c] ? _a[c] - _b[c] : _b[c] - _a[c];
+            worst = d > worst ? d : worst;
+        }
+        if (worst > _tolerance)
+            _diff.mismatchedPixels++;
+        if (worst > _diff.maxChannelDiff)
+            _diff.maxChannelDiff = worst;
+    }
+}
+
+#if COMPARE_HAS_SIMD
+// Both kernels work the same way: |a - b| per byte from two saturating subtractions,
+// alpha masked off, then a second saturating subtraction of the tolerance leaves a
+// non-zero byte exactly where a channel is out of tolerance. A 32-bit compare against
+// zero turns that into one mask bit per pixel.
+
+static uint32 MaxByte(const uint8* _bytes, uint32 _count)
+{
+    uint32 worst = 0;
+    for (uint32 i = 0; i < _count; i++)
+        worst = _bytes[i] > worst ? _bytes[i] : worst;
+    return worst;
+}
+
+COMPARE_TARGET("sse2")
+static void CompareRowSSE2(const uint8* _a, const uint8* _b, uint32 _pixels, uint8 _tolerance, ImageDiff& _diff)
+{
+    const __m128i rgbMask = _mm_set1_epi32(0x00ffffff);
+    const __m128i tolerance = _mm_set1_epi8(char(_tolerance));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i worst = zero;
+    uint32 mismatched = 0;
+
+    uint32 i = 0;
+    for (; i + 4 <= _pixels; i += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(_a + i * 4));
+        __m128i b = _mm_loadu_si128((const __m128i*)(_b + i * 4));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        d = _mm_and_si128(d, rgbMask);
+        worst = _mm_max_epu8(worst, d);
+        __m128i within = _mm_cmpeq_epi32(_mm_subs_epu8(d, tolerance), zero);
+        mismatched += 4 - PopCount(uint32(_mm_movemask_ps(_mm_castsi128_ps(within))));
+    }
+
+    uint8 lanes[16];
+    _mm_storeu_si128((__m128i*)lanes, worst);
+    uint32 worstLane = MaxByte(lanes, 16);
+    _diff.mismatchedPixels += mismatched;
+    if (worstLane > _diff.maxChannelDiff)
+        _diff.maxChannelDiff = worstLane;
+
+    CompareRowScalar(_a + i * 4, _b + i * 4, _pixels - i, _tolerance, _diff);
+}
+
+COMPARE_TARGET("avx2")
+static void CompareRowAVX2(const uint8* _a, const uint8* _b, uint32 _pixels, uint8 _tolerance, ImageDiff& _diff)
+{
+    const __m256i rgbMask = _mm256_set1_epi32(0x00ffffff);
+    const __m256i tolerance = _mm256_set1_epi8(char(_tolerance));
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i worst = zero;
+    uint32 mismatched = 0;
+
+    uint32 i = 0;
+    for (; i + 8 <= _pixels; i += 8)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(_a + i * 4));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(_b + i * 4));
+        __m256i d = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+        d = _mm256_and_si256(d, rgbMask);
+        worst = _mm256_max_epu8(worst, d);
+        __m256i within = _mm256_cmpeq_epi32(_mm256_subs_epu8(d, tolerance), zero);
+        mismatched += 8 - PopCount(uint32(_mm256_movemask_ps(_mm256_castsi256_ps(within))));
+    }
+
+    uint8 lanes[32];
+    _mm256_storeu_si256((__m256i*)lanes, worst);
+    uint32 worstLane = MaxByte(lanes, 32);
+    _diff.mismatchedPixels += mismatched;
+    if (worstLane > _diff.maxChannelDiff)
+        _diff.maxChannelDiff = worstLane;
+
+    CompareRowScalar(_a + i * 4, _b + i * 4, _pixels - i, _tolerance, _diff);
+}
+
+static bool CpuHasSSE2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool CpuHasAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const int osxsave = 1 << 27, avx = 1 << 28;
+    if ((info[2] & (osxsave | avx)) != (osxsave | avx))
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;   // the OS does not save the YMM registers
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif // COMPARE_HAS_SIMD
+
+static void SelectKernel()
+{
+#if COMPARE_HAS_SIMD
+    if (CpuHasAVX2())
+    {
+        compareRow = CompareRowAVX2;
+        compareKernelName = "avx2";
+        return;
+    }
+    if (CpuHasSSE2())
+    {
+        compareRow = CompareRowSSE2;
+        compareKernelName = "sse2";
+        return;
+    }
+#endif
+    compareRow = CompareRowScalar;
+    compareKernelName = "scalar";
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void CompareRowRGBA8(const uint8* _a, const uint8* _b, uint32 _pixels, uint8 _tolerance, ImageDiff& _diff)
+{
+    if (!compareRow)
+        SelectKernel();
+    compareRow(_a, _b, _pixels, _tolerance, _diff);
+}
+
+const char* GetCompareKernelName()
+{
+    if (!compareRow)
+        SelectKernel();
+    return compareKernelName;
+}
@@ -0,0 +1,23 @@
+#ifndef _IMAGE_COMPARE_H_
+#define _IMAGE_COMPARE_H_
+
+#include "main.h"
+
+// Tolerant RGBA8 comparison. A pixel mismatches when any of R, G, B differs by more
+// than the tolerance; alpha is ignored since window and FBO alpha are not comparable.
+// The kernels use AVX2 or SSE2 when the CPU has them (picked once at runtime) and
+// fall back to scalar code elsewhere.
+
+struct ImageDiff
+{
+    uint64  mismatchedPixels;
+    uint32  maxChannelDiff;     ///< largest R/G/B difference seen, mismatching or not
+};
+
+/// Accumulate the differences of _pixels pixels of _a and _b into _diff.
+void CompareRowRGBA8(const uint8* _a, const uint8* _b, uint32 _pixels, uint8 _tolerance, ImageDiff& _diff);
+
+/// Name of the kernel CompareRowRGBA8 dispatches to ("avx2", "sse2" or "scalar").
+const char* GetCompareKernelName();
+
+#endif
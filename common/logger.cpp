@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "logger.h"
+
+#ifndef OutputDebugString
+#   define OutputDebugString(_x)
+#endif
+
+// The ring is an array of 16-byte cells. A record is a header cell followed by its
+// payload (the arguments) in the next cells; records never wrap, the tail of the ring
+// is skipped with a padding record instead. Producers claim cells with a CAS on
+// writePos and publish the record by storing its cell count in the header last; the
+// logger thread consumes in order, clears the cells and advances readPos.
+static const uint32 kLogRingCells = 64 * 1024;             ///< 1 MiB
+static const uint32 kLogMaxStringBytes = 8 * 1024;         ///< longer string arguments are truncated
+static const uint32 kLogPaddingLevel = 0xff;
+static const uint32 kLogNullString = 0xffffffffu;          ///< string length recorded for a NULL pointer
+static const int kLogIdleSleepMs = 1;
+
+struct LogCell
+{
+    std::atomic<uint32> cells;      ///< header: record size in cells, 0 until published
+    uint8               level;
+    uint8               argCount;
+    uint16              reserved;
+    const char*         format;
+};
+
+static_assert(sizeof(LogCell) <= 16, "LogCell must fit one 16-byte cell");
+
+// Payload encoding per argument: a type byte, then the 8-byte value, or for strings a
+// 4-byte length followed by the bytes and a terminating zero.
+
+enum LoggerState
+{
+    LOGGER_STOPPED,         ///< not started yet, or shut down: log synchronously
+    LOGGER_STARTING,
+    LOGGER_RUNNING,
+};
+
+struct alignas(16) LogSlot
+{
+    LogCell cell;
+};
+
+static LogSlot ring[kLogRingCells];
+static std::atomic<uint64> writePos(0);         ///< cells claimed by producers
+static std::atomic<uint64> readPos(0);          ///< cells released by the logger thread
+static std::atomic<uint64> flushedPos(0);       ///< cells whose text has been written out
+static std::atomic<int> state(LOGGER_STOPPED);
+static std::atomic<bool> stopRequested(false);
+static std::atomic<bool> shutDown(false);
+static std::thread* pWorker = NULL;
+
+// ----------------------------------------------------------------------------------------------------------------
+static void Print(const std::string& _text)
+{
+    if (_text.empty())
+        return;
+
+    OutputDebugString(_text.c_str());
+#ifdef LINUX
+    fwrite(_text.data(), 1, _text.size(), stderr);
+#endif
+}
+
+static const char* LevelPrefix(uint32 _level)
+{
+    switch (_level)
+    {
+    case OGLTEST_LOG_DEBUG: return "debug: ";
+    case OGLTEST_LOG_WARN:  return "Warning: ";
+    case OGLTEST_LOG_ERROR: return "ERROR: ";
+    }
+    return "";
+}
+
+static long long AsInt(const LogArg& _v)
+{
+    switch (_v.type)
+    {
+    case LOG_ARG_UINT:      return (long long)_v.u;
+    case LOG_ARG_DOUBLE:    return (long long)_v.d;
+    case LOG_ARG_POINTER:   return (long long)(uintptr_t)_v.p;
+    }
+    return _v.i;
+}
+
+static double AsDouble(const LogArg& _v)
+{
+    switch (_v.type)
+    {
+    case LOG_ARG_INT:   return (double)_v.i;
+    case LOG_ARG_UINT:  return (double)_v.u;
+    }
+    return _v.d;
+}
+
+static void AppendFormatted(std::string& _out, const char* _spec, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, _spec);
+    int n = vsnprintf(buffer, sizeof(buffer), _spec, args);
+    va_end(args);
+    if (n < 0)
+        return;
+    if (n < (int)sizeof(buffer))
+    {
+        _out.append(buffer, n);
+        return;
+    }
+
+    size_t start = _out.size();
+    _out.resize(start + n + 1);
+    va_start(args, _spec);
+    vsnprintf(&_out[start], n + 1, _spec, args);
+    va_end(args);
+    _out.resize(start + n);
+}
+
+// Re-run printf one conversion at a time, with the length modifier rewritten to match
+// the captured (widened) argument.
+static void FormatRecord(std::string& _out, const char* _fmt, const LogArg* _values, uint32 _count)
+{
+    uint32 next = 0;
+    const char* p = _fmt;
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            const char* run = p;
+            while (*p && *p != '%')
+                p++;
+            _out.append(run, p - run);
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            _out += '%';
+            p += 2;
+            continue;
+        }
+
+        const char* specBegin = p++;
+        std::string spec = "%";
+        while (*p && strchr("-+ #0", *p))
+            spec += *p++;
+        for (int part = 0; part < 2; part++)   // width, then precision
+        {
+            if (part == 1)
+            {
+                if (*p != '.')
+                    break;
+                spec += *p++;
+            }
+            if (*p == '*')
+            {
+                p++;
+                long long value = next < _count ? AsInt(_values[next++]) : 0;
+                spec += std::to_string(value);
+            }
+            while (*p >= '0' && *p <= '9')
+                spec += *p++;
+        }
+        while (*p && strchr("hljztLqI", *p))
+        {
+            // Length modifiers are dropped: the captured argument decides the width.
+            if (*p++ == 'I')
+            {
+                while (*p >= '0' && *p <= '9')
+                    p++;    // MSVC I32/I64
+            }
+        }
+        char conversion = *p ? *p++ : 0;
+
+        if (!conversion || !strchr("diouxXeEfFgGaAcspn", conversion) || conversion == 'n')
+        {
+            _out.append(specBegin, p - specBegin);
+            continue;
+        }
+        if (next >= _count)
+        {
+            _out.append(specBegin, p - specBegin);  // more conversions than arguments
+            continue;
+        }
+
+        const LogArg& v = _values[next++];
+        switch (conversion)
+        {
+        case 'd': case 'i':
+            AppendFormatted(_out, (spec + "lld").c_str(), AsInt(v));
+            break;
+        case 'o': case 'u': case 'x': case 'X':
+            AppendFormatted(_out, (spec + "ll" + conversion).c_str(), (unsigned long long)AsInt(v));
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            AppendFormatted(_out, (spec + conversion).c_str(), AsDouble(v));
+            break;
+        case 'c':
+            AppendFormatted(_out, (spec + 'c').c_str(), (int)AsInt(v));
+            break;
+        case 's':
+            AppendFormatted(_out, (spec + 's').c_str(), v.type != LOG_ARG_STRING ? "(?)" : v.s ? v.s : "(null)");
+            break;
+        case 'p':
+            AppendFormatted(_out, (spec + 'p').c_str(), v.type == LOG_ARG_POINTER ? v.p : (const void*)(uintptr_t)AsInt(v));
+            break;
+        }
+    }
+}
+
+static void DecodeRecord(std::string& _out, const LogSlot* _pSlot)
+{
+    const LogCell& header = _pSlot->cell;
+    const uint8* payload = (const uint8*)(_pSlot + 1);
+
+    LogArg values[256];
+    for (uint32 i = 0; i < header.argCount; i++)
+    {
+        LogArg& v = values[i];
+        v.type = LogArgType(*payload++);
+        if (v.type == LOG_ARG_STRING)
+        {
+            uint32 length;
+            memcpy(&length, payload, 4);
+            v.s = length == kLogNullString ? NULL : (const char*)payload + 4;
+            payload += 4 + (length == kLogNullString ? 0 : length + 1);
+        }
+        else
+        {
+            memcpy(&v.u, payload, 8);
+            payload += 8;
+        }
+    }
+
+    _out += LevelPrefix(header.level);
+    FormatRecord(_out, header.format, values, header.argCount);
+    _out += '\n';
+}
+
+static void WorkerMain()
+{
+    std::string text;
+    while (1)
+    {
+        uint64 pos = readPos.load(std::memory_order_relaxed);
+        LogSlot* pSlot = &ring[pos % kLogRingCells];
+        uint32 cells = pSlot->cell.cells.load(std::memory_order_acquire);
+        if (!cells)
+        {
+            // Nothing published: write out what was batched, then poll again. Producers
+            // never wake this thread, that would cost them a syscall.
+            Print(text);
+            text.clear();
+            flushedPos.store(pos, std::memory_order_release);
+            if (pos == writePos.load(std::memory_order_acquire))
+            {
+                if (stopRequested.load(std::memory_order_acquire))
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(kLogIdleSleepMs));
+            }
+            else
+            {
+                std::this_thread::yield();  // claimed but not published yet
+            }
+            continue;
+        }
+
+        if (pSlot->cell.level != kLogPaddingLevel)
+        {
+            DecodeRecord(text, pSlot);
+        }
+        memset((void*)pSlot, 0, size_t(cells) * sizeof(LogSlot));
+        readPos.store(pos + cells, std::memory_order_release);
+
+        if (text.size() >= 64 * 1024)
+        {
+            Print(text);
+            text.clear();
+            flushedPos.store(pos + cells, std::memory_order_release);
+        }
+    }
+}
+
+static void LogShutdown()
+{
+    if (state.load() != LOGGER_RUNNING)
+        return;
+
+    stopRequested.store(true, std::memory_order_release);
+    pWorker->join();
+    shutDown.store(true, std::memory_order_release);
+    state.store(LOGGER_STOPPED, std::memory_order_release);
+}
+
+// Start the logger thread on first use; false once it has been shut down.
+static bool EnsureStarted()
+{
+    int current = state.load(std::memory_order_acquire);
+    if (current == LOGGER_RUNNING)
+        return true;
+    if (shutDown.load(std::memory_order_acquire))
+        return false;
+
+    if (current == LOGGER_STOPPED && state.compare_exchange_strong(current, LOGGER_STARTING))
+    {
+        pWorker = new std::thread(WorkerMain);
+        atexit(LogShutdown);
+        state.store(LOGGER_RUNNING, std::memory_order_release);
+        return true;
+    }
+    while (state.load(std::memory_order_acquire) == LOGGER_STARTING)
+        std::this_thread::yield();
+    return state.load(std::memory_order_acquire) == LOGGER_RUNNING;
+}
+
+static uint32 StringLength(const char* _s)
+{
+    if (!_s)
+        return kLogNullString;
+    size_t length = strlen(_s);
+    return length > kLogMaxStringBytes ? kLogMaxStringBytes : uint32(length);
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void LogWrite(int _level, const char* _fmt, const LogArg* _args, uint32 _argCount)
+{
+    if (_argCount > 255)
+        _argCount = 255;
+
+    if (!EnsureStarted())
+    {
+        // After shutdown (late atexit handlers): format on the calling thread.
+        std::string text = LevelPrefix(_level);
+        FormatRecord(text, _fmt, _args, _argCount);
+        text += '\n';
+        Print(text);
+        return;
+    }
+
+    uint32 lengths[256];
+    size_t bytes = 0;
+    for (uint32 i = 0; i < _argCount; i++)
+    {
+        if (_args[i].type == LOG_ARG_STRING)
+        {
+            lengths[i] = StringLength(_args[i].s);
+            bytes += 1 + 4 + (lengths[i] == kLogNullString ? 0 : lengths[i] + 1);
+        }
+        else
+        {
+            bytes += 1 + 8;
+        }
+    }
+    uint32 cells = 1 + uint32((bytes + sizeof(LogSlot) - 1) / sizeof(LogSlot));
+
+    // Up to half the ring a record fits once the logger thread catches up, even with the
+    // padding of a wrap. A larger one never would: drain the queue and format it here.
+    if (cells > kLogRingCells / 2)
+    {
+        std::string text = LevelPrefix(_level);
+        FormatRecord(text, _fmt, _args, _argCount);
+        text += '\n';
+        LogFlush();
+        Print(text);
+        return;
+    }
+
+    // Claim cells, plus padding up to the end of the ring if the record would wrap.
+    uint64 pos = writePos.load(std::memory_order_relaxed);
+    uint32 padding;
+    while (1)
+    {
+        uint32 offset = uint32(pos % kLogRingCells);
+        padding = offset + cells > kLogRingCells ? kLogRingCells - offset : 0;
+        if (pos + padding + cells - readPos.load(std::memory_order_acquire) > kLogRingCells)
+        {
+            // Full: the logger thread is behind by a whole megabyte of records.
+            std::this_thread::yield();
+            pos = writePos.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (writePos.compare_exchange_weak(pos, pos + padding + cells, std::memory_order_acq_rel))
+            break;
+    }
+
+    if (padding)
+    {
+        LogCell& pad = ring[pos % kLogRingCells].cell;
+        pad.level = uint8(kLogPaddingLevel);
+        pad.cells.store(padding, std::memory_order_release);
+        pos += padding;
+    }
+
+    LogSlot* pSlot = &ring[pos % kLogRingCells];
+    uint8* payload = (uint8*)(pSlot + 1);
+    for (uint32 i = 0; i < _argCount; i++)
+    {
+        *payload++ = uint8(_args[i].type);
+        if (_args[i].type == LOG_ARG_STRING)
+        {
+            memcpy(payload, &lengths[i], 4);
+            payload += 4;
+            if (lengths[i] != kLogNullString)
+            {
+                memcpy(payload, _args[i].s, lengths[i]);
+                payload[lengths[i]] = 0;
+                payload += lengths[i] + 1;
+            }
+        }
+        else
+        {
+            memcpy(payload, &_args[i].u, 8);
+            payload += 8;
+        }
+    }
+
+    pSlot->cell.level = uint8(_level);
+    pSlot->cell.argCount = uint8(_argCount);
+    pSlot->cell.format = _fmt;
+    pSlot->cell.cells.store(cells, std::memory_order_release);
+}
+
+void LogFlush()
+{
+    if (state.load(std::memory_order_acquire) != LOGGER_RUNNING)
+        return;
+
+    uint64 target = writePos.load(std::memory_order_acquire);
+    while (flushedPos.load(std::memory_order_acquire) < target)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kLogIdleSleepMs));
+    }
+}
+
+void LogFatal()
+{
+    LogFlush();
+    exit(-1);
+}
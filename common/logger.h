@@ -0,0 +1,125 @@
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include "main.h"
+
+// Asynchronous logger behind debug(), log(), warn() and error(). A call only stores a
+// binary record - the format pointer and the raw arguments, with strings copied - in a
+// lock-free multi-producer ring; a background thread formats the records and writes
+// them out. Logging from the render loop therefore costs no formatting and no syscall.
+// Formats must be string literals (the pointer is kept until the record is printed).
+//
+// Levels below OGLTEST_LOG_LEVEL are compiled out, arguments included; e.g.
+// -DOGLTEST_LOG_LEVEL=2 keeps warnings and errors only.
+
+#define OGLTEST_LOG_DEBUG   0
+#define OGLTEST_LOG_INFO    1
+#define OGLTEST_LOG_WARN    2
+#define OGLTEST_LOG_ERROR   3
+
+#ifndef OGLTEST_LOG_LEVEL
+#ifdef NDEBUG
+#define OGLTEST_LOG_LEVEL   OGLTEST_LOG_INFO
+#else
+#define OGLTEST_LOG_LEVEL   OGLTEST_LOG_DEBUG
+#endif
+#endif
+
+#include <type_traits>
+
+enum LogArgType
+{
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,         ///< copied into the record
+    LOG_ARG_POINTER,
+};
+
+/// One argument as captured on the calling thread.
+struct LogArg
+{
+    LogArgType type;
+    union
+    {
+        long long           i;
+        unsigned long long  u;
+        double              d;
+        const char*         s;
+        const void*         p;
+    };
+};
+
+inline LogArg MakeLogArg(long long _v)              { LogArg a; a.type = LOG_ARG_INT; a.i = _v; return a; }
+inline LogArg MakeLogArg(unsigned long long _v)     { LogArg a; a.type = LOG_ARG_UINT; a.u = _v; return a; }
+inline LogArg MakeLogArg(double _v)                 { LogArg a; a.type = LOG_ARG_DOUBLE; a.d = _v; return a; }
+inline LogArg MakeLogArg(const char* _v)            { LogArg a; a.type = LOG_ARG_STRING; a.s = _v; return a; }
+inline LogArg MakeLogArg(const unsigned char* _v)   { return MakeLogArg((const char*)_v); }    // glGetString()
+inline LogArg MakeLogArg(char _v)                   { return MakeLogArg((long long)_v); }
+inline LogArg MakeLogArg(signed char _v)            { return MakeLogArg((long long)_v); }
+inline LogArg MakeLogArg(short _v)                  { return MakeLogArg((long long)_v); }
+inline LogArg MakeLogArg(int _v)                    { return MakeLogArg((long long)_v); }
+inline LogArg MakeLogArg(long _v)                   { return MakeLogArg((long long)_v); }
+inline LogArg MakeLogArg(bool _v)                   { return MakeLogArg((unsigned long long)_v); }
+inline LogArg MakeLogArg(unsigned char _v)          { return MakeLogArg((unsigned long long)_v); }
+inline LogArg MakeLogArg(unsigned short _v)         { return MakeLogArg((unsigned long long)_v); }
+inline LogArg MakeLogArg(unsigned int _v)           { return MakeLogArg((unsigned long long)_v); }
+inline LogArg MakeLogArg(unsigned long _v)          { return MakeLogArg((unsigned long long)_v); }
+inline LogArg MakeLogArg(float _v)                  { return MakeLogArg((double)_v); }
+inline LogArg MakeLogArg(long double _v)            { return MakeLogArg((double)_v); }
+
+template<typename T>
+inline LogArg MakeLogArg(const T* _v)               { LogArg a; a.type = LOG_ARG_POINTER; a.p = _v; return a; }
+
+template<typename T>
+inline typename std::enable_if<std::is_enum<T>::value, LogArg>::type MakeLogArg(T _v)
+{
+    return MakeLogArg((long long)_v);
+}
+
+/// Queue one record; formatted and written by the logger thread.
+void LogWrite(int _level, const char* _fmt, const LogArg* _args, uint32 _argCount);
+
+/// Block until everything logged so far has been written out.
+void LogFlush();
+
+/// Flush and exit(-1); called by error().
+void LogFatal();
+
+template<typename... Args>
+inline void debug(const char* _fmt, Args... _args)
+{
+#if OGLTEST_LOG_LEVEL <= OGLTEST_LOG_DEBUG
+    const LogArg args[sizeof...(Args) + 1] = { MakeLogArg(_args)... };
+    LogWrite(OGLTEST_LOG_DEBUG, _fmt, args, sizeof...(Args));
+#endif
+}
+
+template<typename... Args>
+inline void log(const char* _fmt, Args... _args)
+{
+#if OGLTEST_LOG_LEVEL <= OGLTEST_LOG_INFO
+    const LogArg args[sizeof...(Args) + 1] = { MakeLogArg(_args)... };
+    LogWrite(OGLTEST_LOG_INFO, _fmt, args, sizeof...(Args));
+#endif
+}
+
+template<typename... Args>
+inline void warn(const char* _fmt, Args... _args)
+{
+#if OGLTEST_LOG_LEVEL <= OGLTEST_LOG_WARN
+    const LogArg args[sizeof...(Args) + 1] = { MakeLogArg(_args)... };
+    LogWrite(OGLTEST_LOG_WARN, _fmt, args, sizeof...(Args));
+#endif
+}
+
+/// Errors are never compiled out; logs, flushes and exits.
+template<typename... Args>
+inline void error(const char* _fmt, Args... _args)
+{
+    const LogArg args[sizeof...(Args) + 1] = { MakeLogArg(_args)... };
+    LogWrite(OGLTEST_LOG_ERROR, _fmt, args, sizeof...(Args));
+    LogFatal();
+}
+
+#endif
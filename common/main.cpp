@@ -4,129 +4,78 @@
 #ifdef _WIN32
 #include <Windows.h>
 #include <GL/wglew.h>
+#include <direct.h>
+#define chdir _chdir
+#define getcwd _getcwd
 #else
 #include <stdarg.h>
+#include <unistd.h>
+#include <getopt.h>
 #endif
 
 #include <string>
+#include <vector>
 using namespace std;
 
-#ifndef OutputDebugString
-#   define OutputDebugString(_x)
-#endif
-
-#ifndef _WINDEF_
-#   define sprintf_s(_buf, _sizeofbuf, _fmt, _args) sprintf(_buf, _fmt, _args) 
-#   define vsprintf_s(_buf, _sizeofbuf, _fmt, _args) vsprintf(_buf, _fmt, _args) 
-#endif
-
-static const int kBufferSize = 4096;
-
-extern bool InitGL(size_t Width, size_t Height);
-extern void ReSizeGLScene(size_t Width, size_t Height);
-extern void DrawGLScene(void);
-extern void DeInitGL(void);
-extern void ProcessCommandLine(int argc, char* argv[]);
-
-void print(const char* _string)
-{
-    OutputDebugString(_string);
-
-#ifdef LINUX
-    fprintf(stderr, "%s", _string);
-#endif // DEBUG
-
-}
-
-// ----------------------------------------------------------------------------------------------------------------
-void debug(const char* _fmt, ...)
-{
-    char buff[kBufferSize - 32],
-        finalBuff[kBufferSize];
-    va_list args;
-    va_start(args, _fmt);
-    vsprintf_s(buff, sizeof(buff), _fmt, args);
-    va_end(args);
-
-    sprintf_s(finalBuff, sizeof(finalBuff), "debug: %s\n", buff);
-    print(finalBuff);
-}
-
-// ----------------------------------------------------------------------------------------------------------------
-void log(const char* _fmt, ...)
-{
-    char buff[kBufferSize - 32],
-        finalBuff[kBufferSize];
-    va_list args;
-    va_start(args, _fmt);
-    vsprintf_s(buff, sizeof(buff), _fmt, args);
-    va_end(args);
-
-    sprintf_s(finalBuff, sizeof(finalBuff), "%s\n", buff);
-    print(finalBuff);
-}
-
-// ----------------------------------------------------------------------------------------------------------------
-void warn(const char* _fmt, ...)
-{
-    char buff[kBufferSize - 32],
-        finalBuff[kBufferSize];
-    va_list args;
-    va_start(args, _fmt);
-    vsprintf_s(buff, sizeof(buff), _fmt, args);
-    va_end(args);
-
-    sprintf_s(finalBuff, sizeof(finalBuff), "Warning: %s\n", buff);
-    print(finalBuff);
-}
+#include "harness.h"
+#include "benchmark.h"
+#include "scene.h"
+#include "pacing.h"
+#include "startup.h"
+#include "config_cache.h"
+#include "offscreen.h"
+#include "readback.h"
+#include "golden.h"
+#include "gl_debug.h"
+#include "caps.h"
+#include "program_cache.h"
+#include "hot_reload.h"
+#include "pipeline_cache.h"
+#include "program_reflection.h"
+#include "state_cache.h"
+#include "gl_record.h"
+#include "gpu_timer.h"
+#include "profiler.h"
 
 // ----------------------------------------------------------------------------------------------------------------
-void error(const char* _fmt, ...)
+static const char* GetErrorName(GLenum Error)
 {
-    char buff[kBufferSize - 32],
-        finalBuff[kBufferSize];
-    va_list args;
-    va_start(args, _fmt);
-    vsprintf_s(buff, sizeof(buff), _fmt, args);
-    va_end(args);
-
-    sprintf_s(finalBuff, sizeof(finalBuff), "ERROR: %s\n", buff);
-    print(finalBuff);
-
-    exit(-1);
+    switch (Error)
+    {
+    case GL_INVALID_ENUM:                   return "GL_INVALID_ENUM";
+    case GL_INVALID_VALUE:                  return "GL_INVALID_VALUE";
+    case GL_INVALID_OPERATION:              return "GL_INVALID_OPERATION";
+    case GL_INVALID_FRAMEBUFFER_OPERATION:  return "GL_INVALID_FRAMEBUFFER_OPERATION";
+    case GL_OUT_OF_MEMORY:                  return "GL_OUT_OF_MEMORY";
+    }
+    return "UNKNOWN";
 }
 
-
 bool CheckError(const char* Title)
 {
-    int Error;
-    if ((Error = glGetError()) != GL_NO_ERROR)
+    if (IsGLDebugActive())
     {
-        std::string ErrorString;
-        switch (Error)
+        // The callback has already reported the details; no glGetError round trip.
+        static uint32 checkedErrors = 0;
+        uint32 errors = GLDebugErrorCount();
+        bool ok = errors == checkedErrors;
+        if (!ok)
         {
-        case GL_INVALID_ENUM:
-            ErrorString = "GL_INVALID_ENUM";
-            break;
-        case GL_INVALID_VALUE:
-            ErrorString = "GL_INVALID_VALUE";
-            break;
-        case GL_INVALID_OPERATION:
-            ErrorString = "GL_INVALID_OPERATION";
-            break;
-        case GL_INVALID_FRAMEBUFFER_OPERATION:
-            ErrorString = "GL_INVALID_FRAMEBUFFER_OPERATION";
-            break;
-        case GL_OUT_OF_MEMORY:
-            ErrorString = "GL_OUT_OF_MEMORY";
-            break;
-        default:
-            ErrorString = "UNKNOWN";
-            break;
+            log("OpenGL Error: %u reported by the debug callback before %s\n", errors - checkedErrors, Title);
         }
-        log("OpenGL Error(%s): %s\n", ErrorString.c_str(), Title);
+        checkedErrors = errors;
+        return ok;
     }
-    return Error == GL_NO_ERROR;
+
+    // Report every pending error flag, not just the first.
+    bool ok = true;
+    GLenum Error;
+    for (int i = 0; i < 8 && (Error = glGetError()) != GL_NO_ERROR; i++)
+    {
+        log("OpenGL Error(%s): %s\n", GetErrorName(Error), Title);
+        ok = false;
+    }
+    return ok;
 }
 
 
@@ -166,20 +115,249 @@ bool CheckFramebuffer(GLuint FramebufferName)
 
 bool CheckExtension(char const* ExtensionName)
 {
-    GLint ExtensionCount = 0;
-    glGetIntegerv(GL_NUM_EXTENSIONS, &ExtensionCount);
-    for (GLint i = 0; i < ExtensionCount; ++i)
-        if (string((char const*)glGetStringi(GL_EXTENSIONS, i)) == string(ExtensionName))
-            return true;
+    if (HasExtension(ExtensionName))
+        return true;
     log("Failed to find Extension: \"%s\"\n", ExtensionName);
     return false;
 }
 
+// ----------------------------------------------------------------------------------------------------------------
+// Scene runner shared by all window-system backends. The backend creates the window and
+// the context once, then hands over to RunScenes(), which runs every selected scene back
+// to back in that context. Per scene, the backend's RunFramesProc renders frames until
+// the frame budget is spent (returns true) or the user quit (returns false).
+
+typedef bool (*RunFramesProc)(FrameStats& stats);
+
+static const Scene* pCurrentScene = NULL;
+static const unsigned int* pWindowWidth = NULL;
+static const unsigned int* pWindowHeight = NULL;
+
+// Frames per scene when several scenes run without an explicit --frames.
+static const uint32 kDefaultSceneFrames = 300;
+
+static void InitGLEW()
+{
+    PROFILE_SCOPE("glewInit");
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK)
+    {
+        error("Failed to initialize GLEW\n");
+    }
+    // glewInit queries GL_EXTENSIONS the legacy way, which core contexts reject.
+    glGetError();
+
+    log("OpenGL version: %s\n", (const char*)glGetString(GL_VERSION));
+    log("OpenGL renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+    log("GLEW version: %s\n", (const char*)glewGetString(GLEW_VERSION));
+}
+
+static void ResizeCurrentScene(size_t Width, size_t Height)
+{
+    // An offscreen target keeps its size; the blit scales it to the window.
+    if (pCurrentScene && !IsOffscreenEnabled())
+    {
+        pCurrentScene->ReSizeGLScene(Width, Height);
+    }
+}
+
+// One frame of the test, bracketed by the GPU timer. Shared by all window-system loops.
+// Programs rebuilt by hot reload are swapped in here, between two frames.
+static void RenderFrame()
+{
+    HotReloadApplyPending();
+    PROFILE_SCOPE("DrawGLScene");
+    GpuTimerBeginFrame();
+    OffscreenBeginFrame();
+    StateCacheBeginFrame();
+    pCurrentScene->DrawGLScene();
+    StateCacheEndFrame();
+    if (IsReadbackEnabled())
+    {
+        if (IsOffscreenEnabled())
+            ReadbackCaptureFrame(OffscreenResolve(), GetOffscreenWidth(), GetOffscreenHeight());
+        else
+            ReadbackCaptureFrame(0, *pWindowWidth, *pWindowHeight);
+    }
+    OffscreenEndFrame(*pWindowWidth, *pWindowHeight);
+    GpuTimerEndFrame();
+}
+
+// Scenes leave their state behind; put back what the next scene could trip over.
+static void ResetSceneState()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glUseProgram(0);
+    glBindProgramPipeline(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLint uniformBindings = GLint(GetCapsLimit(GL_MAX_UNIFORM_BUFFER_BINDINGS));
+    for (GLint i = 0; i < uniformBindings; i++)
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, i, 0);
+    }
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glPatchParameteri(GL_PATCH_VERTICES, 3);
+    static const GLfloat defaultLevels[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, defaultLevels);
+    glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, defaultLevels);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    if (!IsGLDebugActive())
+        glGetError();
+}
+
+// Scenes open their shaders relative to the working directory. Standalone test binaries
+// are started from their own directory; oglbench changes into <root>/<scene dir>.
+static std::string GetSceneRoot()
+{
+    if (g_harnessOptions.sceneRoot)
+        return g_harnessOptions.sceneRoot;
+#ifdef OGLTEST_SCENE_ROOT
+    return OGLTEST_SCENE_ROOT;
+#else
+    return std::string();
+#endif
+}
+
+static int RunScenes(int argc, char** argv, const unsigned int& width, const unsigned int& height,
+                     RunFramesProc runFrames)
+{
+    std::vector<const Scene*> scenes = SelectScenes(g_harnessOptions.scenes);
+    if (scenes.empty())
+    {
+        error("No scene to run.");
+    }
+    if (scenes.size() > 1 && g_harnessOptions.frames == 0)
+    {
+        log("Running %u scenes, %u frames each (use --frames to change).", uint32(scenes.size()), kDefaultSceneFrames);
+        g_harnessOptions.frames = kDefaultSceneFrames;
+    }
+
+    InitGLEW();
+    CapsInit();
+    GLDebugInit();
+    ProgramCacheInit();
+    HotReloadInit();
+    FramePacerInit();
+    OffscreenInit();
+    GoldenInit();
+    ReadbackInit();
+
+    pWindowWidth = &width;
+    pWindowHeight = &height;
+
+    std::string root = GetSceneRoot();
+    char startDir[4096] = "";
+    if (!root.empty() && !getcwd(startDir, sizeof(startDir)))
+    {
+        error("Unable to query the working directory.");
+    }
+
+    std::vector<SceneResult> results;
+    for (size_t i = 0; i < scenes.size(); i++)
+    {
+        const Scene* pScene = scenes[i];
+        if (scenes.size() > 1)
+        {
+            log("==== Scene %s (%u/%u) ====", pScene->name, uint32(i + 1), uint32(scenes.size()));
+        }
+
+        if (!root.empty())
+        {
+            std::string dir = root + "/" + pScene->dir;
+            if (chdir(dir.c_str()) != 0)
+            {
+                error("Unable to enter scene directory '%s'", dir.c_str());
+            }
+        }
+
+        {
+            PROFILE_SCOPE("ProcessCommandLine");
+#ifndef _WIN32
+            optind = 0;     // glibc: fully re-initialize getopt for the next scene
+#endif
+            pScene->ProcessCommandLine(argc, argv);
+        }
+
+        pCurrentScene = pScene;
+        {
+            PROFILE_SCOPE("InitGL");
+            size_t sceneWidth = IsOffscreenEnabled() ? GetOffscreenWidth() : width;
+            size_t sceneHeight = IsOffscreenEnabled() ? GetOffscreenHeight() : height;
+            pScene->InitGL(sceneWidth, sceneHeight);
+            pScene->ReSizeGLScene(sceneWidth, sceneHeight);
+        }
+
+        FrameStats stats;
+        FrameStatsReset(stats, g_harnessOptions.warmup, g_harnessOptions.frames);
+        FramePacerReset();
+        GoldenBeginScene(pScene->name);
+        ReadbackBeginScene(pScene->name);
+        bool keepGoing = runFrames(stats);
+        ReadbackEndScene();
+        GoldenEndScene();
+        if (keepGoing && g_harnessOptions.replay)
+        {
+            PROFILE_SCOPE("ReplayBenchmark");
+            ReplayBenchmarkScene(*pScene, g_harnessOptions.replay);
+        }
+
+        SceneResult result = { pScene, FrameStatsSummarize(stats), StateCacheSummarize() };
+        if (IsBenchmarkMode())
+        {
+            PrintFrameStats(pScene->name, result.summary);
+        }
+        results.push_back(result);
+
+        {
+            PROFILE_SCOPE("DeInitGL");
+            GpuTimerShutdown();
+            HotReloadEndScene();
+            pScene->DeInitGL();
+            PipelineCacheEndScene();
+            ReflectionEndScene();
+            ResetSceneState();
+            StateCacheEndScene();
+        }
+        pCurrentScene = NULL;
+
+        if (!root.empty() && chdir(startDir) != 0)
+        {
+            error("Unable to return to '%s'", startDir);
+        }
+
+        if (!keepGoing)
+            break;
+    }
+
+    if (IsBenchmarkMode() && results.size() > 1)
+    {
+        PrintSceneSummary(results);
+    }
+    if (g_harnessOptions.resultsFile)
+    {
+        WriteSceneResults(g_harnessOptions.resultsFile, results);
+    }
+
+    HotReloadShutdown();
+    ReadbackShutdown();
+    OffscreenShutdown();
+    GLDebugReport();
+    ProgramCacheReport();
+    return GoldenFailed() ? 1 : 0;
+}
 
 #ifdef _WIN32
 static	HGLRC hRC;		// Permanent Rendering Context
 static	HDC hDC;		// Private GDI Device Context
 
+static	HWND hMainWnd;		// Window the scenes render into
+static	unsigned int clientWidth;
+static	unsigned int clientHeight;
+static	bool quitRequested = false;
+
 BOOL	keys[256];		// Array Used For The Keyboard Routine
 
 static void
@@ -316,6 +494,7 @@ init_opengl_wgl(HDC real_dc)
         WGL_CONTEXT_MAJOR_VERSION_ARB, 4,
         WGL_CONTEXT_MINOR_VERSION_ARB, 1,
         WGL_CONTEXT_PROFILE_MASK_ARB,  WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+        WGL_CONTEXT_FLAGS_ARB,         g_harnessOptions.glDebug ? WGL_CONTEXT_DEBUG_BIT_ARB : 0,
         0,
     };
 
@@ -354,21 +533,20 @@ LRESULT CALLBACK WndProc(	HWND	hWnd,
     {
         case WM_CREATE:
             hDC = GetDC(hWnd);				// Gets A Device Context For The Window
+            StartupPhaseBegin("CreateContext");
             hRC = init_opengl_wgl(hDC);
+            StartupPhaseEnd();
 
             GetClientRect(hWnd, &Screen);
-            InitGL(Screen.right, Screen.bottom);
+            clientWidth = Screen.right;
+            clientHeight = Screen.bottom;
             break;
 
         case WM_DESTROY:
         case WM_CLOSE:
+            // The scene is torn down by RunScenes() once run_frames() returns.
             ChangeDisplaySettings(NULL, 0);
-
-            DeInitGL();
-            wglMakeCurrent(hDC,NULL);
-            wglDeleteContext(hRC);
-            ReleaseDC(hWnd,hDC);
-
+            quitRequested = true;
             PostQuitMessage(0);
             break;
 
@@ -381,26 +559,102 @@ LRESULT CALLBACK WndProc(	HWND	hWnd,
             break;
 
         case WM_SIZE:
-            ReSizeGLScene(LOWORD(lParam),HIWORD(lParam));
+            clientWidth = LOWORD(lParam);
+            clientHeight = HIWORD(lParam);
+            ResizeCurrentScene(clientWidth, clientHeight);
+            RequestRedraw();
             break;
 
+        case WM_PAINT:
+            RequestRedraw();
+            return (DefWindowProc(hWnd, message, wParam, lParam));
+
         default:
             return (DefWindowProc(hWnd, message, wParam, lParam));
     }
 return (0);
 }
 
+// Context of the hot reload thread, on the window's DC (see hot_reload.h).
+static HGLRC hSharedRC = NULL;
+
+static bool create_shared_context()
+{
+    hSharedRC = wglCreateContext(hDC);
+    if (!hSharedRC)
+        return false;
+    // Only allowed while the new context owns no objects.
+    if (!wglShareLists(hRC, hSharedRC))
+    {
+        wglDeleteContext(hSharedRC);
+        hSharedRC = NULL;
+        return false;
+    }
+    return true;
+}
+
+static bool make_shared_context_current(bool _current)
+{
+    return wglMakeCurrent(_current ? hDC : NULL, _current ? hSharedRC : NULL) != FALSE;
+}
+
+static void destroy_shared_context()
+{
+    wglDeleteContext(hSharedRC);
+    hSharedRC = NULL;
+}
+
+/**
+ * Render frames of the current scene until the benchmark frame budget is spent.
+ * \return false if the window was closed.
+ */
+static bool run_frames(FrameStats& stats)
+{
+    MSG			msg;		// Windows Message Structure
+    bool		onDemand = GetPacingMode() == PACING_ON_DEMAND;
+
+    while (1)
+    {
+        // Process All Messages; on demand, sleep in WaitMessage() until one asks for a frame.
+        while (1)
+        {
+            if (!PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+            {
+                if (!onDemand || ConsumeRedraw())
+                    break;
+                WaitMessage();
+                continue;
+            }
+            if (msg.message == WM_QUIT)
+                return false;
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        if (quitRequested)
+            return false;
+
+        RenderFrame();
+        {
+            PROFILE_SCOPE("SwapBuffers");
+            SwapBuffers(hDC);
+        }
+        if (keys[VK_ESCAPE]) SendMessage(hMainWnd,WM_CLOSE,0,0);
+        if (IsBenchmarkMode() && FrameStatsTick(stats) >= g_harnessOptions.frames)
+            return true;
+        FramePacerWait();
+    }
+}
 
 int WINAPI WinMain(	HINSTANCE	hInstance,
                     HINSTANCE	hPrevInstance,
                     LPSTR		lpCmdLine,
                     int			nCmdShow)
 {
-    MSG			msg;		// Windows Message Structure
     WNDCLASS	wc;			// Windows Class Structure Used To Set Up The Type Of Window
     HWND		hWnd;		// Storage For Window Handle
 
-    ProcessCommandLine(__argc, __argv);
+    ProcessHarnessCommandLine(__argc, __argv);
+    ProfilerInit();
 
     wc.style			= CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
     wc.lpfnWndProc		= (WNDPROC) WndProc;
@@ -435,32 +689,42 @@ int WINAPI WinMain(	HINSTANCE	hInstance,
         MessageBox(0,TEXT("Window Creation Error."),TEXT("Error"),MB_OK|MB_ICONERROR);
         return FALSE;
     }
+    hMainWnd = hWnd;
 
     ShowWindow(hWnd, SW_SHOW);
     UpdateWindow(hWnd);
     SetFocus(hWnd);
     wglMakeCurrent(hDC,hRC);
+    PrintStartupReport();
 
-    while (1)
     {
-        // Process All Messages
-        while (PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE))
+        typedef const char* (WINAPI *wglGetExtensionsStringARBProc)(HDC);
+        wglGetExtensionsStringARBProc pfnGetExtensions =
+            (wglGetExtensionsStringARBProc)wglGetProcAddress("wglGetExtensionsStringARB");
+        CapsSetWindowSystem("WGL", "", pfnGetExtensions ? pfnGetExtensions(hDC) : "");
+    }
+
+    if (g_harnessOptions.noVsync)
+    {
+        typedef BOOL (WINAPI *wglSwapIntervalEXTProc)(int);
+        wglSwapIntervalEXTProc pfnSwapInterval = (wglSwapIntervalEXTProc)wglGetProcAddress("wglSwapIntervalEXT");
+        if (!pfnSwapInterval || !pfnSwapInterval(0))
         {
-            if (GetMessage(&msg, NULL, 0, 0))
-            {
-                TranslateMessage(&msg);
-                DispatchMessage(&msg);
-            }
-            else
-            {
-                return TRUE;
-            }
+            warn("Failed to disable vsync: WGL_EXT_swap_control is not available.");
         }
-
-        DrawGLScene();
-        SwapBuffers(hDC);
-        if (keys[VK_ESCAPE]) SendMessage(hWnd,WM_CLOSE,0,0);
     }
+
+    static const SharedContextProcs sharedContextProcs =
+        { create_shared_context, make_shared_context_current, destroy_shared_context };
+    HotReloadSetContextProcs(sharedContextProcs);
+
+    int exitCode = RunScenes(__argc, __argv, clientWidth, clientHeight, run_frames);
+
+    wglMakeCurrent(hDC,NULL);
+    wglDeleteContext(hRC);
+    ReleaseDC(hWnd,hDC);
+    DestroyWindow(hWnd);
+    return exitCode;
 }
 #else
 
@@ -471,7 +735,10 @@ int WINAPI WinMain(	HINSTANCE	hInstance,
 #include <unistd.h>
 
 #if WINSYS_EGL
+#include <signal.h>
+#include <pthread.h>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #else
 #include <GL/glx.h>
 #include <X11/keysym.h>
@@ -479,11 +746,6 @@ int WINAPI WinMain(	HINSTANCE	hInstance,
 #include <X11/Xutil.h>
 #endif
 
-#define GLX_CONTEXT_MAJOR_VERSION_ARB       0x2091
-#define GLX_CONTEXT_MINOR_VERSION_ARB       0x2092
-typedef GLXContext (*glXCreateContextAttribsARBProc)(Display*, GLXFBConfig, GLXContext, Bool, const int*);
-#define ESCAPE 27
-
 // Helper to check for extension string presence.  Adapted from:
 //   http://www.opengl.org/resources/features/OGLextensions/
 static bool isExtensionSupported(const char *extList, const char *extension)
@@ -518,6 +780,368 @@ static bool isExtensionSupported(const char *extList, const char *extension)
     return false;
 }
 
+#if WINSYS_EGL
+
+/* stuff about our offscreen EGL surface grouped together */
+typedef struct {
+    EGLDisplay display;
+    EGLConfig config;
+    EGLSurface surface;
+    EGLContext ctx;
+    unsigned int width, height;
+} EGLWindow;
+EGLWindow EGLWin;
+
+// There is no window to close on a render farm; SIGINT/SIGTERM end the loop cleanly
+// so DeInitGL() still runs.
+static volatile sig_atomic_t quitRequested = 0;
+static void handle_signal(int sig)
+{
+    (void) sig;
+    quitRequested = 1;
+}
+
+/**
+ * Prefer the Mesa surfaceless platform: it needs neither an X server nor a DRM master,
+ * so it works on headless boxes (llvmpipe or a render node). Fall back to the default
+ * display otherwise.
+ */
+static EGLDisplay
+get_egl_display(void)
+{
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+
+    const char *clientExts = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+    if ( clientExts &&
+         isExtensionSupported( clientExts, "EGL_EXT_platform_base" ) &&
+         isExtensionSupported( clientExts, "EGL_MESA_platform_surfaceless" ) )
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+        if ( eglGetPlatformDisplayEXT )
+        {
+            dpy = eglGetPlatformDisplayEXT( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+            if ( dpy != EGL_NO_DISPLAY )
+            {
+                log( "Using EGL_MESA_platform_surfaceless display.\n" );
+                return dpy;
+            }
+        }
+    }
+
+    log( "Using default EGL display.\n" );
+    return eglGetDisplay( EGL_DEFAULT_DISPLAY );
+}
+
+/**
+ * Nothing but the scene itself can ask a pbuffer for a frame: on demand, an idle
+ * scene sleeps here until SIGINT/SIGTERM. The signals are blocked around the check
+ * so one arriving in between is not lost.
+ */
+static void
+wait_for_quit_signal(void)
+{
+    sigset_t quitSignals, oldMask;
+    sigemptyset( &quitSignals );
+    sigaddset( &quitSignals, SIGINT );
+    sigaddset( &quitSignals, SIGTERM );
+
+    pthread_sigmask( SIG_BLOCK, &quitSignals, &oldMask );
+    while ( !quitRequested )
+    {
+        sigsuspend( &oldMask );
+    }
+    pthread_sigmask( SIG_SETMASK, &oldMask, NULL );
+}
+
+/**
+ * Context of the hot reload thread (see hot_reload.h). It gets a 1x1 pbuffer of its own:
+ * a surface can only be current in one thread.
+ */
+static EGLContext sharedCtx = EGL_NO_CONTEXT;
+static EGLSurface sharedSurface = EGL_NO_SURFACE;
+
+static bool
+create_shared_context(void)
+{
+    const EGLint pbuffer_attribs[] =
+    {
+        EGL_WIDTH   , 1,
+        EGL_HEIGHT  , 1,
+        EGL_NONE
+    };
+    sharedSurface = eglCreatePbufferSurface( EGLWin.display, EGLWin.config, pbuffer_attribs );
+    if ( sharedSurface == EGL_NO_SURFACE )
+        return false;
+
+    const EGLint context_attribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION       , 4,
+        EGL_CONTEXT_MINOR_VERSION       , 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK , EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    sharedCtx = eglCreateContext( EGLWin.display, EGLWin.config, EGLWin.ctx, context_attribs );
+    if ( sharedCtx == EGL_NO_CONTEXT )
+    {
+        eglDestroySurface( EGLWin.display, sharedSurface );
+        sharedSurface = EGL_NO_SURFACE;
+        return false;
+    }
+    return true;
+}
+
+static bool
+make_shared_context_current(bool current)
+{
+    if ( !current )
+    {
+        eglMakeCurrent( EGLWin.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+        return eglReleaseThread() == EGL_TRUE;
+    }
+    // The bound API is per thread.
+    return eglBindAPI( EGL_OPENGL_API ) &&
+           eglMakeCurrent( EGLWin.display, sharedSurface, sharedSurface, sharedCtx );
+}
+
+static void
+destroy_shared_context(void)
+{
+    eglDestroyContext( EGLWin.display, sharedCtx );
+    eglDestroySurface( EGLWin.display, sharedSurface );
+    sharedCtx = EGL_NO_CONTEXT;
+    sharedSurface = EGL_NO_SURFACE;
+}
+
+// A pbuffer swap never blocks and the default pacing does not wait, so without a limit
+// the frame times measure how fast commands are queued while the GPU falls further
+// behind. After every swap this waits for the fence of frame N-2: the percentiles are
+// then the steady-state frame time of a 2-deep queue, as a blocking swap chain would
+// give. With --finish it waits for the frame itself, and they are full round trips.
+static const uint32 kMaxFramesInFlight = 2;
+static GLsync frameFences[kMaxFramesInFlight];
+static uint32 frameFenceIndex = 0;
+
+static void
+limit_frames_in_flight(void)
+{
+    PROFILE_SCOPE("WaitFramesInFlight");
+    if ( g_harnessOptions.finish )
+    {
+        glFinish();
+        return;
+    }
+
+    GLsync& fence = frameFences[frameFenceIndex];
+    if ( fence )
+    {
+        glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED );
+        glDeleteSync( fence );
+    }
+    fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    frameFenceIndex = ( frameFenceIndex + 1 ) % kMaxFramesInFlight;
+}
+
+static void
+drain_frames_in_flight(void)
+{
+    for ( uint32 i = 0; i < kMaxFramesInFlight; i++ )
+    {
+        if ( frameFences[i] )
+            glDeleteSync( frameFences[i] );
+        frameFences[i] = 0;
+    }
+    frameFenceIndex = 0;
+}
+
+/**
+ * Render frames of the current scene until the benchmark frame budget is spent.
+ * \return false if a quit signal arrived.
+ */
+static bool
+run_frames(FrameStats& stats)
+{
+    bool onDemand = GetPacingMode() == PACING_ON_DEMAND;
+    bool done = false;
+
+    while (!quitRequested)
+    {
+        if (onDemand && !ConsumeRedraw())
+        {
+            wait_for_quit_signal();
+            break;
+        }
+
+        RenderFrame();
+        {
+            PROFILE_SCOPE("eglSwapBuffers");
+            eglSwapBuffers( EGLWin.display, EGLWin.surface );
+        }
+        limit_frames_in_flight();
+
+        if (IsBenchmarkMode() && FrameStatsTick(stats) >= g_harnessOptions.frames)
+        {
+            done = true;
+            break;
+        }
+        FramePacerWait();
+    }
+    drain_frames_in_flight();
+    return done;
+}
+
+int main (int argc, char ** argv)
+{
+    signal( SIGINT, handle_signal );
+    signal( SIGTERM, handle_signal );
+
+    ProcessHarnessCommandLine(argc, argv);
+    ProfilerInit();
+    ProfilerBeginEvent("startup");
+
+    StartupPhaseBegin("eglInitialize");
+    EGLWin.display = get_egl_display();
+    if ( EGLWin.display == EGL_NO_DISPLAY )
+    {
+        error( "Failed to get an EGL display.\n" );
+    }
+
+    EGLint egl_major, egl_minor;
+    if ( !eglInitialize( EGLWin.display, &egl_major, &egl_minor ) )
+    {
+        error( "Failed to initialize EGL.\n" );
+    }
+    log( "EGL version: %d.%d\n", egl_major, egl_minor );
+    log( "EGL vendor: %s\n", eglQueryString( EGLWin.display, EGL_VENDOR ) );
+    CapsSetWindowSystem( "EGL", eglQueryString( EGLWin.display, EGL_VERSION ),
+                         eglQueryString( EGLWin.display, EGL_EXTENSIONS ) );
+
+    if ( !eglBindAPI( EGL_OPENGL_API ) )
+    {
+        error( "Desktop OpenGL is not supported by this EGL implementation.\n" );
+    }
+    StartupPhaseEnd();
+
+    // Same color/depth/stencil layout the GLX path asks for, but on a pbuffer.
+    static const EGLint config_attribs[] =
+    {
+        EGL_SURFACE_TYPE    , EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE , EGL_OPENGL_BIT,
+        EGL_RED_SIZE        , 8,
+        EGL_GREEN_SIZE      , 8,
+        EGL_BLUE_SIZE       , 8,
+        EGL_ALPHA_SIZE      , 8,
+        EGL_DEPTH_SIZE      , 24,
+        EGL_STENCIL_SIZE    , 8,
+        EGL_NONE
+    };
+
+    StartupPhaseBegin("eglChooseConfig");
+    EGLint numConfigs = 0;
+    if ( !eglChooseConfig( EGLWin.display, config_attribs, &EGLWin.config, 1, &numConfigs ) ||
+         numConfigs < 1 )
+    {
+        error( "Failed to retrieve an EGL config.\n" );
+    }
+    StartupPhaseEnd();
+
+    StartupPhaseBegin("CreateSurface");
+    EGLWin.width = 800;
+    EGLWin.height = 600;
+    log( "Creating pbuffer...   Width = %d, Height = %d\n", EGLWin.width, EGLWin.height );
+
+    const EGLint pbuffer_attribs[] =
+    {
+        EGL_WIDTH   , (EGLint)EGLWin.width,
+        EGL_HEIGHT  , (EGLint)EGLWin.height,
+        EGL_NONE
+    };
+    EGLWin.surface = eglCreatePbufferSurface( EGLWin.display, EGLWin.config, pbuffer_attribs );
+    if ( EGLWin.surface == EGL_NO_SURFACE )
+    {
+        error( "Failed to create pbuffer surface (0x%x).\n", eglGetError() );
+    }
+    StartupPhaseEnd();
+
+    EGLint context_attribs[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION       , 4,
+        EGL_CONTEXT_MINOR_VERSION       , 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK , EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE                        , EGL_NONE,     // debug request, see below
+        EGL_NONE
+    };
+    // EGL_CONTEXT_OPENGL_DEBUG is EGL 1.5 only; an EGL 1.4 display rejects the context with
+    // it, so there ask through EGL_KHR_create_context, or not at all.
+    if ( g_harnessOptions.glDebug )
+    {
+        const char* eglExtensions = eglQueryString( EGLWin.display, EGL_EXTENSIONS );
+        if ( egl_major > 1 || ( egl_major == 1 && egl_minor >= 5 ) )
+        {
+            context_attribs[6] = EGL_CONTEXT_OPENGL_DEBUG;
+            context_attribs[7] = EGL_TRUE;
+        }
+        else if ( eglExtensions && strstr( eglExtensions, "EGL_KHR_create_context" ) )
+        {
+            context_attribs[6] = EGL_CONTEXT_FLAGS_KHR;
+            context_attribs[7] = EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR;
+        }
+        else
+        {
+            warn( "--gl-debug: EGL %d.%d without EGL_KHR_create_context cannot request a debug context.", egl_major, egl_minor );
+        }
+    }
+
+    StartupPhaseBegin("CreateContext");
+    log( "Creating context ...\n" );
+    EGLWin.ctx = eglCreateContext( EGLWin.display, EGLWin.config, EGL_NO_CONTEXT, context_attribs );
+    if ( EGLWin.ctx == EGL_NO_CONTEXT )
+    {
+        error( "Failed to create GL context (0x%x).\n", eglGetError() );
+    }
+    log( "Created GL 4.1 context" );
+
+    log( "Making context current ...\n" );
+    if ( !eglMakeCurrent( EGLWin.display, EGLWin.surface, EGLWin.surface, EGLWin.ctx ) )
+    {
+        error( "Failed to make EGL context current (0x%x).\n", eglGetError() );
+    }
+    StartupPhaseEnd();
+
+    // A pbuffer is never presented, but keep the request symmetric with GLX.
+    if ( g_harnessOptions.noVsync )
+    {
+        eglSwapInterval( EGLWin.display, 0 );
+    }
+
+    ProfilerEndEvent();
+    PrintStartupReport();
+    log( g_harnessOptions.finish ? "Frame times: glFinish after every frame"
+                                 : "Frame times: at most %u frames in flight", kMaxFramesInFlight );
+
+    static const SharedContextProcs sharedContextProcs =
+        { create_shared_context, make_shared_context_current, destroy_shared_context };
+    HotReloadSetContextProcs( sharedContextProcs );
+
+    int exitCode = RunScenes(argc, argv, EGLWin.width, EGLWin.height, run_frames);
+
+    eglMakeCurrent( EGLWin.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+    eglDestroyContext( EGLWin.display, EGLWin.ctx );
+    eglDestroySurface( EGLWin.display, EGLWin.surface );
+    eglTerminate( EGLWin.display );
+
+    return exitCode;
+}
+
+#else
+
+#define GLX_CONTEXT_MAJOR_VERSION_ARB       0x2091
+#define GLX_CONTEXT_MINOR_VERSION_ARB       0x2092
+typedef GLXContext (*glXCreateContextAttribsARBProc)(Display*, GLXFBConfig, GLXContext, Bool, const int*);
+typedef void (*glXSwapIntervalEXTProc)(Display*, GLXDrawable, int);
+typedef int (*glXSwapIntervalMESAProc)(unsigned int);
+#define ESCAPE 27
+
 static bool ctxErrorOccurred = false;
 static int ctxErrorHandler( Display *dpy, XErrorEvent *ev )
 {
@@ -556,11 +1180,14 @@ handle_event(Display *dpy, Window win, XEvent *event)
    case Expose:
         return DRAW;
    case ConfigureNotify:
+        if (GLWin.width == (unsigned int)event->xconfigure.width &&
+            GLWin.height == (unsigned int)event->xconfigure.height)
+            break;  // moved, not resized
         GLWin.width = event->xconfigure.width;
         GLWin.height = event->xconfigure.height;
         log("Resize event: Width = %d, Height = %d\n", GLWin.width, GLWin.height);
-        ReSizeGLScene(event->xconfigure.width, event->xconfigure.height);
-        break;
+        ResizeCurrentScene(event->xconfigure.width, event->xconfigure.height);
+        return DRAW;
    case KeyPress:
         {
             char buffer[10];
@@ -599,40 +1226,205 @@ handle_event(Display *dpy, Window win, XEvent *event)
    return NOP;
 }
 
-static void
-event_loop(Display *dpy, Window win)
+/**
+ * Render frames of the current scene until the benchmark frame budget is spent.
+ * \return false if the window was closed.
+ */
+static bool
+run_frames(FrameStats& stats)
 {
+   Display *dpy = GLWin.display;
+   Window win = GLWin.win;
+   bool onDemand = GetPacingMode() == PACING_ON_DEMAND;
+
    while (1)
    {
-        int op;
-        while (XPending(dpy) > 0)
+        // Drain every queued event before drawing, so input and resizes are never left
+        // waiting behind a frame. On demand, block in XNextEvent() until one asks for a
+        // frame (Expose, resize, key) or the scene requested a redraw.
+        bool draw = !onDemand || ConsumeRedraw();
+        while (XPending(dpy) > 0 || !draw)
         {
             XEvent event;
             XNextEvent(dpy, &event);
-            op = handle_event(dpy, win, &event);
+            int op = handle_event(dpy, win, &event);
             if (op == EXIT)
-                return;
+                return false;
             else if (op == DRAW)
-                break;
+                draw = true;
+        }
+
+        RenderFrame();
+        {
+            PROFILE_SCOPE("glXSwapBuffers");
+            glXSwapBuffers (GLWin.display, GLWin.win );
         }
 
-        DrawGLScene();
-        glXSwapBuffers (GLWin.display, GLWin.win );
+        if (IsBenchmarkMode() && FrameStatsTick(stats) >= g_harnessOptions.frames)
+            return true;
+        FramePacerWait();
+   }
+}
+
+/**
+ * Context of the hot reload thread (see hot_reload.h). GL 3.0+ contexts may be current
+ * without a drawable (GLX_ARB_create_context), so it needs no window or pbuffer.
+ */
+static GLXFBConfig sharedFbc = NULL;
+static GLXContext sharedCtx = 0;
+
+static bool
+create_shared_context(void)
+{
+    glXCreateContextAttribsARBProc glXCreateContextAttribsARB = (glXCreateContextAttribsARBProc)
+           glXGetProcAddressARB( (const GLubyte *) "glXCreateContextAttribsARB" );
+    if ( !GLWin.ctx || !glXCreateContextAttribsARB )
+        return false;
+
+    int context_attribs[] =
+    {
+        GLX_CONTEXT_MAJOR_VERSION_ARB, 4,
+        GLX_CONTEXT_MINOR_VERSION_ARB, 1,
+        GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+        None
+    };
+
+    ctxErrorOccurred = false;
+    int (*oldHandler)(Display*, XErrorEvent*) = XSetErrorHandler(&ctxErrorHandler);
+    sharedCtx = glXCreateContextAttribsARB( GLWin.display, sharedFbc, GLWin.ctx, True, context_attribs );
+    XSync( GLWin.display, False );
+    XSetErrorHandler( oldHandler );
+    if ( ctxErrorOccurred && sharedCtx )
+    {
+        glXDestroyContext( GLWin.display, sharedCtx );
+        sharedCtx = 0;
     }
+    return sharedCtx != 0;
 }
 
-int main (int argc, char ** argv)
+static bool
+make_shared_context_current(bool current)
 {
-    GLWin.display = XOpenDisplay(0);
-    XEvent event;
+    return glXMakeContextCurrent( GLWin.display, None, None, current ? sharedCtx : NULL ) == True;
+}
 
-    if ( !GLWin.display )
+static void
+destroy_shared_context(void)
+{
+    glXDestroyContext( GLWin.display, sharedCtx );
+    sharedCtx = 0;
+}
+
+/**
+ * Set the swap interval of the current drawable through GLX_EXT_swap_control,
+ * falling back to GLX_MESA_swap_control.
+ */
+static void
+set_swap_interval(Display *dpy, GLXDrawable drawable, const char *glxExts, int interval)
+{
+    if ( isExtensionSupported( glxExts, "GLX_EXT_swap_control" ) )
     {
-        error( "Failed to open X display.\n" );
+        glXSwapIntervalEXTProc glXSwapIntervalEXT = (glXSwapIntervalEXTProc)
+            glXGetProcAddressARB( (const GLubyte *) "glXSwapIntervalEXT" );
+        if ( glXSwapIntervalEXT )
+        {
+            glXSwapIntervalEXT( dpy, drawable, interval );
+            log( "Swap interval set to %d (GLX_EXT_swap_control).\n", interval );
+            return;
+        }
+    }
+
+    if ( isExtensionSupported( glxExts, "GLX_MESA_swap_control" ) )
+    {
+        glXSwapIntervalMESAProc glXSwapIntervalMESA = (glXSwapIntervalMESAProc)
+            glXGetProcAddressARB( (const GLubyte *) "glXSwapIntervalMESA" );
+        if ( glXSwapIntervalMESA && glXSwapIntervalMESA( interval ) == 0 )
+        {
+            log( "Swap interval set to %d (GLX_MESA_swap_control).\n", interval );
+            return;
+        }
+    }
+
+    warn( "Failed to set swap interval: no GLX swap control extension.\n" );
+}
+
+static bool
+has_visual(Display *dpy, GLXFBConfig config)
+{
+    XVisualInfo *vi = glXGetVisualFromFBConfig( dpy, config );
+    if ( !vi )
+        return false;
+    XFree( vi );
+    return true;
+}
+
+/**
+ * Key of the FB config cache: display, screen, GLX server/client (the driver) and
+ * the requested samples.
+ */
+static std::string
+fb_config_cache_key(Display *dpy, int screen, int samples)
+{
+    char key[1024];
+    snprintf( key, sizeof(key), "glx display=%s screen=%d samples=%d server=%s %s client=%s %s",
+              DisplayString( dpy ), screen, samples,
+              glXQueryServerString( dpy, screen, GLX_VENDOR ), glXQueryServerString( dpy, screen, GLX_VERSION ),
+              glXGetClientString( dpy, GLX_VENDOR ), glXGetClientString( dpy, GLX_VERSION ) );
+    return key;
+}
+
+/**
+ * Look up the config cached for this display/driver with --fbconfig-cache.
+ * \return the config, or NULL on a miss or if the cached ID is no longer valid.
+ */
+static GLXFBConfig
+load_cached_fb_config(Display *dpy, int screen, const std::string &key)
+{
+    uint32 id = 0;
+    if ( !LoadCachedConfigId( g_harnessOptions.fbConfigCache, key, id ) )
+        return NULL;
+
+    // GLX_FBCONFIG_ID makes the server ignore every other attribute: no search at all.
+    int id_attribs[] = { GLX_FBCONFIG_ID, int(id), None };
+    int fbcount = 0;
+    GLXFBConfig *fbc = glXChooseFBConfig( dpy, screen, id_attribs, &fbcount );
+    GLXFBConfig config = NULL;
+    if ( fbc && fbcount > 0 && has_visual( dpy, fbc[0] ) )
+        config = fbc[0];
+    if ( fbc )
+        XFree( fbc );
+
+    if ( config )
+        log( "Using cached FB config 0x%x.\n", id );
+    else
+        warn( "Cached FB config 0x%x is not valid anymore, searching again.\n", id );
+    return config;
+}
+
+/**
+ * Pick the window's FB config. All requirements, including --samples, are passed
+ * to glXChooseFBConfig(), which returns the matches sorted by the GLX preference
+ * rules (fewest extra samples/bits first), so the first config with a visual is
+ * taken instead of inspecting every config the server exposes.
+ */
+static GLXFBConfig
+choose_fb_config(Display *dpy, int screen, char *note, size_t noteSize)
+{
+    int samples = int( g_harnessOptions.samples );
+    std::string key;
+    if ( g_harnessOptions.fbConfigCache )
+    {
+        key = fb_config_cache_key( dpy, screen, samples );
+        GLXFBConfig cached = load_cached_fb_config( dpy, screen, key );
+        if ( cached )
+        {
+            snprintf( note, noteSize, "cached" );
+            return cached;
+        }
     }
 
     // Get a matching FB config
-    static int visual_attribs[] =
+    int visual_attribs[] =
     {
         GLX_X_RENDERABLE    , True,
         GLX_DRAWABLE_TYPE   , GLX_WINDOW_BIT,
@@ -645,62 +1437,80 @@ int main (int argc, char ** argv)
         GLX_DEPTH_SIZE      , 24,
         GLX_STENCIL_SIZE    , 8,
         GLX_DOUBLEBUFFER    , True,
-        //GLX_SAMPLE_BUFFERS  , 1,
-        //GLX_SAMPLES         , 4,
+        GLX_SAMPLE_BUFFERS  , samples ? 1 : 0,
+        GLX_SAMPLES         , samples,
         None
     };
 
-    int glx_major, glx_minor;
+    int fbcount = 0;
+    GLXFBConfig *fbc = glXChooseFBConfig( dpy, screen, visual_attribs, &fbcount );
+    if ( !fbc || fbcount == 0 )
+    {
+        error( "Failed to retrieve a framebuffer config with %d samples.\n", samples );
+    }
 
-  // FBConfigs were added in GLX version 1.3.
-    if ( !glXQueryVersion( GLWin.display, &glx_major, &glx_minor ) ||
-       ( ( glx_major == 1 ) && ( glx_minor < 3 ) ) || ( glx_major < 1 ) )
+    GLXFBConfig config = NULL;
+    int i;
+    for ( i = 0; i < fbcount && !config; i++ )
     {
-        error( "Invalid GLX version.\n" );
+        if ( has_visual( dpy, fbc[i] ) )
+            config = fbc[i];
+    }
+    // Be sure to free the FBConfig list allocated by glXChooseFBConfig()
+    XFree( fbc );
+    if ( !config )
+    {
+        error( "None of the %d matching FB configs has a visual.\n", fbcount );
     }
+    snprintf( note, noteSize, "%d candidates, took #%d", fbcount, i );
 
-    log( "Getting matching framebuffer configs.\n");
-    int fbcount;
-    GLXFBConfig *fbc = glXChooseFBConfig(GLWin.display, DefaultScreen( GLWin.display ),
-                                         visual_attribs, &fbcount );
-    if ( !fbc )
+    if ( g_harnessOptions.fbConfigCache )
     {
-        error( "Failed to retrieve a framebuffer config.\n");
+        int id = 0;
+        glXGetFBConfigAttrib( dpy, config, GLX_FBCONFIG_ID, &id );
+        StoreCachedConfigId( g_harnessOptions.fbConfigCache, key, uint32(id) );
     }
-    log( "Found %d matching FB configs.\n", fbcount );
+    return config;
+}
 
-    // Pick the FB config/visual with the most samples per pixel
-    log( "Getting XVisualInfos ...\n" );
-    int best_fbc = -1, worst_fbc = -1, best_num_samp = -1, worst_num_samp = 999;
+int main (int argc, char ** argv)
+{
+    ProcessHarnessCommandLine(argc, argv);
+    ProfilerInit();
+    ProfilerBeginEvent("startup");
 
-    int i;
-    for ( i = 0; i < fbcount; i++ )
+    // The hot reload thread binds its context on the same display connection.
+    if ( g_harnessOptions.hotReload )
     {
-        XVisualInfo *vi = glXGetVisualFromFBConfig( GLWin.display, fbc[i] );
-        if ( vi )
-        {
-            int samp_buf, samples;
-            glXGetFBConfigAttrib( GLWin.display, fbc[i], GLX_SAMPLE_BUFFERS, &samp_buf );
-            glXGetFBConfigAttrib( GLWin.display, fbc[i], GLX_SAMPLES       , &samples  );
-
-            log( "  Matching fbconfig %d, visual ID 0x%2li: SAMPLE_BUFFERS = %d,"
-                    " SAMPLES = %d .\n", i, vi->visualid, samp_buf, samples );
+        XInitThreads();
+    }
 
-        if ( (best_fbc < 0 || samp_buf) && (samples > best_num_samp) )
-            best_fbc = i, best_num_samp = samples;
-        if ( worst_fbc < 0 || !samp_buf || samples < worst_num_samp )
-            worst_fbc = i, worst_num_samp = samples;
-        }
+    StartupPhaseBegin("XOpenDisplay");
+    GLWin.display = XOpenDisplay(0);
+    XEvent event;
 
-        XFree( vi );
+    if ( !GLWin.display )
+    {
+        error( "Failed to open X display.\n" );
     }
+    StartupPhaseEnd();
 
-    GLXFBConfig bestFbc = fbc[ best_fbc ];
-    // Be sure to free the FBConfig list allocated by glXChooseFBConfig()
-    XFree( fbc );
+    StartupPhaseBegin("ChooseFBConfig");
+    int glx_major, glx_minor;
 
-    ProcessCommandLine(argc, argv);
+  // FBConfigs were added in GLX version 1.3.
+    if ( !glXQueryVersion( GLWin.display, &glx_major, &glx_minor ) ||
+       ( ( glx_major == 1 ) && ( glx_minor < 3 ) ) || ( glx_major < 1 ) )
+    {
+        error( "Invalid GLX version.\n" );
+    }
+
+    char fbcNote[64];
+    GLXFBConfig bestFbc = choose_fb_config( GLWin.display, DefaultScreen( GLWin.display ),
+                                            fbcNote, sizeof(fbcNote) );
+    StartupPhaseEnd( fbcNote );
 
+    StartupPhaseBegin("CreateWindow");
     // Get a visual
     XVisualInfo *vi = glXGetVisualFromFBConfig( GLWin.display, bestFbc );
     log( "Chosen visual ID = 0x%li .\n", vi->visualid );
@@ -712,7 +1522,7 @@ int main (int argc, char ** argv)
                                          vi->visual, AllocNone );
     swa.background_pixmap = None ;
     swa.border_pixel      = 0;
-    swa.event_mask        = StructureNotifyMask;
+    swa.event_mask        = StructureNotifyMask | ExposureMask | KeyPressMask;
 
     GLWin.width = 800;
     GLWin.height = 600;
@@ -737,6 +1547,9 @@ int main (int argc, char ** argv)
 
     log( "Mapping window.\n" );
     XMapWindow( GLWin.display, GLWin.win );
+    StartupPhaseEnd();
+
+    StartupPhaseBegin("CreateContext");
 
     // Get the default screen's GLX extension list
     const char *glxExts = glXQueryExtensionsString( GLWin.display, DefaultScreen( GLWin.display ) );
@@ -774,6 +1587,7 @@ int main (int argc, char ** argv)
             GLX_CONTEXT_MAJOR_VERSION_ARB, 4,
             GLX_CONTEXT_MINOR_VERSION_ARB, 1,
             //GLX_CONTEXT_FLAGS_ARB       , GLX_CONTEXT_FORWARD_COMPATIBLE_BIT_ARB,
+            GLX_CONTEXT_FLAGS_ARB       , g_harnessOptions.glDebug ? GLX_CONTEXT_DEBUG_BIT_ARB : 0,
             GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
             None
         };
@@ -805,6 +1619,7 @@ int main (int argc, char ** argv)
     {
         error( "Failed to create an OpenGL context.\n" );
     }
+    StartupPhaseEnd();
 
     // Verifying that context is a direct context
     if ( ! glXIsDirect ( GLWin.display, ctx ) )
@@ -817,27 +1632,41 @@ int main (int argc, char ** argv)
     }
 
     log( "Making context current ...\n" );
+    StartupPhaseBegin("glXMakeCurrent");
     glXMakeCurrent( GLWin.display, GLWin.win, ctx );
+    StartupPhaseEnd();
+
+    if ( g_harnessOptions.noVsync )
+    {
+        set_swap_interval( GLWin.display, GLWin.win, glxExts, 0 );
+    }
 
-    //XSelectInput( GLWin.display,GLWin.win, ExposureMask | KeyPressMask );
     int s = DefaultScreen(GLWin.display);
     log( "Default Screen: %d", s);
 
-    /////////////////////////////////////////
-    // initialize!
-    InitGL(GLWin.width, GLWin.height);
-    ReSizeGLScene(GLWin.width, GLWin.height);
-    /////////////////////////////////////////
-    event_loop(GLWin.display, GLWin.win);
+    char glxVersion[16];
+    snprintf( glxVersion, sizeof(glxVersion), "%d.%d", glx_major, glx_minor );
+    CapsSetWindowSystem( "GLX", glxVersion, glxExts );
+
+    ProfilerEndEvent();
+    PrintStartupReport();
+
+    sharedFbc = bestFbc;
+    static const SharedContextProcs sharedContextProcs =
+        { create_shared_context, make_shared_context_current, destroy_shared_context };
+    HotReloadSetContextProcs( sharedContextProcs );
+
+    int exitCode = RunScenes(argc, argv, GLWin.width, GLWin.height, run_frames);
 
-    DeInitGL();
     glXDestroyContext( GLWin.display, ctx );
     XDestroyWindow( GLWin.display, GLWin.win );
     XFreeColormap( GLWin.display, cmap );
     XCloseDisplay( GLWin.display );
 
-    return 0;
+    return exitCode;
 }
 
 
+#endif // WINSYS_EGL
+
 #endif
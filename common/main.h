@@ -29,7 +29,7 @@
 #endif 
 
 
-#if defined(COMP_VC)
+#if defined(COMP_VC) || defined(_MSC_VER)
 /// 64-bit signed integer
 typedef signed __int64 int64, *pint64;
 
@@ -38,7 +38,7 @@ typedef unsigned __int64 uint64, *puint64;
 #endif // COMP_VC
 
 
-#if defined(COMP_GCC)
+#if defined(COMP_GCC) || defined(__GNUC__)
 /// 64-bit signed integer
 typedef signed long long int64, *pint64;;
 
@@ -92,11 +92,9 @@ using namespace std;
 #define fopen_s(pFile,filename,mode) ((*(pFile))=fopen((filename),  (mode)))
 #endif
 
-void debug(const char* fmt, ...);
-void log(const char* fmt, ...);
-void warn(const char* fmt, ...);
-void error(const char* fmt, ...);
+#include "logger.h"
 
 bool CheckError(const char* Title);
+bool CheckFramebuffer(unsigned int FramebufferName);
 
 #endif
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <GL/glew.h>
+
+#include "offscreen.h"
+#include "harness.h"
+#include "gpu_timer.h"
+#include "caps.h"
+
+struct NamedFormat
+{
+    const char* name;
+    GLenum      internalFormat;
+    GLenum      attachment;
+};
+
+static const NamedFormat colorFormats[] =
+{
+    { "rgba8",      GL_RGBA8,               GL_COLOR_ATTACHMENT0 },
+    { "rgb10a2",    GL_RGB10_A2,            GL_COLOR_ATTACHMENT0 },
+    { "r11g11b10f", GL_R11F_G11F_B10F,      GL_COLOR_ATTACHMENT0 },
+    { "rgba16f",    GL_RGBA16F,             GL_COLOR_ATTACHMENT0 },
+    { "rgba32f",    GL_RGBA32F,             GL_COLOR_ATTACHMENT0 },
+};
+
+static const NamedFormat depthFormats[] =
+{
+    { "none",       GL_NONE,                GL_NONE },
+    { "d16",        GL_DEPTH_COMPONENT16,   GL_DEPTH_ATTACHMENT },
+    { "d24",        GL_DEPTH_COMPONENT24,   GL_DEPTH_ATTACHMENT },
+    { "d32f",       GL_DEPTH_COMPONENT32F,  GL_DEPTH_ATTACHMENT },
+    { "d24s8",      GL_DEPTH24_STENCIL8,    GL_DEPTH_STENCIL_ATTACHMENT },
+    { "d32fs8",     GL_DEPTH32F_STENCIL8,   GL_DEPTH_STENCIL_ATTACHMENT },
+};
+
+struct SizePreset
+{
+    const char* name;
+    uint32      width;
+    uint32      height;
+};
+
+static const SizePreset sizePresets[] =
+{
+    { "720p",   1280,   720 },
+    { "1080p",  1920,   1080 },
+    { "1440p",  2560,   1440 },
+    { "4k",     3840,   2160 },
+    { "8k",     7680,   4320 },
+};
+
+static bool enabled = false;
+static uint32 width = 0;
+static uint32 height = 0;
+static GLsizei samples = 0;
+
+static GLuint framebuffer = 0;
+static GLuint colorBuffer = 0;
+static GLuint depthBuffer = 0;
+
+// Single-sampled copy of a multisampled target, for the scaled blit (a multisample
+// blit cannot scale) and for readback.
+static GLuint resolveFramebuffer = 0;
+static GLuint resolveColorBuffer = 0;
+static bool resolved = false;
+
+static const NamedFormat* FindFormat(const NamedFormat* formats, size_t count, const char* name, const char* option)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(formats[i].name, name) == 0)
+            return &formats[i];
+    }
+
+    std::string names;
+    for (size_t i = 0; i < count; i++)
+    {
+        names += i ? ", " : "";
+        names += formats[i].name;
+    }
+    error("Unknown --%s '%s' (%s)", option, name, names.c_str());
+    return NULL;
+}
+
+static void ParseSize(const char* str)
+{
+    for (uint32 i = 0; i < ArraySize(sizePresets); i++)
+    {
+        if (strcmp(sizePresets[i].name, str) == 0)
+        {
+            width = sizePresets[i].width;
+            height = sizePresets[i].height;
+            return;
+        }
+    }
+
+    char tail = 0;
+    if (sscanf(str, "%ux%u%c", &width, &height, &tail) != 2 || width == 0 || height == 0)
+    {
+        error("--offscreen expects WxH or one of 720p, 1080p, 1440p, 4k, 8k; got '%s'", str);
+    }
+}
+
+static GLuint CreateRenderbuffer(GLenum internalFormat, GLsizei sampleCount)
+{
+    GLuint renderbuffer = 0;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    if (sampleCount > 0)
+    {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, sampleCount, internalFormat, width, height);
+    }
+    else
+    {
+        glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    return renderbuffer;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void OffscreenInit()
+{
+    if (!g_harnessOptions.offscreen)
+        return;
+
+    ParseSize(g_harnessOptions.offscreen);
+    const NamedFormat* color = FindFormat(colorFormats, ArraySize(colorFormats),
+        g_harnessOptions.colorFormat ? g_harnessOptions.colorFormat : "rgba8", "color-format");
+    const NamedFormat* depth = FindFormat(depthFormats, ArraySize(depthFormats),
+        g_harnessOptions.depthFormat ? g_harnessOptions.depthFormat : "d24s8", "depth-format");
+
+    GLint maxSize = GLint(GetCapsLimit(GL_MAX_RENDERBUFFER_SIZE));
+    GLint maxSamples = GLint(GetCapsLimit(GL_MAX_SAMPLES));
+    if (width > uint32(maxSize) || height > uint32(maxSize))
+    {
+        error("Offscreen target %ux%u exceeds GL_MAX_RENDERBUFFER_SIZE (%d)", width, height, maxSize);
+    }
+    samples = GLsizei(g_harnessOptions.msaa);
+    if (samples > maxSamples)
+    {
+        warn("--msaa %d exceeds GL_MAX_SAMPLES, using %d", samples, maxSamples);
+        samples = maxSamples;
+    }
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    colorBuffer = CreateRenderbuffer(color->internalFormat, samples);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, color->attachment, GL_RENDERBUFFER, colorBuffer);
+    if (depth->internalFormat != GL_NONE)
+    {
+        depthBuffer = CreateRenderbuffer(depth->internalFormat, samples);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, depth->attachment, GL_RENDERBUFFER, depthBuffer);
+    }
+    if (!CheckFramebuffer(framebuffer))
+    {
+        error("Offscreen target %ux%u %s/%s %dx is not supported", width, height, color->name, depth->name, samples);
+    }
+
+    if (samples > 0)
+    {
+        glGenFramebuffers(1, &resolveFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer);
+        resolveColorBuffer = CreateRenderbuffer(color->internalFormat, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveColorBuffer);
+        if (!CheckFramebuffer(resolveFramebuffer))
+        {
+            error("Offscreen resolve target %ux%u %s is not supported", width, height, color->name);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    CheckError("OffscreenInit");
+    log("Offscreen target: %ux%u, color %s, depth %s, %d samples%s", width, height, color->name, depth->name,
+        samples, g_harnessOptions.blit ? ", blit to window" : "");
+    enabled = true;
+}
+
+void OffscreenShutdown()
+{
+    if (!enabled)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer)
+        glDeleteRenderbuffers(1, &depthBuffer);
+    if (resolveFramebuffer)
+    {
+        glDeleteFramebuffers(1, &resolveFramebuffer);
+        glDeleteRenderbuffers(1, &resolveColorBuffer);
+    }
+    framebuffer = colorBuffer = depthBuffer = resolveFramebuffer = resolveColorBuffer = 0;
+    enabled = false;
+}
+
+bool IsOffscreenEnabled()
+{
+    return enabled;
+}
+
+uint32 GetOffscreenWidth()
+{
+    return width;
+}
+
+uint32 GetOffscreenHeight()
+{
+    return height;
+}
+
+void OffscreenBeginFrame()
+{
+    if (!enabled)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    resolved = false;
+}
+
+uint32 OffscreenResolve()
+{
+    if (!resolveFramebuffer)
+        return framebuffer;
+
+    if (!resolved)
+    {
+        GPU_SCOPE("offscreen resolve");
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        resolved = true;
+    }
+    return resolveFramebuffer;
+}
+
+void OffscreenEndFrame(uint32 _windowWidth, uint32 _windowHeight)
+{
+    if (!enabled)
+        return;
+
+    if (g_harnessOptions.blit)
+    {
+        GLuint source = OffscreenResolve();
+        GPU_SCOPE("offscreen blit");
+
+        GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, _windowWidth, _windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        if (scissor)
+            glEnable(GL_SCISSOR_TEST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
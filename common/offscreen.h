@@ -0,0 +1,29 @@
+#ifndef _OFFSCREEN_H_
+#define _OFFSCREEN_H_
+
+#include "main.h"
+
+// Offscreen render target selected with --offscreen WxH: every scene draws into an FBO
+// of that size instead of the window, so fill-rate scaling can be measured independently
+// of the window system. --color-format, --depth-format and --msaa pick the attachments;
+// --blit resolves the target and scales it into the window after every frame.
+
+/// Create the target if --offscreen was given. Needs a current context and GLEW.
+void OffscreenInit();
+void OffscreenShutdown();
+
+bool IsOffscreenEnabled();
+uint32 GetOffscreenWidth();
+uint32 GetOffscreenHeight();
+
+/// Bind the target as the draw framebuffer for the scene.
+void OffscreenBeginFrame();
+
+/// Single-sampled framebuffer holding this frame's image, resolving MSAA once per frame.
+uint32 OffscreenResolve();
+
+/// Resolve and blit into the window's framebuffer if --blit was given; leaves the
+/// default framebuffer bound.
+void OffscreenEndFrame(uint32 _windowWidth, uint32 _windowHeight);
+
+#endif
@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "pacing.h"
+#include "harness.h"
+#include "benchmark.h"
+#include "profiler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// Sleep until this long before the deadline, then spin. The OS sleep overshoots by up to
+// a scheduler tick; Windows' default timer resolution needs a larger margin.
+#ifdef _WIN32
+static const uint64 kPacingSpinNs = 2000000;
+#else
+static const uint64 kPacingSpinNs = 1000000;
+#endif
+
+static const uint32 kDefaultTargetFps = 60;
+
+static PacingMode pacingMode = PACING_UNTHROTTLED;
+static uint64 framePeriodNs = 0;
+static uint64 nextFrameNs = 0;
+static bool redrawRequested = false;
+
+static void SleepNs(uint64 ns)
+{
+#ifdef _WIN32
+    Sleep(DWORD(ns / 1000000));
+#else
+    struct timespec ts;
+    ts.tv_sec = time_t(ns / 1000000000ull);
+    ts.tv_nsec = long(ns % 1000000000ull);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void FramePacerInit()
+{
+    const char* mode = g_harnessOptions.pacing;
+    uint32 targetFps = g_harnessOptions.targetFps;
+
+    if (!mode)
+    {
+        // --target-fps alone selects fps pacing.
+        pacingMode = targetFps ? PACING_TARGET_FPS : PACING_UNTHROTTLED;
+    }
+    else if (strcmp(mode, "unthrottled") == 0)
+    {
+        pacingMode = PACING_UNTHROTTLED;
+    }
+    else if (strcmp(mode, "fps") == 0)
+    {
+        pacingMode = PACING_TARGET_FPS;
+    }
+    else if (strcmp(mode, "ondemand") == 0)
+    {
+        pacingMode = PACING_ON_DEMAND;
+    }
+    else
+    {
+        error("Unknown --pacing mode '%s' (unthrottled, fps, ondemand)", mode);
+    }
+
+    if (pacingMode == PACING_TARGET_FPS)
+    {
+        if (!targetFps)
+            targetFps = kDefaultTargetFps;
+        framePeriodNs = 1000000000ull / targetFps;
+        log("Frame pacing: %u fps", targetFps);
+    }
+    else if (pacingMode == PACING_ON_DEMAND)
+    {
+        log("Frame pacing: on demand");
+        if (IsBenchmarkMode())
+        {
+            warn("--frames with on-demand pacing only counts frames that were asked for; static scenes wait for events.");
+        }
+    }
+}
+
+PacingMode GetPacingMode()
+{
+    return pacingMode;
+}
+
+void FramePacerReset()
+{
+    nextFrameNs = 0;
+    redrawRequested = true;
+}
+
+void FramePacerWait()
+{
+    if (pacingMode != PACING_TARGET_FPS)
+        return;
+
+    uint64 now = GetTimeNs();
+
+    if (nextFrameNs == 0)
+    {
+        nextFrameNs = now + framePeriodNs;
+    }
+    else if (now > nextFrameNs + framePeriodNs)
+    {
+        // More than a frame behind: re-anchor instead of rendering a burst to catch up.
+        nextFrameNs = now + framePeriodNs;
+        return;
+    }
+
+    PROFILE_SCOPE("FramePacerWait");
+    if (nextFrameNs > now + kPacingSpinNs)
+    {
+        SleepNs(nextFrameNs - now - kPacingSpinNs);
+    }
+    while (GetTimeNs() < nextFrameNs)
+    {
+    }
+    nextFrameNs += framePeriodNs;
+}
+
+void RequestRedraw()
+{
+    redrawRequested = true;
+}
+
+bool ConsumeRedraw()
+{
+    bool requested = redrawRequested;
+    redrawRequested = false;
+    return requested;
+}
@@ -0,0 +1,37 @@
+#ifndef _PACING_H_
+#define _PACING_H_
+
+#include "main.h"
+
+// Frame pacing policies of the window-system loops, selected with --pacing:
+//   unthrottled : render back to back (default; vsync still applies unless --no-vsync)
+//   fps         : hold --target-fps by sleeping for the bulk of the frame and spinning
+//                 the last stretch, which keeps the frame-to-frame variance low
+//   ondemand    : block in the event loop; only Expose/resize/input or a scene calling
+//                 RequestRedraw() produces a frame
+
+enum PacingMode
+{
+    PACING_UNTHROTTLED,
+    PACING_TARGET_FPS,
+    PACING_ON_DEMAND,
+};
+
+/// Resolve --pacing/--target-fps. Called once by the harness before the first scene.
+void FramePacerInit();
+
+PacingMode GetPacingMode();
+
+/// Start a new scene: restart the frame clock and request its first frame.
+void FramePacerReset();
+
+/// Call after every presented frame; in fps mode blocks until the next frame is due.
+void FramePacerWait();
+
+/// Ask for another frame in on-demand mode. Animated scenes call this from DrawGLScene().
+void RequestRedraw();
+
+/// true (once) if a redraw was requested since the last call.
+bool ConsumeRedraw();
+
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <unordered_map>
+
+#include "pipeline_cache.h"
+#include "profiler.h"
+
+struct PipelineKey
+{
+    GLuint  stages[MAX];
+
+    bool operator==(const PipelineKey& _other) const
+    {
+        return memcmp(stages, _other.stages, sizeof(stages)) == 0;
+    }
+};
+
+struct PipelineKeyHash
+{
+    size_t operator()(const PipelineKey& _key) const
+    {
+        size_t hash = 0;
+        for (int i = 0; i < MAX; i++)
+        {
+            hash = hash * 31 + _key.stages[i];
+        }
+        return hash;
+    }
+};
+
+struct PipelineCacheStats
+{
+    uint32  stagesCreated;
+    uint32  stagesReused;
+    uint32  pipelinesCreated;
+    uint32  pipelinesReused;
+};
+
+static const GLenum stageTypes[MAX] =
+{
+    GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER
+};
+static const GLbitfield stageBits[MAX] =
+{
+    GL_VERTEX_SHADER_BIT, GL_TESS_CONTROL_SHADER_BIT, GL_TESS_EVALUATION_SHADER_BIT, GL_GEOMETRY_SHADER_BIT,
+    GL_FRAGMENT_SHADER_BIT
+};
+
+// Stage programs that failed are kept as 0, so switching back to them does not recompile.
+static std::unordered_map<uint64, GLuint> stagePrograms;
+static std::unordered_map<PipelineKey, GLuint, PipelineKeyHash> pipelines;
+static PipelineCacheStats stats;
+
+// ----------------------------------------------------------------------------------------------------------------
+GLuint GetSeparableStage(GLenum _type, const std::string& _filename, const std::string& _shaderPrefix)
+{
+    uint64 key = ShaderStageKey(_type, _filename, _shaderPrefix);
+    std::unordered_map<uint64, GLuint>::const_iterator it = stagePrograms.find(key);
+    if (it != stagePrograms.end())
+    {
+        stats.stagesReused++;
+        return it->second;
+    }
+
+    PROFILE_SCOPE("CreateSeparableStage");
+    std::string source = ShaderVariantSource(_filename, _shaderPrefix);
+    const char* sourcePointer = source.c_str();
+    GLuint program = glCreateShaderProgramv(_type, 1, &sourcePointer);
+    if (!CheckProgram(program))
+    {
+        warn("Separable stage '%s' failed to build", _filename.c_str());
+        glDeleteProgram(program);
+        program = 0;
+    }
+
+    stagePrograms[key] = program;
+    stats.stagesCreated++;
+    return program;
+}
+
+GLuint GetProgramPipeline(const GLuint (&_stages)[MAX])
+{
+    PipelineKey key;
+    memcpy(key.stages, _stages, sizeof(key.stages));
+    GLuint& pipeline = pipelines[key];
+    if (pipeline)
+    {
+        stats.pipelinesReused++;
+        return pipeline;
+    }
+
+    PROFILE_SCOPE("CreateProgramPipeline");
+    glGenProgramPipelines(1, &pipeline);
+    for (int i = 0; i < MAX; i++)
+    {
+        if (_stages[i])
+        {
+            glUseProgramStages(pipeline, stageBits[i], _stages[i]);
+        }
+    }
+    ValidateProgramPipeline(pipeline);
+    stats.pipelinesCreated++;
+    return pipeline;
+}
+
+GLuint CreateSeparablePipeline(const std::string (&_filenames)[MAX], GLuint (&_stages)[MAX],
+                               const std::string& _shaderPrefix)
+{
+    bool built = true;
+    for (int i = 0; i < MAX; i++)
+    {
+        _stages[i] = 0;
+        if (!_filenames[i].empty())
+        {
+            _stages[i] = GetSeparableStage(stageTypes[i], _filenames[i], _shaderPrefix);
+            built = built && _stages[i] != 0;
+        }
+    }
+    return built ? GetProgramPipeline(_stages) : 0;
+}
+
+void PipelineCacheEndScene()
+{
+    if (stagePrograms.empty() && pipelines.empty())
+        return;
+
+    log("Pipeline cache: %u stage programs (%u reused), %u pipelines (%u reused)",
+        stats.stagesCreated, stats.stagesReused, stats.pipelinesCreated, stats.pipelinesReused);
+
+    for (std::unordered_map<PipelineKey, GLuint, PipelineKeyHash>::iterator it = pipelines.begin(); it != pipelines.end(); ++it)
+    {
+        glDeleteProgramPipelines(1, &it->second);
+    }
+    for (std::unordered_map<uint64, GLuint>::iterator it = stagePrograms.begin(); it != stagePrograms.end(); ++it)
+    {
+        if (it->second)
+        {
+            glDeleteProgram(it->second);
+        }
+    }
+    pipelines.clear();
+    stagePrograms.clear();
+    stats = PipelineCacheStats();
+}
@@ -0,0 +1,33 @@
+#ifndef _PIPELINE_CACHE_H_
+#define _PIPELINE_CACHE_H_
+
+#include <string>
+#include <GL/glew.h>
+
+#include "main.h"
+#include "shader.hpp"
+
+// Separable programs and program pipelines of the current scene. A stage program
+// (glCreateShaderProgramv) is created once per stage type, file contents and the defines it
+// uses (ShaderStageKey), so an edited file simply misses; a pipeline is created once per
+// tuple of stage programs. Once a scene has built the combinations it switches between,
+// switching is only a glBindProgramPipeline. The harness deletes everything when the scene
+// ends (PipelineCacheEndScene), so scenes must not delete what they got from here.
+
+/// The separable program of _filename as the _type stage, with the defines of _shaderPrefix
+/// it uses (see CreateProgram); 0 if it fails to compile or link.
+GLuint GetSeparableStage(GLenum _type, const std::string& _filename, const std::string& _shaderPrefix = std::string());
+
+/// The pipeline using _stages, indexed VERTEX..FRAGMENT (0 = stage unused). It is validated
+/// once, when it is created.
+GLuint GetProgramPipeline(const GLuint (&_stages)[MAX]);
+
+/// GetSeparableStage() for every stage with a file name ("" = stage unused), stored in
+/// _stages, and their GetProgramPipeline(). 0 if a stage failed to build.
+GLuint CreateSeparablePipeline(const std::string (&_filenames)[MAX], GLuint (&_stages)[MAX],
+                               const std::string& _shaderPrefix = std::string());
+
+/// Delete the scene's stage programs and pipelines.
+void PipelineCacheEndScene();
+
+#endif
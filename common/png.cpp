@@ -0,0 +1,556 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "png.h"
+
+// ----------------------------------------------------------------------------------------------------------------
+// Inflate (RFC 1951). Canonical Huffman codes are decoded one bit at a time from the
+// per-length counts; references are decoded once per run, so simplicity wins over speed.
+
+static const uint32 kMaxCodeBits = 15;
+static const uint32 kMaxLitLenCodes = 288;
+static const uint32 kMaxDistCodes = 30;
+
+struct BitReader
+{
+    const uint8*    data;
+    size_t          size;
+    size_t          pos;
+    uint32          bitBuffer;
+    uint32          bitCount;
+    bool            overrun;
+};
+
+struct Huffman
+{
+    uint16  count[kMaxCodeBits + 1];    ///< number of codes of each length
+    uint16  symbol[kMaxLitLenCodes];    ///< symbols ordered by code
+};
+
+static uint32 GetBits(BitReader& br, uint32 n)
+{
+    while (br.bitCount < n)
+    {
+        if (br.pos >= br.size)
+        {
+            br.overrun = true;
+            return 0;
+        }
+        br.bitBuffer |= uint32(br.data[br.pos++]) << br.bitCount;
+        br.bitCount += 8;
+    }
+    uint32 value = br.bitBuffer & ((1u << n) - 1);
+    br.bitBuffer >>= n;
+    br.bitCount -= n;
+    return value;
+}
+
+// Returns false for an over-subscribed code; incomplete codes are allowed (single
+// distance code blocks use them).
+static bool BuildHuffman(Huffman& h, const uint8* lengths, uint32 n)
+{
+    memset(h.count, 0, sizeof(h.count));
+    for (uint32 i = 0; i < n; i++)
+    {
+        h.count[lengths[i]]++;
+    }
+    h.count[0] = 0;
+
+    int left = 1;
+    for (uint32 len = 1; len <= kMaxCodeBits; len++)
+    {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0)
+            return false;
+    }
+
+    uint16 offsets[kMaxCodeBits + 1];
+    offsets[1] = 0;
+    for (uint32 len = 1; len < kMaxCodeBits; len++)
+    {
+        offsets[len + 1] = offsets[len] + h.count[len];
+    }
+    for (uint32 i = 0; i < n; i++)
+    {
+        if (lengths[i])
+            h.symbol[offsets[lengths[i]]++] = uint16(i);
+    }
+    return true;
+}
+
+static int DecodeSymbol(BitReader& br, const Huffman& h)
+{
+    int code = 0, first = 0, index = 0;
+    for (uint32 len = 1; len <= kMaxCodeBits; len++)
+    {
+        code |= int(GetBits(br, 1));
+        int count = h.count[len];
+        if (code - first < count)
+            return h.symbol[index + code - first];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static const uint16 lengthBase[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8 lengthExtra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16 distBase[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8 distExtra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static bool InflateCodes(BitReader& br, const Huffman& litLen, const Huffman& dist, std::vector<uint8>& out)
+{
+    while (1)
+    {
+        int symbol = DecodeSymbol(br, litLen);
+        if (symbol < 0 || br.overrun)
+            return false;
+
+        if (symbol < 256)
+        {
+            out.push_back(uint8(symbol));
+        }
+        else if (symbol == 256)
+        {
+            return true;
+        }
+        else
+        {
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            uint32 length = lengthBase[symbol] + GetBits(br, lengthExtra[symbol]);
+
+            int distSymbol = DecodeSymbol(br, dist);
+            if (distSymbol < 0 || distSymbol >= 30)
+                return false;
+            size_t distance = distBase[distSymbol] + GetBits(br, distExtra[distSymbol]);
+            if (br.overrun || distance > out.size())
+                return false;
+
+            // Byte by byte: the source may overlap the bytes being written.
+            size_t from = out.size() - distance;
+            for (uint32 i = 0; i < length; i++)
+            {
+                out.push_back(out[from + i]);
+            }
+        }
+    }
+}
+
+static bool InflateStored(BitReader& br, std::vector<uint8>& out)
+{
+    // Stored blocks start on a byte boundary.
+    br.bitBuffer = 0;
+    br.bitCount = 0;
+    if (br.pos + 4 > br.size)
+        return false;
+
+    uint32 len = br.data[br.pos] | (br.data[br.pos + 1] << 8);
+    uint32 nlen = br.data[br.pos + 2] | (br.data[br.pos + 3] << 8);
+    br.pos += 4;
+    if (len != (~nlen & 0xffff) || br.pos + len > br.size)
+        return false;
+
+    out.insert(out.end(), br.data + br.pos, br.data + br.pos + len);
+    br.pos += len;
+    return true;
+}
+
+static bool InflateFixed(BitReader& br, std::vector<uint8>& out)
+{
+    static Huffman litLen, dist;
+    static bool built = false;
+    if (!built)
+    {
+        uint8 lengths[kMaxLitLenCodes];
+        uint32 i = 0;
+        for (; i < 144; i++) lengths[i] = 8;
+        for (; i < 256; i++) lengths[i] = 9;
+        for (; i < 280; i++) lengths[i] = 7;
+        for (; i < 288; i++) lengths[i] = 8;
+        BuildHuffman(litLen, lengths, kMaxLitLenCodes);
+        for (i = 0; i < kMaxDistCodes; i++) lengths[i] = 5;
+        BuildHuffman(dist, lengths, kMaxDistCodes);
+        built = true;
+    }
+    return InflateCodes(br, litLen, dist, out);
+}
+
+static bool InflateDynamic(BitReader& br, std::vector<uint8>& out)
+{
+    static const uint8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    uint32 nlen = GetBits(br, 5) + 257;
+    uint32 ndist = GetBits(br, 5) + 1;
+    uint32 ncode = GetBits(br, 4) + 4;
+    if (nlen > 286 || ndist > kMaxDistCodes)
+        return false;
+
+    uint8 lengths[kMaxLitLenCodes + kMaxDistCodes];
+    memset(lengths, 0, sizeof(lengths));
+    for (uint32 i = 0; i < ncode; i++)
+    {
+        lengths[order[i]] = uint8(GetBits(br, 3));
+    }
+
+    Huffman codeLen;
+    if (!BuildHuffman(codeLen, lengths, 19))
+        return false;
+
+    uint32 index = 0;
+    while (index < nlen + ndist)
+    {
+        int symbol = DecodeSymbol(br, codeLen);
+        if (symbol < 0 || br.overrun)
+            return false;
+
+        if (symbol < 16)
+        {
+            lengths[index++] = uint8(symbol);
+            continue;
+        }
+
+        uint8 repeatLength = 0;
+        uint32 repeat = 0;
+        if (symbol == 16)
+        {
+            if (index == 0)
+                return false;
+            repeatLength = lengths[index - 1];
+            repeat = 3 + GetBits(br, 2);
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + GetBits(br, 3);
+        }
+        else
+        {
+            repeat = 11 + GetBits(br, 7);
+        }
+        if (index + repeat > nlen + ndist)
+            return false;
+        while (repeat--)
+        {
+            lengths[index++] = repeatLength;
+        }
+    }
+
+    if (lengths[256] == 0)
+        return false;   // no end-of-block code
+
+    Huffman litLen, dist;
+    if (!BuildHuffman(litLen, lengths, nlen) || !BuildHuffman(dist, lengths + nlen, ndist))
+        return false;
+    return InflateCodes(br, litLen, dist, out);
+}
+
+static uint32 Adler32(const uint8* data, size_t size)
+{
+    uint32 a = 1, b = 0;
+    while (size > 0)
+    {
+        // 5552 bytes is the most that can be summed before b overflows.
+        size_t chunk = size < 5552 ? size : 5552;
+        size -= chunk;
+        while (chunk--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+bool InflateZlib(const uint8* _data, size_t _size, std::vector<uint8>& _out)
+{
+    if (_size < 6)
+        return false;
+
+    uint32 cmf = _data[0], flg = _data[1];
+    if ((cmf & 0x0f) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20))
+        return false;   // not deflate, bad header check, or preset dictionary
+
+    BitReader br = { _data, _size - 4, 2, 0, 0, false };
+    size_t start = _out.size();
+
+    uint32 last = 0;
+    while (!last)
+    {
+        last = GetBits(br, 1);
+        uint32 type = GetBits(br, 2);
+        bool ok = false;
+        switch (type)
+        {
+        case 0: ok = InflateStored(br, _out); break;
+        case 1: ok = InflateFixed(br, _out); break;
+        case 2: ok = InflateDynamic(br, _out); break;
+        }
+        if (!ok || br.overrun)
+            return false;
+    }
+
+    const uint8* trailer = _data + _size - 4;
+    uint32 adler = (uint32(trailer[0]) << 24) | (trailer[1] << 16) | (trailer[2] << 8) | trailer[3];
+    return Adler32(_out.data() + start, _out.size() - start) == adler;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+// PNG
+
+static uint32 ReadBE32(const uint8* p)
+{
+    return (uint32(p[0]) << 24) | (uint32(p[1]) << 16) | (uint32(p[2]) << 8) | uint32(p[3]);
+}
+
+static uint32 Crc32(const uint8* data, size_t size)
+{
+    static uint32 table[256];
+    static bool built = false;
+    if (!built)
+    {
+        for (uint32 n = 0; n < 256; n++)
+        {
+            uint32 c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        built = true;
+    }
+
+    uint32 crc = 0xffffffffu;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+static uint8 Paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc)
+        return uint8(a);
+    return uint8(pb <= pc ? b : c);
+}
+
+// Undo the row filters in place; _raw holds (1 filter byte + stride) per row.
+static bool Unfilter(uint8* raw, uint32 height, size_t stride, uint32 bpp)
+{
+    const uint8* prev = NULL;
+    for (uint32 y = 0; y < height; y++)
+    {
+        uint8 filter = raw[y * (stride + 1)];
+        uint8* row = raw + y * (stride + 1) + 1;
+        for (size_t x = 0; x < stride; x++)
+        {
+            int a = x >= bpp ? row[x - bpp] : 0;
+            int b = prev ? prev[x] : 0;
+            int c = (prev && x >= bpp) ? prev[x - bpp] : 0;
+            switch (filter)
+            {
+            case 0: break;
+            case 1: row[x] = uint8(row[x] + a); break;
+            case 2: row[x] = uint8(row[x] + b); break;
+            case 3: row[x] = uint8(row[x] + ((a + b) >> 1)); break;
+            case 4: row[x] = uint8(row[x] + Paeth(a, b, c)); break;
+            default: return false;
+            }
+        }
+        prev = row;
+    }
+    return true;
+}
+
+bool LoadPNG(const char* _path, PngImage& _image)
+{
+    static const uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    FILE* file = 0;
+    fopen_s(&file, _path, "rb");
+    if (!file)
+    {
+        warn("Unable to open PNG '%s'", _path);
+        return false;
+    }
+    std::vector<uint8> data;
+    uint8 buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    fclose(file);
+
+    if (data.size() < 8 || memcmp(data.data(), signature, 8) != 0)
+    {
+        warn("'%s' is not a PNG file", _path);
+        return false;
+    }
+
+    uint32 width = 0, height = 0, depth = 0, colorType = 0, interlace = 0;
+    uint8 palette[256][4];
+    uint32 paletteSize = 0;
+    std::vector<uint8> idat;
+
+    size_t pos = 8;
+    bool ended = false;
+    while (!ended && pos + 12 <= data.size())
+    {
+        uint32 length = ReadBE32(&data[pos]);
+        const uint8* type = &data[pos + 4];
+        const uint8* chunk = &data[pos + 8];
+        if (length > data.size() - pos - 12)
+        {
+            warn("PNG '%s' is truncated", _path);
+            return false;
+        }
+        if (Crc32(type, length + 4) != ReadBE32(chunk + length))
+        {
+            warn("PNG '%s' has a corrupt %.4s chunk", _path, (const char*)type);
+            return false;
+        }
+
+        if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+        {
+            width = ReadBE32(chunk);
+            height = ReadBE32(chunk + 4);
+            depth = chunk[8];
+            colorType = chunk[9];
+            interlace = chunk[12];
+        }
+        else if (memcmp(type, "PLTE", 4) == 0)
+        {
+            paletteSize = length / 3 > 256 ? 256 : length / 3;
+            for (uint32 i = 0; i < paletteSize; i++)
+            {
+                palette[i][0] = chunk[i * 3 + 0];
+                palette[i][1] = chunk[i * 3 + 1];
+                palette[i][2] = chunk[i * 3 + 2];
+                palette[i][3] = 255;
+            }
+        }
+        else if (memcmp(type, "tRNS", 4) == 0 && colorType == 3)
+        {
+            for (uint32 i = 0; i < length && i < paletteSize; i++)
+            {
+                palette[i][3] = chunk[i];
+            }
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            idat.insert(idat.end(), chunk, chunk + length);
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            ended = true;
+        }
+        pos += 12 + length;
+    }
+
+    uint32 channels = 0;
+    switch (colorType)
+    {
+    case 0: channels = 1; break;    // gray
+    case 2: channels = 3; break;    // RGB
+    case 3: channels = 1; break;    // palette
+    case 4: channels = 2; break;    // gray + alpha
+    case 6: channels = 4; break;    // RGBA
+    }
+    bool depthOk = depth == 8 || (depth == 16 && colorType != 3) ||
+                   ((depth == 1 || depth == 2 || depth == 4) && (colorType == 0 || colorType == 3));
+    if (!width || !height || !channels || !depthOk || (colorType == 3 && !paletteSize))
+    {
+        warn("PNG '%s': unsupported format (color type %u, %u bits)", _path, colorType, depth);
+        return false;
+    }
+    if (interlace)
+    {
+        warn("PNG '%s': interlaced images are not supported", _path);
+        return false;
+    }
+
+    size_t stride = (size_t(width) * channels * depth + 7) / 8;
+    uint32 bpp = (channels * depth + 7) / 8;
+    std::vector<uint8> raw;
+    raw.reserve((stride + 1) * height);
+    if (!InflateZlib(idat.data(), idat.size(), raw) || raw.size() < (stride + 1) * height)
+    {
+        warn("PNG '%s': corrupt image data", _path);
+        return false;
+    }
+    if (!Unfilter(raw.data(), height, stride, bpp))
+    {
+        warn("PNG '%s': unknown row filter", _path);
+        return false;
+    }
+
+    _image.width = width;
+    _image.height = height;
+    _image.pixels.resize(size_t(width) * height * 4);
+    for (uint32 y = 0; y < height; y++)
+    {
+        const uint8* row = &raw[y * (stride + 1) + 1];
+        uint8* dst = &_image.pixels[size_t(y) * width * 4];
+        for (uint32 x = 0; x < width; x++, dst += 4)
+        {
+            // Sample c of pixel x, reduced to 8 bits.
+            uint32 s[4] = { 0, 0, 0, 255 };
+            for (uint32 c = 0; c < channels; c++)
+            {
+                if (depth == 8)
+                {
+                    s[c] = row[x * channels + c];
+                }
+                else if (depth == 16)
+                {
+                    s[c] = row[(x * channels + c) * 2];
+                }
+                else
+                {
+                    uint32 bit = x * depth;
+                    uint32 value = (row[bit / 8] >> (8 - depth - bit % 8)) & ((1u << depth) - 1);
+                    s[c] = colorType == 3 ? value : value * 255 / ((1u << depth) - 1);
+                }
+            }
+
+            switch (colorType)
+            {
+            case 0: dst[0] = dst[1] = dst[2] = uint8(s[0]); dst[3] = 255; break;
+            case 2: dst[0] = uint8(s[0]); dst[1] = uint8(s[1]); dst[2] = uint8(s[2]); dst[3] = 255; break;
+            case 3:
+            {
+                uint32 index = s[0] < paletteSize ? s[0] : 0;
+                memcpy(dst, palette[index], 4);
+                break;
+            }
+            case 4: dst[0] = dst[1] = dst[2] = uint8(s[0]); dst[3] = uint8(s[1]); break;
+            case 6: dst[0] = uint8(s[0]); dst[1] = uint8(s[1]); dst[2] = uint8(s[2]); dst[3] = uint8(s[3]); break;
+            }
+        }
+    }
+    return true;
+}
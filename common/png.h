@@ -0,0 +1,26 @@
+#ifndef _PNG_H_
+#define _PNG_H_
+
+#include <vector>
+
+#include "main.h"
+
+// Self-contained PNG reader for reference images: zlib/deflate inflater, all five row
+// filters, grayscale/RGB/palette/alpha at 1-16 bits per channel. Interlaced files
+// are rejected.
+
+/// Decoded image: RGBA8, rows top-down, tightly packed.
+struct PngImage
+{
+    uint32              width;
+    uint32              height;
+    std::vector<uint8>  pixels;
+};
+
+/// Load _path into _image; warns and returns false on a missing or malformed file.
+bool LoadPNG(const char* _path, PngImage& _image);
+
+/// Inflate a zlib stream (RFC 1950/1951), appending to _out; checks the Adler-32.
+bool InflateZlib(const uint8* _data, size_t _size, std::vector<uint8>& _out);
+
+#endif
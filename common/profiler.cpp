@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "profiler.h"
+#include "harness.h"
+#include "benchmark.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_HAS_TSC 1
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILER_HAS_TSC 1
+#else
+#define PROFILER_HAS_TSC 0
+#endif
+
+static const size_t kProfilerEventReserve = 64 * 1024;
+static const uint32 kProfilerMaxDepth = 64;
+
+struct ProfileEvent
+{
+    const char* name;
+    uint64      begin;
+    uint64      end;
+};
+
+struct ProfilerThreadBuffer
+{
+    uint32                      tid;
+    const char*                 threadName;
+    std::vector<ProfileEvent>   events;
+    const char*                 openName[kProfilerMaxDepth];
+    uint64                      openBegin[kProfilerMaxDepth];
+    uint32                      openDepth;
+    std::atomic<bool>           writing;        ///< set while the owner appends
+};
+
+std::atomic<bool> g_profilerEnabled(false);
+
+// Buffers are owned by the registry and deliberately never freed: they have to
+// survive until the atexit handler, after thread_local objects are gone.
+static std::mutex registryMutex;
+static std::vector<ProfilerThreadBuffer*> registry;
+static thread_local ProfilerThreadBuffer* pThreadBuffer = NULL;
+
+// Tick/ns anchors: one taken at init, one at dump time, to scale TSC ticks.
+static uint64 anchorTicks = 0;
+static uint64 anchorNs = 0;
+
+// ----------------------------------------------------------------------------------------------------------------
+uint64 ProfilerTicks()
+{
+#if PROFILER_HAS_TSC
+    return __rdtsc();
+#else
+    return GetTimeNs();
+#endif
+}
+
+static ProfilerThreadBuffer* GetThreadBuffer()
+{
+    if (!pThreadBuffer)
+    {
+        ProfilerThreadBuffer* pBuffer = new ProfilerThreadBuffer();
+        pBuffer->threadName = NULL;
+        pBuffer->openDepth = 0;
+        pBuffer->writing = false;
+        pBuffer->events.reserve(kProfilerEventReserve);
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        pBuffer->tid = uint32(registry.size()) + 1;
+        registry.push_back(pBuffer);
+        pThreadBuffer = pBuffer;
+    }
+    return pThreadBuffer;
+}
+
+// Other threads (readback, hot reload, logger) may still record while the atexit handler
+// dumps. The owner flags its buffer before it checks g_profilerEnabled again; the dump
+// clears g_profilerEnabled and then waits for the flags, so one of the two sees the other.
+static ProfilerThreadBuffer* BeginWrite()
+{
+    ProfilerThreadBuffer* pBuffer = GetThreadBuffer();
+    pBuffer->writing.store(true);
+    if (!g_profilerEnabled.load())
+    {
+        pBuffer->writing.store(false, std::memory_order_release);
+        return NULL;
+    }
+    return pBuffer;
+}
+
+static void EndWrite(ProfilerThreadBuffer* _pBuffer)
+{
+    _pBuffer->writing.store(false, std::memory_order_release);
+}
+
+void ProfilerRecord(const char* _name, uint64 _beginTicks, uint64 _endTicks)
+{
+    if (!g_profilerEnabled.load(std::memory_order_relaxed))
+        return;
+
+    ProfilerThreadBuffer* pBuffer = BeginWrite();
+    if (!pBuffer)
+        return;
+    ProfileEvent event = { _name, _beginTicks, _endTicks };
+    pBuffer->events.push_back(event);
+    EndWrite(pBuffer);
+}
+
+void ProfilerBeginEvent(const char* _name)
+{
+    if (!g_profilerEnabled.load(std::memory_order_relaxed))
+        return;
+
+    ProfilerThreadBuffer* pBuffer = GetThreadBuffer();
+    if (pBuffer->openDepth < kProfilerMaxDepth)
+    {
+        pBuffer->openName[pBuffer->openDepth] = _name;
+        pBuffer->openBegin[pBuffer->openDepth] = ProfilerTicks();
+    }
+    pBuffer->openDepth++;
+}
+
+void ProfilerEndEvent()
+{
+    if (!g_profilerEnabled.load(std::memory_order_relaxed))
+        return;
+
+    uint64 end = ProfilerTicks();
+    ProfilerThreadBuffer* pBuffer = GetThreadBuffer();
+    if (pBuffer->openDepth == 0)
+        return;
+
+    pBuffer->openDepth--;
+    if (pBuffer->openDepth < kProfilerMaxDepth)
+    {
+        ProfilerRecord(pBuffer->openName[pBuffer->openDepth], pBuffer->openBegin[pBuffer->openDepth], end);
+    }
+}
+
+void ProfilerSetThreadName(const char* _name)
+{
+    if (!g_profilerEnabled.load(std::memory_order_relaxed))
+        return;
+
+    ProfilerThreadBuffer* pBuffer = BeginWrite();
+    if (!pBuffer)
+        return;
+    pBuffer->threadName = _name;
+    EndWrite(pBuffer);
+}
+
+static void ProfilerWriteTrace()
+{
+    if (!g_profilerEnabled.exchange(false))
+        return;
+
+    uint64 endTicks = ProfilerTicks();
+    uint64 endNs = GetTimeNs();
+    float64 nsPerTick = 1.0;
+    if (endTicks > anchorTicks && endNs > anchorNs)
+    {
+        nsPerTick = float64(endNs - anchorNs) / float64(endTicks - anchorTicks);
+    }
+
+    const char* path = g_harnessOptions.traceFile;
+    FILE* file = 0;
+    fopen_s(&file, path, "wb");
+    if (!file)
+    {
+        warn("Unable to write trace file '%s'", path);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (size_t t = 0; t < registry.size(); t++)
+    {
+        while (registry[t]->writing.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    size_t eventCount = 0;
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t t = 0; t < registry.size(); t++)
+    {
+        const ProfilerThreadBuffer* pBuffer = registry[t];
+
+        if (pBuffer->threadName)
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                    first ? "" : ",\n", pBuffer->tid);
+            WriteJsonString(file, pBuffer->threadName);
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        for (size_t i = 0; i < pBuffer->events.size(); i++)
+        {
+            const ProfileEvent& event = pBuffer->events[i];
+            float64 tsUs = float64(int64(event.begin - anchorTicks)) * nsPerTick * 1e-3;
+            float64 durUs = float64(event.end - event.begin) * nsPerTick * 1e-3;
+
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            WriteJsonString(file, event.name);
+            fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    tsUs, durUs, pBuffer->tid);
+            first = false;
+        }
+        eventCount += pBuffer->events.size();
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    log("Wrote %zu trace events from %zu threads to '%s'", eventCount, registry.size(), path);
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void ProfilerInit()
+{
+    if (!g_harnessOptions.traceFile || g_profilerEnabled.load())
+        return;
+
+    anchorNs = GetTimeNs();
+    anchorTicks = ProfilerTicks();
+    g_profilerEnabled.store(true);
+    ProfilerSetThreadName("main");
+
+    // atexit so that a trace is still written when error() exits the process.
+    atexit(ProfilerWriteTrace);
+}
@@ -0,0 +1,50 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <atomic>
+
+#include "main.h"
+
+// CPU scoped-timer profiler. Each thread appends complete events to its own buffer
+// (no locking on the hot path), time-stamped with the TSC where available. At exit
+// all buffers are written as a Chrome trace_event JSON file (chrome://tracing, Perfetto).
+// Everything is a no-op unless the harness was started with --trace FILE.
+
+/// Enable the profiler if --trace was given. Called by the harness right after
+/// the command line was parsed; the trace is written from an atexit handler.
+void ProfilerInit();
+
+extern std::atomic<bool> g_profilerEnabled;
+
+/// Raw timestamp in profiler ticks (TSC cycles, or ns where there is no TSC).
+uint64 ProfilerTicks();
+
+/// Record one complete event; _name must outlive the profiler (string literal).
+void ProfilerRecord(const char* _name, uint64 _beginTicks, uint64 _endTicks);
+
+/// Begin/end pairs for phases that do not map onto a C++ scope. They nest per thread.
+void ProfilerBeginEvent(const char* _name);
+void ProfilerEndEvent();
+
+/// Name shown for the calling thread in the trace viewer.
+void ProfilerSetThreadName(const char* _name);
+
+struct ProfileScope
+{
+    explicit ProfileScope(const char* _name)
+        : name(_name), begin(g_profilerEnabled.load(std::memory_order_relaxed) ? ProfilerTicks() : 0) {}
+    ~ProfileScope()
+    {
+        if (g_profilerEnabled.load(std::memory_order_relaxed))
+            ProfilerRecord(name, begin, ProfilerTicks());
+    }
+
+    const char* name;
+    uint64 begin;
+};
+
+#define PROFILE_SCOPE_CONCAT2(_a, _b) _a##_b
+#define PROFILE_SCOPE_CONCAT(_a, _b) PROFILE_SCOPE_CONCAT2(_a, _b)
+#define PROFILE_SCOPE(_name) ProfileScope PROFILE_SCOPE_CONCAT(profileScope_, __LINE__)(_name)
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#include <process.h>
+#define getcwd _getcwd
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "program_cache.h"
+#include "harness.h"
+#include "caps.h"
+#include "profiler.h"
+#include "hash.h"
+
+static const uint32 kProgramCacheMagic = 0x504c474f;   // "OGLP"
+static const uint32 kProgramCacheVersion = 1;
+
+struct ProgramCacheHeader
+{
+    uint32  magic;
+    uint32  version;
+    uint64  key;
+    uint32  binaryFormat;
+    uint32  binaryLength;
+    uint32  checksum;           ///< FNV-1a of the binary, catches truncated or foreign files
+    uint32  reserved;
+};
+
+struct ProgramCacheStats
+{
+    uint32  hits;
+    uint32  misses;
+    uint32  rejected;
+    uint32  stored;
+};
+
+static bool enabled = false;
+static std::string cacheDir;
+static ProgramCacheStats stats;
+
+// ----------------------------------------------------------------------------------------------------------------
+// Strings are hashed with their length so that ("ab", "c") and ("a", "bc") differ.
+static uint64 HashString(uint64 _hash, const char* _str)
+{
+    uint64 length = _str ? strlen(_str) : 0;
+    _hash = Fnv1a64(_hash, &length, sizeof(length));
+    return Fnv1a64(_hash, _str, size_t(length));
+}
+
+static std::string EntryPath(uint64 _key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.glprog", (unsigned long long)_key);
+    return cacheDir + "/" + name;
+}
+
+static bool ReadEntry(const std::string& _path, ProgramCacheHeader& _header, std::vector<uint8>& _binary)
+{
+    FILE* file = 0;
+    fopen_s(&file, _path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    bool ok = fread(&_header, sizeof(_header), 1, file) == 1
+           && _header.magic == kProgramCacheMagic
+           && _header.version == kProgramCacheVersion
+           && _header.binaryLength > 0;
+    if (ok)
+    {
+        _binary.resize(_header.binaryLength);
+        ok = fread(_binary.data(), 1, _binary.size(), file) == _binary.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void ProgramCacheInit()
+{
+    if (!g_harnessOptions.programCache)
+        return;
+
+    if (GetCaps().major * 10 + GetCaps().minor < 41 && !HasExtension("GL_ARB_get_program_binary"))
+    {
+        warn("--program-cache: program binaries are not supported by this context, cache disabled.");
+        return;
+    }
+    if (GetCapsLimit(GL_NUM_PROGRAM_BINARY_FORMATS) == 0)
+    {
+        warn("--program-cache: the driver exposes no program binary format, cache disabled.");
+        return;
+    }
+
+    // Scenes run from their own directories; pin a relative path to the start directory.
+    cacheDir = g_harnessOptions.programCache;
+    bool absolute = !cacheDir.empty() && (cacheDir[0] == '/' || cacheDir[0] == '\\'
+                                          || (cacheDir.size() > 1 && cacheDir[1] == ':'));
+    if (!absolute)
+    {
+        char cwd[4096] = "";
+        if (!getcwd(cwd, sizeof(cwd)))
+        {
+            error("Unable to query the working directory.");
+        }
+        cacheDir = std::string(cwd) + "/" + cacheDir;
+    }
+
+#ifdef _WIN32
+    _mkdir(cacheDir.c_str());
+#else
+    mkdir(cacheDir.c_str(), 0777);
+#endif
+
+    enabled = true;
+    log("Program cache: %s", cacheDir.c_str());
+}
+
+bool IsProgramCacheEnabled()
+{
+    return enabled;
+}
+
+uint64 ProgramCacheKey(const uint64* _stageKeys, size_t _count)
+{
+    const CapsInfo& caps = GetCaps();
+    uint64 hash = kFnv1a64Basis;
+    hash = Fnv1a64(hash, &kProgramCacheVersion, sizeof(kProgramCacheVersion));
+    hash = HashString(hash, caps.vendor);
+    hash = HashString(hash, caps.renderer);
+    hash = HashString(hash, caps.version);
+    return Fnv1a64(hash, _stageKeys, _count * sizeof(_stageKeys[0]));
+}
+
+GLuint LoadCachedProgram(uint64 _key)
+{
+    PROFILE_SCOPE("LoadCachedProgram");
+    ProgramCacheHeader header;
+    std::vector<uint8> binary;
+    std::string path = EntryPath(_key);
+    if (!ReadEntry(path, header, binary) || header.key != _key
+        || uint32(Fnv1a64(kFnv1a64Basis, binary.data(), binary.size())) != header.checksum)
+    {
+        stats.misses++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), GLsizei(binary.size()));
+
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE)
+    {
+        // Drivers may reject binaries of an older build even with matching version strings.
+        debug("Program cache: binary %016llx rejected by the driver, rebuilding", (unsigned long long)_key);
+        glDeleteProgram(program);
+        remove(path.c_str());
+        stats.rejected++;
+        stats.misses++;
+        return 0;
+    }
+
+    stats.hits++;
+    return program;
+}
+
+void StoreCachedProgram(uint64 _key, GLuint _program)
+{
+    PROFILE_SCOPE("StoreCachedProgram");
+    GLint length = 0;
+    glGetProgramiv(_program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<uint8> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(_program, length, &length, &format, binary.data());
+    if (length <= 0)
+        return;
+    binary.resize(length);
+
+    ProgramCacheHeader header = { kProgramCacheMagic, kProgramCacheVersion, _key, format, uint32(length),
+                                  uint32(Fnv1a64(kFnv1a64Basis, binary.data(), binary.size())), 0 };
+
+    std::string path = EntryPath(_key);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", int(getpid()));
+    std::string tempPath = path + suffix;
+
+    FILE* file = 0;
+    fopen_s(&file, tempPath.c_str(), "wb");
+    if (!file)
+    {
+        warn("Unable to write program cache entry '%s'", tempPath.c_str());
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+    ok = (fclose(file) == 0) && ok;
+
+    // Another process may be storing the same key; either complete file wins.
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok)
+    {
+        warn("Unable to store program cache entry '%s'", path.c_str());
+        remove(tempPath.c_str());
+        return;
+    }
+    stats.stored++;
+}
+
+void ProgramCacheReport()
+{
+    if (!enabled)
+        return;
+
+    log("Program cache: %u hits, %u misses (%u rejected), %u stored",
+        stats.hits, stats.misses, stats.rejected, stats.stored);
+}
@@ -0,0 +1,36 @@
+#ifndef _PROGRAM_CACHE_H_
+#define _PROGRAM_CACHE_H_
+
+#include <GL/glew.h>
+
+#include "main.h"
+
+// On-disk cache of linked program binaries (--program-cache DIR). Programs built by the
+// CreateProgram family are stored with glGetProgramBinary, one file per program:
+//   <dir>/<key>.glprog
+// The key hashes every stage type, source and defines and the GL vendor, renderer and
+// version strings, so a driver update or an edited shader simply misses. A binary the
+// driver rejects is deleted and the program is rebuilt from source.
+// Files are written to a per-process temporary and renamed into place, so concurrent
+// runs sharing a directory only ever see complete entries.
+
+/// Resolve the cache directory and check driver support. Call after CapsInit(), before
+/// the first scene changes the working directory.
+void ProgramCacheInit();
+
+bool IsProgramCacheEnabled();
+
+/// Key of a program made of _count stages, given a key per stage that covers its type,
+/// source and defines.
+uint64 ProgramCacheKey(const uint64* _stageKeys, size_t _count);
+
+/// A linked program created from the cached binary, or 0 on a miss or rejection.
+GLuint LoadCachedProgram(uint64 _key);
+
+/// Store a linked program. It must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+void StoreCachedProgram(uint64 _key, GLuint _program);
+
+/// Print hits, misses and rejections of the run.
+void ProgramCacheReport();
+
+#endif
@@ -0,0 +1,285 @@
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "program_reflection.h"
+#include "caps.h"
+#include "profiler.h"
+
+static std::unordered_map<GLuint, ProgramReflection*> programTables;
+static std::unordered_map<GLuint, ProgramReflection*> pipelineTables;
+
+// ----------------------------------------------------------------------------------------------------------------
+static bool UseInterfaceQuery()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        supported = (GetCaps().major * 10 + GetCaps().minor >= 43 || HasExtension("GL_ARB_program_interface_query")) ? 1 : 0;
+    }
+    return supported != 0;
+}
+
+// "lights[0]" is listed as "lights", like the driver accepts it.
+static std::string ResourceName(const char* _name)
+{
+    size_t length = strlen(_name);
+    if (length > 3 && strcmp(_name + length - 3, "[0]") == 0)
+    {
+        length -= 3;
+    }
+    return std::string(_name, length);
+}
+
+static void ReadUniforms(GLuint _program, std::vector<ReflectedUniform>& _uniforms)
+{
+    std::vector<char> name;
+    if (UseInterfaceQuery())
+    {
+        GLint count = 0, maxNameLength = 0;
+        glGetProgramInterfaceiv(_program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+        glGetProgramInterfaceiv(_program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+        name.resize(size_t(std::max(maxNameLength, 1)));
+
+        static const GLenum props[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint values[3] = { -1, 0, 0 };
+            glGetProgramResourceiv(_program, GL_UNIFORM, GLuint(i), 3, props, 3, NULL, values);
+            if (values[0] < 0)
+                continue;   // block member
+
+            glGetProgramResourceName(_program, GL_UNIFORM, GLuint(i), GLsizei(name.size()), NULL, name.data());
+            ReflectedUniform uniform = { 0, _program, values[0], GLenum(values[1]), values[2], ResourceName(name.data()) };
+            _uniforms.push_back(uniform);
+        }
+    }
+    else
+    {
+        GLint count = 0, maxNameLength = 0;
+        glGetProgramiv(_program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+        name.resize(size_t(std::max(maxNameLength, 1)));
+
+        for (GLint i = 0; i < count; i++)
+        {
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(_program, GLuint(i), GLsizei(name.size()), NULL, &size, &type, name.data());
+            GLint location = glGetUniformLocation(_program, name.data());
+            if (location < 0)
+                continue;
+
+            ReflectedUniform uniform = { 0, _program, location, type, size, ResourceName(name.data()) };
+            _uniforms.push_back(uniform);
+        }
+    }
+}
+
+static void ReadBlocks(GLuint _program, std::vector<ReflectedBlock>& _blocks)
+{
+    std::vector<char> name;
+    GLint count = 0, maxNameLength = 0;
+    if (UseInterfaceQuery())
+    {
+        glGetProgramInterfaceiv(_program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+        glGetProgramInterfaceiv(_program, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &maxNameLength);
+    }
+    else
+    {
+        glGetProgramiv(_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+    }
+    name.resize(size_t(std::max(maxNameLength, 1)));
+
+    for (GLint i = 0; i < count; i++)
+    {
+        GLint dataSize = 0;
+        if (UseInterfaceQuery())
+        {
+            static const GLenum prop = GL_BUFFER_DATA_SIZE;
+            glGetProgramResourceiv(_program, GL_UNIFORM_BLOCK, GLuint(i), 1, &prop, 1, NULL, &dataSize);
+            glGetProgramResourceName(_program, GL_UNIFORM_BLOCK, GLuint(i), GLsizei(name.size()), NULL, name.data());
+        }
+        else
+        {
+            glGetActiveUniformBlockiv(_program, GLuint(i), GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+            glGetActiveUniformBlockName(_program, GLuint(i), GLsizei(name.size()), NULL, name.data());
+        }
+        ReflectedBlock block = { 0, _program, GLuint(i), dataSize, ResourceName(name.data()) };
+        _blocks.push_back(block);
+    }
+}
+
+template <typename T>
+static bool HashLess(const T& _a, const T& _b)
+{
+    return (_a.hash) < (_b.hash);
+}
+
+// Hash the names and sort; stable, so entries of the same name stay in stage order.
+template <typename T>
+static void SortByHash(std::vector<T>& _entries, GLuint _object)
+{
+    for (size_t i = 0; i < _entries.size(); i++)
+    {
+        _entries[i].hash = ReflectionHash(_entries[i].name.c_str());
+    }
+    std::stable_sort(_entries.begin(), _entries.end(), HashLess<T>);
+    for (size_t i = 1; i < _entries.size(); i++)
+    {
+        if (_entries[i].hash == _entries[i - 1].hash && _entries[i].name != _entries[i - 1].name)
+        {
+            warn("Reflection of %u: '%s' and '%s' have the same hash, only the first is found",
+                 _object, _entries[i - 1].name.c_str(), _entries[i].name.c_str());
+        }
+    }
+}
+
+template <typename T>
+static const T* FindFirst(const std::vector<T>& _entries, uint32 _nameHash)
+{
+    T key;
+    key.hash = _nameHash;
+    typename std::vector<T>::const_iterator it = std::lower_bound(_entries.begin(), _entries.end(), key, HashLess<T>);
+    return (it != _entries.end() && it->hash == _nameHash) ? &*it : NULL;
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+const ProgramReflection& ReflectProgram(GLuint _program)
+{
+    ProgramReflection*& pTable = programTables[_program];
+    if (!pTable)
+    {
+        PROFILE_SCOPE("ReflectProgram");
+        pTable = new ProgramReflection();
+        pTable->object = _program;
+        if (_program)
+        {
+            ReadUniforms(_program, pTable->uniforms);
+            ReadBlocks(_program, pTable->blocks);
+        }
+        SortByHash(pTable->uniforms, _program);
+        SortByHash(pTable->blocks, _program);
+    }
+    return *pTable;
+}
+
+const ProgramReflection& ReflectPipeline(GLuint _pipeline)
+{
+    ProgramReflection*& pTable = pipelineTables[_pipeline];
+    if (!pTable)
+    {
+        PROFILE_SCOPE("ReflectPipeline");
+        pTable = new ProgramReflection();
+        pTable->object = _pipeline;
+
+        static const GLenum stages[] =
+        {
+            GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER
+        };
+        for (size_t i = 0; i < ArraySize(stages) && _pipeline; i++)
+        {
+            GLint program = 0;
+            glGetProgramPipelineiv(_pipeline, stages[i], &program);
+            bool listed = false;
+            for (size_t j = 0; j < i && program; j++)
+            {
+                GLint other = 0;
+                glGetProgramPipelineiv(_pipeline, stages[j], &other);
+                listed = listed || other == program;
+            }
+            if (program && !listed)
+            {
+                ReadUniforms(GLuint(program), pTable->uniforms);
+                ReadBlocks(GLuint(program), pTable->blocks);
+            }
+        }
+        SortByHash(pTable->uniforms, _pipeline);
+        SortByHash(pTable->blocks, _pipeline);
+    }
+    return *pTable;
+}
+
+UniformHandle GetUniformHandle(const ProgramReflection& _reflection, uint32 _nameHash)
+{
+    const ReflectedUniform* pUniform = FindFirst(_reflection.uniforms, _nameHash);
+    UniformHandle handle = { 0 };
+    if (!pUniform)
+        return handle;
+
+    const ReflectedUniform* pEnd = _reflection.uniforms.data() + _reflection.uniforms.size();
+    for (; pUniform != pEnd && pUniform->hash == _nameHash && handle.count < kMaxUniformStages; pUniform++)
+    {
+        handle.programs[handle.count] = pUniform->program;
+        handle.locations[handle.count] = pUniform->location;
+        handle.count++;
+    }
+    return handle;
+}
+
+const ReflectedBlock* FindUniformBlock(const ProgramReflection& _reflection, uint32 _nameHash)
+{
+    return FindFirst(_reflection.blocks, _nameHash);
+}
+
+bool BindUniformBlock(const ProgramReflection& _reflection, uint32 _nameHash, GLuint _binding)
+{
+    const ReflectedBlock* pBlock = FindFirst(_reflection.blocks, _nameHash);
+    if (!pBlock)
+        return false;
+
+    const ReflectedBlock* pEnd = _reflection.blocks.data() + _reflection.blocks.size();
+    for (; pBlock != pEnd && pBlock->hash == _nameHash; pBlock++)
+    {
+        glUniformBlockBinding(pBlock->program, pBlock->index, _binding);
+    }
+    return true;
+}
+
+void ForgetProgramReflection(GLuint _program)
+{
+    std::unordered_map<GLuint, ProgramReflection*>::iterator it = programTables.find(_program);
+    if (it != programTables.end())
+    {
+        delete it->second;
+        programTables.erase(it);
+    }
+
+    // Pipelines the program was a stage of.
+    for (it = pipelineTables.begin(); it != pipelineTables.end();)
+    {
+        bool usesProgram = false;
+        for (size_t i = 0; i < it->second->uniforms.size() && !usesProgram; i++)
+        {
+            usesProgram = it->second->uniforms[i].program == _program;
+        }
+        for (size_t i = 0; i < it->second->blocks.size() && !usesProgram; i++)
+        {
+            usesProgram = it->second->blocks[i].program == _program;
+        }
+        if (usesProgram)
+        {
+            delete it->second;
+            it = pipelineTables.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void ReflectionEndScene()
+{
+    for (std::unordered_map<GLuint, ProgramReflection*>::iterator it = programTables.begin(); it != programTables.end(); ++it)
+    {
+        delete it->second;
+    }
+    for (std::unordered_map<GLuint, ProgramReflection*>::iterator it = pipelineTables.begin(); it != pipelineTables.end(); ++it)
+    {
+        delete it->second;
+    }
+    programTables.clear();
+    pipelineTables.clear();
+}
@@ -0,0 +1,79 @@
+#ifndef _PROGRAM_REFLECTION_H_
+#define _PROGRAM_REFLECTION_H_
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "main.h"
+#include "hash.h"
+
+// Reflection tables of linked programs and program pipelines. The first ReflectProgram()
+// or ReflectPipeline() reads every default-block uniform and uniform block once through
+// glGetProgramInterfaceiv / glGetProgramResource* (GL 4.3 or ARB_program_interface_query,
+// the older glGetActive* calls otherwise); later calls return the stored table. Names are
+// looked up by ReflectionHash(), which scenes compute once, and resolved to handles when a
+// program is built. The frame only passes handles to glProgramUniform* and never looks up
+// a name. Tables are dropped when the scene ends or a hot reload deletes the program.
+
+/// Hash of a uniform or uniform block name, usable in constant expressions.
+constexpr uint32 ReflectionHash(const char* _name)
+{
+    return Fnv1a32String(_name);
+}
+
+/// A default-block uniform; arrays are listed by their name without "[0]".
+struct ReflectedUniform
+{
+    uint32      hash;
+    GLuint      program;            ///< the program holding it; a stage program for a pipeline
+    GLint       location;
+    GLenum      type;
+    GLint       arraySize;
+    std::string name;
+};
+
+struct ReflectedBlock
+{
+    uint32      hash;
+    GLuint      program;            ///< as above; a block several stages use is listed per stage
+    GLuint      index;
+    GLint       dataSize;
+    std::string name;
+};
+
+struct ProgramReflection
+{
+    GLuint      object;             ///< the program or pipeline
+    std::vector<ReflectedUniform> uniforms;     ///< sorted by hash, then stage
+    std::vector<ReflectedBlock> blocks;         ///< sorted by hash, then stage
+};
+
+static const uint32 kMaxUniformStages = 5;     ///< VS, TCS, TES, GS, FS
+
+/// A uniform resolved for glProgramUniform*(programs[i], locations[i], ...), i < count;
+/// count is 0 when no stage uses it. Every stage program of a pipeline declaring the name
+/// has its own copy of the uniform and is listed, so each of them must be set.
+struct UniformHandle
+{
+    uint32      count;
+    GLuint      programs[kMaxUniformStages];
+    GLint       locations[kMaxUniformStages];
+};
+
+const ProgramReflection& ReflectProgram(GLuint _program);
+/// The uniforms and blocks of every stage program bound to _pipeline.
+const ProgramReflection& ReflectPipeline(GLuint _pipeline);
+
+UniformHandle GetUniformHandle(const ProgramReflection& _reflection, uint32 _nameHash);
+/// The block of the first stage using it, or NULL.
+const ReflectedBlock* FindUniformBlock(const ProgramReflection& _reflection, uint32 _nameHash);
+/// glUniformBlockBinding for every stage using the block; false if none does.
+bool BindUniformBlock(const ProgramReflection& _reflection, uint32 _nameHash, GLuint _binding);
+
+/// Drop the table of a program that is about to be deleted, before its name is reused.
+void ForgetProgramReflection(GLuint _program);
+/// Drop every table; the harness calls this when the scene ends.
+void ReflectionEndScene();
+
+#endif
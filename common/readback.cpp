@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+
+#include "readback.h"
+#include "harness.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+
+enum ReadbackSlotState
+{
+    SLOT_FREE,          ///< may be written by the next capture
+    SLOT_GPU,           ///< glReadPixels queued, waiting for the fence
+    SLOT_WORKER,        ///< data complete, owned by the worker until the consumer returns
+};
+
+struct ReadbackSlot
+{
+    GLuint              pbo;
+    size_t              capacity;
+    uint8*              pMapped;    ///< persistent mapping, NULL without ARB_buffer_storage
+    std::vector<uint8>  copy;       ///< staging copy for the map/unmap path
+    GLsync              fence;
+    ReadbackFrame       frame;
+    ReadbackSlotState   state;      ///< guarded by workerMutex
+};
+
+static bool enabled = false;
+static bool persistent = false;
+static ReadbackConsumer consumers[kReadbackMaxConsumers];
+static uint32 consumerCount = 0;
+
+static ReadbackSlot slots[kReadbackRingSize];
+static uint32 writeIndex = 0;           ///< next slot to capture into; also the oldest in flight
+
+static std::thread worker;
+static std::mutex workerMutex;
+static std::condition_variable workerCondition;
+static std::deque<ReadbackSlot*> workerQueue;
+static bool stopWorker = false;
+
+static const char* sceneName = "";
+static uint32 sceneFrame = 0;
+static uint32 capturedFrames = 0;
+static uint32 gpuWaits = 0;             ///< captures that had to wait for an older fence
+static uint32 workerWaits = 0;          ///< captures that had to wait for the consumer
+
+static std::string captureDir;          ///< --capture, absolute
+static uint32 writtenFrames = 0;        ///< by the worker; read once the ring has drained
+
+// ----------------------------------------------------------------------------------------------------------------
+// Default consumer: <capture dir>/<scene>_<frame>.ppm, flipped to top-down rows.
+static void WritePPM(const ReadbackFrame& _frame)
+{
+    PROFILE_SCOPE("WritePPM");
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s_%05u.ppm", captureDir.c_str(), _frame.scene, _frame.frame);
+    FILE* file = 0;
+    fopen_s(&file, path, "wb");
+    if (!file)
+    {
+        warn("Unable to write capture '%s'", path);
+        return;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", _frame.width, _frame.height);
+    std::vector<uint8> row(_frame.width * 3);
+    for (uint32 y = _frame.height; y-- > 0;)
+    {
+        const uint8* src = _frame.pixels + size_t(y) * _frame.width * 4;
+        for (uint32 x = 0; x < _frame.width; x++)
+        {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed)
+    {
+        warn("Unable to write capture '%s'", path);
+        return;
+    }
+    writtenFrames++;
+}
+
+static void WorkerMain()
+{
+    ProfilerSetThreadName("readback");
+
+    std::unique_lock<std::mutex> lock(workerMutex);
+    while (1)
+    {
+        workerCondition.wait(lock, [] { return !workerQueue.empty() || stopWorker; });
+        if (workerQueue.empty())
+            break;
+
+        ReadbackSlot* pSlot = workerQueue.front();
+        workerQueue.pop_front();
+        lock.unlock();
+
+        for (uint32 i = 0; i < consumerCount; i++)
+        {
+            consumers[i](pSlot->frame);
+        }
+
+        lock.lock();
+        pSlot->state = SLOT_FREE;
+        workerCondition.notify_all();
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+static void AllocateSlot(ReadbackSlot& slot, size_t size)
+{
+    if (slot.pbo)
+    {
+        glDeleteBuffers(1, &slot.pbo);  // also drops a persistent mapping
+    }
+
+    glGenBuffers(1, &slot.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (persistent)
+    {
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_PACK_BUFFER, size, NULL, flags);
+        slot.pMapped = (uint8*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags);
+    }
+    else
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot.copy.resize(size);
+        slot.pMapped = NULL;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.capacity = size;
+}
+
+// The fence has signaled: give the pixels to the worker.
+static void HandToWorker(ReadbackSlot& slot)
+{
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    if (slot.pMapped)
+    {
+        slot.frame.pixels = slot.pMapped;
+    }
+    else
+    {
+        PROFILE_SCOPE("ReadbackMap");
+        size_t size = size_t(slot.frame.width) * slot.frame.height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* pData = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (pData)
+        {
+            memcpy(slot.copy.data(), pData, size);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.frame.pixels = slot.copy.data();
+    }
+
+    std::lock_guard<std::mutex> lock(workerMutex);
+    slot.state = SLOT_WORKER;
+    workerQueue.push_back(&slot);
+    workerCondition.notify_all();
+}
+
+// Hand over every slot whose fence has signaled, oldest first; stop at the first one
+// still in flight to keep frames in order. With _wait, block on the remaining fences.
+static void PollSlots(bool _wait)
+{
+    for (uint32 i = 0; i < kReadbackRingSize; i++)
+    {
+        ReadbackSlot& slot = slots[(writeIndex + i) % kReadbackRingSize];
+        if (!slot.fence)
+            continue;
+
+        GLuint64 timeout = _wait ? GL_TIMEOUT_IGNORED : 0;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+        HandToWorker(slot);
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void ReadbackAddConsumer(ReadbackConsumer _consumer)
+{
+    if (consumerCount == kReadbackMaxConsumers)
+    {
+        error("Too many readback consumers");
+    }
+    consumers[consumerCount++] = _consumer;
+}
+
+void ReadbackInit()
+{
+    if (g_harnessOptions.captureDir)
+    {
+        // Scenes run from their own directories; pin a relative path to the start directory.
+        captureDir = g_harnessOptions.captureDir;
+        bool absolute = !captureDir.empty() && (captureDir[0] == '/' || captureDir[0] == '\\'
+                                                || (captureDir.size() > 1 && captureDir[1] == ':'));
+        if (!absolute)
+        {
+            char cwd[4096] = "";
+            if (!getcwd(cwd, sizeof(cwd)))
+            {
+                error("Unable to query the working directory.");
+            }
+            captureDir = std::string(cwd) + "/" + captureDir;
+        }
+        ReadbackAddConsumer(WritePPM);
+    }
+    if (!consumerCount)
+        return;
+
+    persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    for (uint32 i = 0; i < kReadbackRingSize; i++)
+    {
+        slots[i].pbo = 0;
+        slots[i].capacity = 0;
+        slots[i].pMapped = NULL;
+        slots[i].fence = 0;
+        slots[i].state = SLOT_FREE;
+    }
+    writeIndex = 0;
+
+    stopWorker = false;
+    worker = std::thread(WorkerMain);
+    enabled = true;
+
+    log("Readback: %u PBOs, %s, every %u frames", kReadbackRingSize,
+        persistent ? "persistently mapped" : "map/copy", g_harnessOptions.captureEvery ? g_harnessOptions.captureEvery : 1);
+}
+
+void ReadbackShutdown()
+{
+    if (!enabled)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        stopWorker = true;
+        workerCondition.notify_all();
+    }
+    worker.join();
+
+    for (uint32 i = 0; i < kReadbackRingSize; i++)
+    {
+        if (slots[i].fence)
+            glDeleteSync(slots[i].fence);
+        if (slots[i].pbo)
+            glDeleteBuffers(1, &slots[i].pbo);
+        slots[i].fence = 0;
+        slots[i].pbo = 0;
+        slots[i].pMapped = NULL;
+    }
+    enabled = false;
+    consumerCount = 0;
+    captureDir.clear();
+}
+
+bool IsReadbackEnabled()
+{
+    return enabled;
+}
+
+void ReadbackBeginScene(const char* _sceneName)
+{
+    sceneName = _sceneName;
+    sceneFrame = 0;
+    capturedFrames = 0;
+    writtenFrames = 0;
+    gpuWaits = 0;
+    workerWaits = 0;
+}
+
+void ReadbackCaptureFrame(uint32 _framebuffer, uint32 _width, uint32 _height)
+{
+    if (!enabled)
+        return;
+
+    uint32 every = g_harnessOptions.captureEvery ? g_harnessOptions.captureEvery : 1;
+    uint32 frame = sceneFrame++;
+    if (frame % every != 0)
+        return;
+
+    PROFILE_SCOPE("ReadbackCapture");
+    GPU_SCOPE("readback");
+    PollSlots(false);
+
+    ReadbackSlot& slot = slots[writeIndex];
+    if (slot.fence)
+    {
+        // The GPU is more than kReadbackRingSize captures behind.
+        gpuWaits++;
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        HandToWorker(slot);
+    }
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        if (slot.state != SLOT_FREE)
+        {
+            // The consumer is slower than the capture rate.
+            PROFILE_SCOPE("ReadbackWaitWorker");
+            workerWaits++;
+            workerCondition.wait(lock, [&slot] { return slot.state == SLOT_FREE; });
+        }
+    }
+
+    size_t size = size_t(_width) * _height * 4;
+    if (slot.capacity < size)
+    {
+        AllocateSlot(slot, size);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffer);
+    glReadBuffer(_framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    slot.frame.scene = sceneName;
+    slot.frame.frame = frame;
+    slot.frame.width = _width;
+    slot.frame.height = _height;
+    slot.frame.pixels = NULL;
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        slot.state = SLOT_GPU;
+    }
+    writeIndex = (writeIndex + 1) % kReadbackRingSize;
+    capturedFrames++;
+}
+
+void ReadbackEndScene()
+{
+    if (!enabled)
+        return;
+
+    PollSlots(true);
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        workerCondition.wait(lock, [] {
+            for (uint32 i = 0; i < kReadbackRingSize; i++)
+            {
+                if (slots[i].state != SLOT_FREE)
+                    return false;
+            }
+            return true;
+        });
+    }
+
+    log("Readback: %u frames captured, %u waited for the GPU, %u waited for the consumer",
+        capturedFrames, gpuWaits, workerWaits);
+    if (!captureDir.empty())
+    {
+        log("  %u of %u frames written to '%s'", writtenFrames, capturedFrames, captureDir.c_str());
+    }
+}
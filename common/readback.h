@@ -0,0 +1,48 @@
+#ifndef _READBACK_H_
+#define _READBACK_H_
+
+#include "main.h"
+
+// Asynchronous frame readback. glReadPixels goes into a ring of pixel-pack buffers and
+// is fenced; a slot is only touched again kReadbackRingSize captures later, so frame N
+// is copied while frames N+1 and N+2 render and the pipeline never stalls on the read.
+// Finished frames are handed to a worker thread, which runs the consumers (--capture DIR
+// adds one writing a PPM per frame). With GL 4.4 / ARB_buffer_storage the
+// buffers stay persistently mapped and the worker reads them in place.
+
+static const uint32 kReadbackRingSize = 3;
+static const uint32 kReadbackMaxConsumers = 4;
+
+/// One captured frame. Rows are bottom-up (GL order), RGBA8, tightly packed.
+struct ReadbackFrame
+{
+    const char*     scene;
+    uint32          frame;
+    uint32          width;
+    uint32          height;
+    const uint8*    pixels;
+};
+
+/// Runs on the readback worker thread; pixels are only valid during the call.
+typedef void (*ReadbackConsumer)(const ReadbackFrame& _frame);
+
+/// Add a consumer; enables readback even without --capture. Call before ReadbackInit().
+/// Consumers run in the order they were added.
+void ReadbackAddConsumer(ReadbackConsumer _consumer);
+
+/// Create the ring and start the worker if --capture was given or a consumer was added.
+void ReadbackInit();
+void ReadbackShutdown();
+
+bool IsReadbackEnabled();
+
+void ReadbackBeginScene(const char* _sceneName);
+
+/// Queue the read of this frame's color buffer (GL_BACK of framebuffer 0, or attachment 0
+/// of _framebuffer); captures every --capture-every frames. Call after the scene drew.
+void ReadbackCaptureFrame(uint32 _framebuffer, uint32 _width, uint32 _height);
+
+/// Wait for every frame in flight to reach the consumer and print the scene's report.
+void ReadbackEndScene();
+
+#endif
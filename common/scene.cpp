@@ -0,0 +1,130 @@
+#include <string.h>
+#include <string>
+
+#include "scene.h"
+#include "caps.h"
+#include "harness.h"
+
+// Function-local so registration from other translation units' static
+// initializers never sees an unconstructed vector.
+static std::vector<Scene>& SceneRegistry()
+{
+    static std::vector<Scene> scenes;
+    return scenes;
+}
+
+void RegisterScene(const Scene& _scene)
+{
+    SceneRegistry().push_back(_scene);
+}
+
+const std::vector<Scene>& GetScenes()
+{
+    return SceneRegistry();
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+const Scene* FindScene(const char* _name)
+{
+    const std::vector<Scene>& scenes = GetScenes();
+    size_t length = strlen(_name);
+
+    for (size_t i = 0; i < scenes.size(); i++)
+    {
+        const char* name = scenes[i].name;
+        if (strcmp(name, _name) == 0)
+            return &scenes[i];
+
+        // "test6" matches "test6_cube_full".
+        if (strncmp(name, _name, length) == 0 && name[length] == '_')
+            return &scenes[i];
+    }
+    return NULL;
+}
+
+std::vector<const Scene*> SelectScenes(const char* _list)
+{
+    std::vector<const Scene*> selected;
+    const std::vector<Scene>& scenes = GetScenes();
+
+    if (!_list || *_list == '\0')
+    {
+        for (size_t i = 0; i < scenes.size(); i++)
+        {
+            selected.push_back(&scenes[i]);
+        }
+        return selected;
+    }
+
+    const char* begin = _list;
+    while (*begin)
+    {
+        const char* end = strchr(begin, ',');
+        std::string name = end ? std::string(begin, end) : std::string(begin);
+
+        if (!name.empty())
+        {
+            const Scene* pScene = FindScene(name.c_str());
+            if (!pScene)
+            {
+                error("Unknown scene '%s' (use --list-scenes)", name.c_str());
+            }
+            selected.push_back(pScene);
+        }
+
+        if (!end)
+            break;
+        begin = end + 1;
+    }
+    return selected;
+}
+
+void PrintSceneSummary(const std::vector<SceneResult>& _results)
+{
+    log("Scene summary:");
+    log("  %-26s %7s %9s %9s %9s %9s %9s %9s %9s",
+        "scene", "frames", "mean ms", "median ms", "p95 ms", "p99 ms", "max ms", "FPS", "skipped");
+    for (size_t i = 0; i < _results.size(); i++)
+    {
+        const FrameStatsSummary& s = _results[i].summary;
+        log("  %-26s %7u %9.3f %9.3f %9.3f %9.3f %9.3f %9.1f %9.1f", _results[i].pScene->name,
+            s.frames, s.meanMs, s.medianMs, s.p95Ms, s.p99Ms, s.maxMs, s.fps, _results[i].stateCache.skippedPerFrame);
+    }
+}
+
+void WriteSceneResults(const char* _path, const std::vector<SceneResult>& _results)
+{
+    FILE* file = 0;
+    fopen_s(&file, _path, "wb");
+    if (!file)
+    {
+        warn("Unable to write results file '%s'", _path);
+        return;
+    }
+
+    fprintf(file, "{\n\"harness\": { \"frames\": %u, \"warmup\": %u, \"noVsync\": %s, \"pacing\": ",
+            g_harnessOptions.frames, g_harnessOptions.warmup, g_harnessOptions.noVsync ? "true" : "false");
+    WriteJsonString(file, g_harnessOptions.pacing ? g_harnessOptions.pacing : "unthrottled");
+    fprintf(file, ", \"offscreen\": ");
+    WriteJsonString(file, g_harnessOptions.offscreen ? g_harnessOptions.offscreen : "");
+    fprintf(file, ", \"msaa\": %u, \"stateCache\": %s },\n\"scenes\": [", g_harnessOptions.msaa,
+            g_harnessOptions.noStateCache ? "false" : "true");
+    for (size_t i = 0; i < _results.size(); i++)
+    {
+        const FrameStatsSummary& s = _results[i].summary;
+        const StateCacheSummary& state = _results[i].stateCache;
+        fprintf(file, "%s\n    { \"name\": ", i ? "," : "");
+        WriteJsonString(file, _results[i].pScene->name);
+        fprintf(file, ", \"frames\": %u, \"meanMs\": %.4f, \"medianMs\": %.4f, \"p95Ms\": %.4f, "
+                      "\"p99Ms\": %.4f, \"maxMs\": %.4f, \"fps\": %.2f, \"stateCallsPerFrame\": %.2f, "
+                      "\"stateSkippedPerFrame\": %.2f }",
+                s.frames, s.meanMs, s.medianMs, s.p95Ms, s.p99Ms, s.maxMs, s.fps, state.callsPerFrame,
+                state.skippedPerFrame);
+    }
+    fprintf(file, "\n],\n\"caps\": ");
+    WriteCapsJson(file);
+    fprintf(file, "\n}\n");
+    fclose(file);
+
+    log("Wrote results of %u scenes to '%s'", uint32(_results.size()), _path);
+}
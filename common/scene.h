@@ -0,0 +1,58 @@
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <vector>
+
+#include "main.h"
+#include "benchmark.h"
+#include "state_cache.h"
+#include "gl_record.h"
+
+/// Entry points of one test. Each test lives in its own namespace and registers
+/// itself with REGISTER_SCENE, so any number of tests can be linked into one binary.
+struct Scene
+{
+    const char* name;
+    const char* dir;        ///< directory holding the scene's shaders, relative to the scene root
+    void (*ProcessCommandLine)(int argc, char* argv[]);
+    bool (*InitGL)(size_t Width, size_t Height);
+    void (*ReSizeGLScene)(size_t Width, size_t Height);
+    void (*DrawGLScene)(void);
+    void (*DeInitGL)(void);
+};
+
+/// Outcome of one scene run by the harness.
+struct SceneResult
+{
+    const Scene*        pScene;
+    FrameStatsSummary   summary;
+    StateCacheSummary   stateCache;
+};
+
+void RegisterScene(const Scene& _scene);
+const std::vector<Scene>& GetScenes();
+
+/// Find a scene by its full name ("test6_cube_full") or its short prefix ("test6").
+const Scene* FindScene(const char* _name);
+
+/// Resolve a comma separated list of scene names; NULL or empty selects every scene.
+std::vector<const Scene*> SelectScenes(const char* _list);
+
+void PrintSceneSummary(const std::vector<SceneResult>& _results);
+
+/// Results of the run plus the capability snapshot (caps.h) as JSON.
+void WriteSceneResults(const char* _path, const std::vector<SceneResult>& _results);
+
+struct SceneRegistrar
+{
+    explicit SceneRegistrar(const Scene& _scene) { RegisterScene(_scene); }
+};
+
+/// Register the scene implemented in namespace _ns (named after the test directory).
+#define REGISTER_SCENE(_ns)                                             \
+    static SceneRegistrar _ns##_registrar(Scene {                       \
+        #_ns, #_ns,                                                     \
+        &_ns::ProcessCommandLine, &_ns::InitGL, &_ns::ReSizeGLScene,    \
+        &_ns::DrawGLScene, &_ns::DeInitGL })
+
+#endif
@@ -1,8 +1,18 @@
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "shader.hpp"
 #include "main.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "shader_source.h"
+#include "hot_reload.h"
+#include "hash.h"
 
 #ifndef max
 #define max(a,b)            (((a) > (b)) ? (a) : (b))
@@ -12,29 +22,17 @@
 #define min(a,b)            (((a) < (b)) ? (a) : (b))
 #endif
 
+// The source, include and variant caches below are shared with the hot reload thread
+// (see hot_reload.h); every public function using them holds this lock.
+static std::mutex shaderMutex;
+
 // --------------------------------------------------------------------------------------------------------------------
-std::string FileContentsToString(std::string _filename)
+std::string FileContentsToString(const std::string& _filename)
 {
-    std::string retBuffer;
-
-    FILE* file = 0;
-    fopen_s(&file, _filename.c_str(), "rb");
-    if (file) {
-        fseek(file, 0, SEEK_END);
-        size_t bytes = ftell(file);
-
-        retBuffer.resize(bytes + 1);
-
-        fseek(file, 0, SEEK_SET);
-        fread(&(*retBuffer.begin()), 1, bytes, file);
-        fclose(file);
-        file = 0;
-        return retBuffer;
-    }
-
-    error("Unable to locate file '%s'", _filename.c_str());
-
-    return retBuffer;
+    PROFILE_SCOPE("FileContentsToString");
+    std::lock_guard<std::mutex> lock(shaderMutex);
+    ShaderSourceRef pSource = LoadShaderSource(_filename);
+    return std::string(pSource->data, pSource->size);
 }
 
 
@@ -63,117 +61,467 @@ bool CheckProgram(GLuint ProgramName)
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-GLuint CompileShaderFromString(GLenum _shaderType, std::string &_shaderStr)
+// #include "file" resolution, relative to the including file. Every file is expanded at
+// most once per shader (later includes of it are dropped, which also breaks cycles) and
+// wrapped in "#line <line> <file index>" directives, so the driver reports errors against
+// the original file and line; CheckShaderCompile() puts the file names back into the log.
+// The include list of every file is parsed once per content hash, and an expanded shader
+// is reused until one of its files changes on disk.
+
+struct IncludeDirective
+{
+    size_t      begin;              ///< offset of the directive's line
+    size_t      end;                ///< offset past the line
+    uint32      line;
+    std::string name;
+};
+
+struct IncludeList
+{
+    bool                            parsed;
+    uint64                          hash;       ///< of the contents the list was parsed from
+    std::vector<IncludeDirective>   includes;
+};
+
+// Never changed once PreprocessShader() returned it: a file that changes gets a new one,
+// and whoever still holds the old one (a ProgramBatchEntry) keeps its files mapped.
+struct PreprocessedShader
+{
+    const char*                     data;       ///< the root file's mapping, or text
+    size_t                          size;
+    uint64                          hash;       ///< over the contents of every file
+    std::string                     text;       ///< the expansion; empty without #include
+    std::vector<ShaderSourceRef>    files;      ///< #line source string number -> file
+    std::vector<std::string>        names;      ///< as given or as written in the #include
+    std::vector<uint64>             fileHashes; ///< contents the expansion was made from
+};
+
+/// By absolute path.
+static std::unordered_map<std::string, IncludeList> includeLists;
+static std::unordered_map<std::string, PreprocessedShaderRef> preprocessedShaders;
+
+static bool IsIdentifierChar(char _c)
+{
+    return (_c >= 'a' && _c <= 'z') || (_c >= 'A' && _c <= 'Z') || (_c >= '0' && _c <= '9') || _c == '_';
+}
+
+static const std::vector<IncludeDirective>& ParseIncludes(const ShaderSource* _pSource)
+{
+    IncludeList& list = includeLists[_pSource->path];
+    if (list.parsed && list.hash == _pSource->hash) {
+        return list.includes;
+    }
+
+    list.parsed = true;
+    list.hash = _pSource->hash;
+    list.includes.clear();
+    const char* data = _pSource->data;
+    size_t size = _pSource->size;
+    uint32 line = 1;
+    for (size_t lineStart = 0; lineStart < size; line++) {
+        const char* newline = (const char*)memchr(data + lineStart, '\n', size - lineStart);
+        size_t lineEnd = newline ? size_t(newline - data) : size;
+        size_t next = newline ? lineEnd + 1 : size;
+
+        size_t pos = lineStart;
+        while (pos < lineEnd && (data[pos] == ' ' || data[pos] == '\t')) {
+            pos++;
+        }
+        if (pos < lineEnd && data[pos] == '#') {
+            pos++;
+            while (pos < lineEnd && (data[pos] == ' ' || data[pos] == '\t')) {
+                pos++;
+            }
+            if (lineEnd - pos > 7 && memcmp(data + pos, "include", 7) == 0 && !IsIdentifierChar(data[pos + 7])) {
+                pos += 7;
+                while (pos < lineEnd && (data[pos] == ' ' || data[pos] == '\t')) {
+                    pos++;
+                }
+                char close = pos < lineEnd ? (data[pos] == '"' ? '"' : data[pos] == '<' ? '>' : 0) : 0;
+                const char* nameEnd = close ? (const char*)memchr(data + pos + 1, close, lineEnd - pos - 1) : NULL;
+                if (!nameEnd || nameEnd == data + pos + 1) {
+                    error("%s:%u: malformed #include", _pSource->path, line);
+                }
+
+                IncludeDirective directive;
+                directive.begin = lineStart;
+                directive.end = next;
+                directive.line = line;
+                directive.name.assign(data + pos + 1, nameEnd);
+                list.includes.push_back(directive);
+            }
+        }
+        lineStart = next;
+    }
+    return list.includes;
+}
+
+static std::string ResolveInclude(const ShaderSource* _pIncluding, const IncludeDirective& _directive)
+{
+    const std::string& name = _directive.name;
+    bool absolute = name[0] == '/' || name[0] == '\\' || (name.size() > 1 && name[1] == ':');
+    std::string path = name;
+    if (!absolute) {
+        std::string directory = _pIncluding->path;
+        size_t slash = directory.find_last_of("/\\");
+        path = directory.substr(0, slash == std::string::npos ? 0 : slash + 1) + name;
+    }
+
+    FILE* file = 0;
+    fopen_s(&file, path.c_str(), "rb");
+    if (!file) {
+        error("%s:%u: unable to open include '%s'", _pIncluding->path, _directive.line, name.c_str());
+    }
+    fclose(file);
+    return path;
+}
+
+static void ExpandIncludes(PreprocessedShader& _shader, const ShaderSource* _pFile, uint32 _fileIndex)
+{
+    const std::vector<IncludeDirective>& includes = ParseIncludes(_pFile);
+    size_t pos = 0;
+    for (size_t i = 0; i < includes.size(); i++) {
+        const IncludeDirective& directive = includes[i];
+        _shader.text.append(_pFile->data + pos, directive.begin - pos);
+        pos = directive.end;
+
+        ShaderSourceRef pIncluded = LoadShaderSource(ResolveInclude(_pFile, directive));
+        if (std::find(_shader.files.begin(), _shader.files.end(), pIncluded) == _shader.files.end()) {
+            uint32 index = uint32(_shader.files.size());
+            _shader.files.push_back(pIncluded);
+            _shader.names.push_back(directive.name);
+            _shader.fileHashes.push_back(pIncluded->hash);
+
+            char lineDirective[32];
+            snprintf(lineDirective, sizeof(lineDirective), "#line 1 %u\n", index);
+            _shader.text += lineDirective;
+            ExpandIncludes(_shader, pIncluded.get(), index);
+            if (!_shader.text.empty() && _shader.text[_shader.text.size() - 1] != '\n') {
+                _shader.text += '\n';
+            }
+        }
+
+        char lineDirective[32];
+        snprintf(lineDirective, sizeof(lineDirective), "#line %u %u\n", directive.line + 1, _fileIndex);
+        _shader.text += lineDirective;
+    }
+    _shader.text.append(_pFile->data + pos, _pFile->size - pos);
+}
+
+// Current while every file is still the mapping LoadShaderSource() hands out.
+static bool IsPreprocessedShaderCurrent(const PreprocessedShader& _shader, const ShaderSourceRef& _pRoot)
 {
-    GLuint retVal = glCreateShader(_shaderType);
+    if (_shader.files[0] != _pRoot)
+        return false;
+    for (size_t i = 1; i < _shader.files.size(); i++) {
+        if (LoadShaderSource(_shader.files[i]->path) != _shader.files[i])
+            return false;
+    }
+    return true;
+}
+
+static PreprocessedShaderRef PreprocessShader(const std::string& _filename)
+{
+    PROFILE_SCOPE("PreprocessShader");
+    ShaderSourceRef pRoot = LoadShaderSource(_filename);
+    PreprocessedShaderRef& pCached = preprocessedShaders[pRoot->path];
+    if (pCached && IsPreprocessedShaderCurrent(*pCached, pRoot)) {
+        return pCached;
+    }
+
+    std::shared_ptr<PreprocessedShader> pShader = std::make_shared<PreprocessedShader>();
+    pShader->files.assign(1, pRoot);
+    pShader->names.assign(1, _filename);
+    pShader->fileHashes.assign(1, pRoot->hash);
+    if (ParseIncludes(pRoot.get()).empty()) {
+        pShader->data = pRoot->data;
+        pShader->size = pRoot->size;
+        pShader->hash = pRoot->hash;
+    } else {
+        ExpandIncludes(*pShader, pRoot.get(), 0);
+        pShader->data = pShader->text.c_str();
+        pShader->size = pShader->text.size();
+        pShader->hash = Fnv1a64(kFnv1a64Basis, pShader->fileHashes.data(),
+                                  pShader->fileHashes.size() * sizeof(pShader->fileHashes[0]));
+    }
+    pCached = pShader;
+    return pCached;
+}
 
-    const char* shaderStrings[] = {
-        // versionStr.c_str(),
-        // "\n",
-        // _shaderPrefix.c_str(),
-        // "\n",
-        _shaderStr.c_str()
+// Drivers prefix messages with the source string number: "0:12(3): error" (Mesa),
+// "0(12) : error" (NVIDIA), "ERROR: 0:12:" (AMD). Replace it with the file name.
+static std::string MapInfoLog(const char* _log, const PreprocessedShader* _pShader)
+{
+    std::string mapped;
+    const char* line = _log;
+    while (*line) {
+        const char* lineEnd = strchr(line, '\n');
+        lineEnd = lineEnd ? lineEnd + 1 : line + strlen(line);
+
+        const char* pos = line;
+        if (strncmp(pos, "ERROR: ", 7) == 0) {
+            pos += 7;
+        } else if (strncmp(pos, "WARNING: ", 9) == 0) {
+            pos += 9;
+        }
+        const char* digits = pos;
+        uint32 index = 0;
+        while (pos < lineEnd && *pos >= '0' && *pos <= '9') {
+            index = index * 10 + uint32(*pos - '0');
+            pos++;
+        }
+        if (pos > digits && (*pos == ':' || *pos == '(') && index < _pShader->names.size()) {
+            mapped.append(line, digits);
+            mapped += _pShader->names[index];
+            mapped.append(pos, lineEnd);
+        } else {
+            mapped.append(line, lineEnd);
+        }
+        line = lineEnd;
+    }
+    return mapped;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Shader permutations. A variant is a stage source plus the #define lines of the shader
+// prefix that name an identifier the source or another selected line uses; other lines
+// of the prefix are kept as they are. The lines are injected right after #version,
+// followed by a #line so compile errors keep the file's line numbers. Variants are keyed
+// by stage type, source hash and selected defines, and compiled at most once per
+// ProgramBatch: programs of the batch needing the same variant attach the same shader
+// object, and defines a stage does not use never cause another compile of it. The shader
+// objects are deleted as soon as the batch is linked, so another batch (or CreateProgram
+// call) needing the variant compiles it again; across batches only --program-cache saves
+// work, and only for whole programs it has linked before.
+
+struct ShaderVariant
+{
+    GLuint  shader;
+    int     status;                 ///< -1 not checked yet, 0 failed, 1 compiled
+};
+
+typedef std::unordered_map<uint64, ShaderVariant> ShaderVariantMap;
+
+static bool ContainsIdentifier(const char* _data, size_t _size, const char* _name, size_t _length)
+{
+    for (size_t i = 0; i + _length <= _size; i++) {
+        if (_data[i] == _name[0] && memcmp(_data + i, _name, _length) == 0
+            && (i == 0 || !IsIdentifierChar(_data[i - 1]))
+            && (i + _length == _size || !IsIdentifierChar(_data[i + _length]))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The lines of _shaderPrefix that matter for _pSource, each terminated by a newline. A
+// #define is kept if the source or another kept line names it, so #define N 4 stays
+// for #define SIZE (N*2) when only SIZE is used; that is iterated to a fixpoint.
+static std::string SelectDefines(const PreprocessedShader* _pSource, const std::string& _shaderPrefix)
+{
+    struct PrefixLine {
+        const char* text;
+        size_t      length;
+        size_t      nameStart;          ///< of the #define name; nameEnd == nameStart otherwise
+        size_t      nameEnd;
+        bool        keep;
     };
+    std::vector<PrefixLine> lines;
 
-    glShaderSource(retVal, ArraySize(shaderStrings), shaderStrings, nullptr);
-    glCompileShader(retVal);
+    size_t lineStart = 0;
+    while (lineStart < _shaderPrefix.size()) {
+        size_t lineEnd = _shaderPrefix.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = _shaderPrefix.size();
+        }
+        PrefixLine line = { _shaderPrefix.c_str() + lineStart, lineEnd - lineStart, 0, 0, true };
+        lineStart = lineEnd + 1;
 
-    GLint compileStatus = 0;
-    glGetShaderiv(retVal, GL_COMPILE_STATUS, &compileStatus);
+        size_t pos = 0;
+        while (pos < line.length && (line.text[pos] == ' ' || line.text[pos] == '\t' || line.text[pos] == '\r')) {
+            pos++;
+        }
+        if (pos == line.length) {
+            continue;
+        }
 
-    GLint glinfoLogLength = 0;
-    glGetShaderiv(retVal, GL_INFO_LOG_LENGTH, &glinfoLogLength);
-    if (glinfoLogLength > 1) {
-        GLchar* buffer = new GLchar[glinfoLogLength];
-        glGetShaderInfoLog(retVal, glinfoLogLength, &glinfoLogLength, buffer);
-        if (compileStatus != GL_TRUE) {
-            warn("Shader Compilation failed for shader \n======\n%s\n, with the following errors:", _shaderStr.c_str());
+        if (line.length - pos > 7 && memcmp(line.text + pos, "#define", 7) == 0 && (line.text[pos + 7] == ' ' || line.text[pos + 7] == '\t')) {
+            pos += 7;
+            while (pos < line.length && (line.text[pos] == ' ' || line.text[pos] == '\t')) {
+                pos++;
+            }
+            line.nameStart = pos;
+            while (pos < line.length && IsIdentifierChar(line.text[pos])) {
+                pos++;
+            }
+            line.nameEnd = pos;
+            line.keep = pos == line.nameStart
+                || ContainsIdentifier(_pSource->data, _pSource->size, line.text + line.nameStart, pos - line.nameStart);
         }
-        else {
-            log("Shader Compilation succeeded for shader \n======\n%s\n, with the following log:", _shaderStr.c_str());
+        lines.push_back(line);
+    }
+
+    // Kept lines may name dropped defines; the value of a #define is what follows its name.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < lines.size(); i++) {
+            PrefixLine& define = lines[i];
+            if (define.keep) {
+                continue;
+            }
+            for (size_t j = 0; j < lines.size() && !define.keep; j++) {
+                const PrefixLine& user = lines[j];
+                size_t from = user.nameEnd;
+                if (user.keep && ContainsIdentifier(user.text + from, user.length - from, define.text + define.nameStart,
+                                                    define.nameEnd - define.nameStart)) {
+                    define.keep = changed = true;
+                }
+            }
         }
+    }
 
-        log("%s", buffer);
-        delete[] buffer;
+    std::string defines;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (lines[i].keep) {
+            defines.append(lines[i].text, lines[i].length);
+            defines += '\n';
+        }
     }
+    return defines;
+}
 
-    if (compileStatus != GL_TRUE) {
-        glDeleteShader(retVal);
-        retVal = 0;
+// Offset just past the #version line (0 if there is none) and the number of that line.
+static size_t FindVersionEnd(const PreprocessedShader* _pSource, uint32& _versionLine)
+{
+    const char* data = _pSource->data;
+    size_t size = _pSource->size;
+    uint32 line = 1;
+    for (size_t lineStart = 0; lineStart < size; line++) {
+        const char* newline = (const char*)memchr(data + lineStart, '\n', size - lineStart);
+        size_t lineEnd = newline ? size_t(newline - data) : size;
+
+        size_t pos = lineStart;
+        while (pos < lineEnd && (data[pos] == ' ' || data[pos] == '\t')) {
+            pos++;
+        }
+        if (lineEnd - pos >= 8 && memcmp(data + pos, "#version", 8) == 0) {
+            _versionLine = line;
+            return newline ? lineEnd + 1 : size;
+        }
+        lineStart = lineEnd + 1;
     }
+    _versionLine = 0;
+    return 0;
+}
 
-    return retVal;
+static uint64 ShaderVariantKey(GLenum _shaderType, const PreprocessedShader* _pSource, const std::string& _defines)
+{
+    uint64 hash = kFnv1a64Basis;
+    uint32 type = _shaderType;
+    hash = Fnv1a64(hash, &type, sizeof(type));
+    hash = Fnv1a64(hash, &_pSource->hash, sizeof(_pSource->hash));
+    return Fnv1a64(hash, _defines.c_str(), _defines.size());
+}
+
+// The source as glShaderSource receives it: up to the #version line, the defines, a #line
+// restoring the numbering, the rest of the file. Returns the number of strings.
+static GLsizei SplitShaderSource(const PreprocessedShader* _pSource, const std::string& _defines, char (&_lineDirective)[32],
+                                 const char* (&_strings)[4], GLint (&_lengths)[4])
+{
+    if (_defines.empty()) {
+        _strings[0] = _pSource->data;
+        _lengths[0] = GLint(_pSource->size);
+        return 1;
+    }
+
+    uint32 versionLine = 0;
+    size_t split = FindVersionEnd(_pSource, versionLine);
+    snprintf(_lineDirective, sizeof(_lineDirective), "#line %u 0\n", versionLine + 1);
+
+    _strings[0] = _pSource->data;
+    _lengths[0] = GLint(split);
+    _strings[1] = _defines.c_str();
+    _lengths[1] = GLint(_defines.size());
+    _strings[2] = _lineDirective;
+    _lengths[2] = GLint(strlen(_lineDirective));
+    _strings[3] = _pSource->data + split;
+    _lengths[3] = GLint(_pSource->size - split);
+    return 4;
+}
+
+static void SubmitShaderSource(GLuint _shader, const PreprocessedShader* _pSource, const std::string& _defines)
+{
+    char lineDirective[32];
+    const char* shaderStrings[4];
+    GLint shaderLengths[4];
+    GLsizei count = SplitShaderSource(_pSource, _defines, lineDirective, shaderStrings, shaderLengths);
+
+    glShaderSource(_shader, count, shaderStrings, shaderLengths);
+    glCompileShader(_shader);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-GLuint CompileShaderFromFile(GLenum _shaderType, std::string _shaderFilename, std::string _shaderPrefix)
-{
-    std::string shaderFullPath = _shaderFilename;
-
-    const char* shaderPrefix = _shaderPrefix.c_str();
-
-    GLuint retVal = glCreateShader(_shaderType);
-    std::string fileContents = FileContentsToString(shaderFullPath);
-    const char* includePath = ".";
-
-    // GLSL has this annoying feature that the #version directive must appear first. But we 
-    // want to inject some #define shenanigans into the shader. 
-    // So to do that, we need to split for the part of the shader up to the end of the #version line,
-    // and everything after that. We can then inject our defines right there.
-    //auto strTuple = versionSplit(fileContents);
-    //std::string versionStr = std::get<0>(strTuple);
-    //std::string shaderContents = std::get<1>(strTuple);
-
-    const char* shaderStrings[] = {
-        // versionStr.c_str(),
-        // "\n",
-        // _shaderPrefix.c_str(),
-        // "\n",
-        fileContents.c_str()
-    };
+std::string ShaderVariantSource(const std::string& _filename, const std::string& _shaderPrefix)
+{
+    std::lock_guard<std::mutex> lock(shaderMutex);
+    PreprocessedShaderRef pSource = PreprocessShader(_filename);
+    std::string defines = SelectDefines(pSource.get(), _shaderPrefix);
+
+    char lineDirective[32];
+    const char* strings[4];
+    GLint lengths[4];
+    GLsizei count = SplitShaderSource(pSource.get(), defines, lineDirective, strings, lengths);
+
+    std::string retVal;
+    for (GLsizei i = 0; i < count; i++) {
+        retVal.append(strings[i], size_t(lengths[i]));
+    }
+    return retVal;
+}
 
-    glShaderSource(retVal, ArraySize(shaderStrings), shaderStrings, nullptr);
-    glCompileShader(retVal);
+::uint64 ShaderStageKey(GLenum _type, const std::string& _filename, const std::string& _shaderPrefix)
+{
+    std::lock_guard<std::mutex> lock(shaderMutex);
+    PreprocessedShaderRef pSource = PreprocessShader(_filename);
+    return ShaderVariantKey(_type, pSource.get(), SelectDefines(pSource.get(), _shaderPrefix));
+}
 
+// Blocks until the shader is compiled; logs the info log if there is one.
+static bool CheckShaderCompile(GLuint _shader, const std::string& _shaderName, const PreprocessedShader* _pSource)
+{
     GLint compileStatus = 0;
-    glGetShaderiv(retVal, GL_COMPILE_STATUS, &compileStatus);
+    glGetShaderiv(_shader, GL_COMPILE_STATUS, &compileStatus);
 
     GLint glinfoLogLength = 0;
-    glGetShaderiv(retVal, GL_INFO_LOG_LENGTH, &glinfoLogLength);
+    glGetShaderiv(_shader, GL_INFO_LOG_LENGTH, &glinfoLogLength);
     if (glinfoLogLength > 1) {
         GLchar* buffer = new GLchar[glinfoLogLength];
-        glGetShaderInfoLog(retVal, glinfoLogLength, &glinfoLogLength, buffer);
+        glGetShaderInfoLog(_shader, glinfoLogLength, &glinfoLogLength, buffer);
         if (compileStatus != GL_TRUE) {
-            warn("Shader Compilation failed for shader '%s', with the following errors:", _shaderFilename.c_str());
+            warn("Shader Compilation failed for shader '%s', with the following errors:", _shaderName.c_str());
         } else {
-            log("Shader Compilation succeeded for shader '%s', with the following log:", _shaderFilename.c_str());
+            log("Shader Compilation succeeded for shader '%s', with the following log:", _shaderName.c_str());
         }
 
-        log("%s", buffer);
+        log("%s", MapInfoLog(buffer, _pSource).c_str());
         delete[] buffer;
     }
 
-    if (compileStatus != GL_TRUE) {
-        glDeleteShader(retVal);
-        retVal = 0;
-    }
-
-    return retVal;
+    return compileStatus == GL_TRUE;
 }
 
-static GLuint LinkProgram(GLuint retVal)
+// Blocks until the program is linked; logs the info log if there is one.
+static bool CheckLinkStatus(GLuint _program)
 {
-    glLinkProgram(retVal);
-
     GLint linkStatus = 0;
-    glGetProgramiv(retVal, GL_LINK_STATUS, &linkStatus);
+    glGetProgramiv(_program, GL_LINK_STATUS, &linkStatus);
 
     GLint glinfoLogLength = 0;
-    glGetProgramiv(retVal, GL_INFO_LOG_LENGTH, &glinfoLogLength);
+    glGetProgramiv(_program, GL_INFO_LOG_LENGTH, &glinfoLogLength);
 
     if (glinfoLogLength > 1) {
         GLchar* buffer = new GLchar[glinfoLogLength];
-        glGetProgramInfoLog(retVal, glinfoLogLength, &glinfoLogLength, buffer);
+        glGetProgramInfoLog(_program, glinfoLogLength, &glinfoLogLength, buffer);
         if (linkStatus != GL_TRUE) {
             warn("Shader Linking failed with the following errors:");
         }
@@ -185,76 +533,268 @@ static GLuint LinkProgram(GLuint retVal)
         delete[] buffer;
     }
 
-    if (linkStatus != GL_TRUE) {
-        error("Shader failed linking, here's an assert to break you in the debugger.");
-        glDeleteProgram(retVal);
-        retVal = 0;
+    return linkStatus == GL_TRUE;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Called once per process: ask the driver for as many compiler threads as it likes.
+static bool UseParallelShaderCompile()
+{
+    static int parallel = -1;
+    if (parallel < 0) {
+        parallel = (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile) ? 1 : 0;
+        if (parallel) {
+            if (GLEW_KHR_parallel_shader_compile) {
+                glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            } else {
+                glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            }
+            GLint threads = 0;
+            glGetIntegerv(GL_MAX_SHADER_COMPILER_THREADS_KHR, &threads);
+            if (uint32(threads) == 0xFFFFFFFF) {
+                // The query returns the request as is: the driver picks its own maximum.
+                log("Parallel shader compile: driver maximum compiler threads");
+            } else {
+                log("Parallel shader compile: %u compiler threads", uint32(threads));
+            }
+        }
     }
+    return parallel != 0;
+}
 
-    return retVal;
+// Hot reload rebuilds a program from absolute paths: the working directory changes with
+// the scene. Programs with a string stage cannot be reloaded.
+static void TrackProgram(const ProgramBatchEntry& _entry)
+{
+    ProgramDesc desc;
+    desc.shaderPrefix = _entry.shaderPrefix;
+    std::vector<std::string> files;
+    for (size_t i = 0; i < _entry.count; i++) {
+        const std::vector<ShaderSourceRef>& sourceFiles = _entry.sources[i]->files;
+        if (sourceFiles.empty())
+            return;
+        desc.Stage(_entry.types[i], sourceFiles[0]->path);
+        for (size_t f = 0; f < sourceFiles.size(); f++) {
+            if (std::find(files.begin(), files.end(), sourceFiles[f]->path) == files.end())
+                files.push_back(sourceFiles[f]->path);
+        }
+    }
+    HotReloadTrackProgram(_entry.program, desc, files);
 }
 
-// --------------------------------------------------------------------------------------------------------------------
-static GLuint LinkVSFSShaders(GLuint _vs, GLuint _fs)
+// Everything the driver had to say about the program: compile logs of every stage not
+// checked before, then the link log. Compile errors give 0; link errors are fatal unless
+// _linkErrorsFatal is false.
+static void FinishBatchProgram(ProgramBatchEntry& _entry, ShaderVariantMap& _variants, bool _linkErrorsFatal)
 {
-    GLuint retVal = glCreateProgram();
-    glAttachShader(retVal, _vs);
-    glAttachShader(retVal, _fs);
+    bool compiled = true;
+    for (size_t i = 0; i < _entry.count; i++) {
+        ShaderVariant& variant = _variants[_entry.variantKeys[i]];
+        if (variant.status < 0) {
+            variant.status = CheckShaderCompile(variant.shader, _entry.filenames[i], _entry.sources[i].get()) ? 1 : 0;
+        }
+        if (variant.status == 0) {
+            compiled = false;
+        }
+    }
 
-    retVal = LinkProgram(retVal);
-    if (!retVal) {
-        error("VS&FS link failed.");
+    if (!compiled) {
+        glDeleteProgram(_entry.program);
+        _entry.program = 0;
+        return;
+    }
+    if (!CheckLinkStatus(_entry.program)) {
+        if (_linkErrorsFatal) {
+            error("Shader failed linking, here's an assert to break you in the debugger.");
+        }
+        glDeleteProgram(_entry.program);
+        _entry.program = 0;
+        return;
+    }
+    if (IsProgramCacheEnabled()) {
+        StoreCachedProgram(_entry.cacheKey, _entry.program);
     }
+    if (IsHotReloadEnabled()) {
+        TrackProgram(_entry);
+    }
+}
 
-    return retVal;
+// --------------------------------------------------------------------------------------------------------------------
+ProgramDesc& ProgramDesc::Stage(GLenum _type, const std::string& _filename)
+{
+    ShaderStageDesc stage = { _type, _filename, std::string() };
+    stages.push_back(stage);
+    return *this;
 }
 
-static GLuint LinkVSGSFSShaders(GLuint _vs, GLuint _gs, GLuint _fs)
+ProgramDesc& ProgramDesc::SourceStage(GLenum _type, const std::string& _source)
 {
-    GLuint retVal = glCreateProgram();
-    glAttachShader(retVal, _vs);
-    glAttachShader(retVal, _gs);
-    glAttachShader(retVal, _fs);
+    ShaderStageDesc stage = { _type, std::string(), _source };
+    stages.push_back(stage);
+    return *this;
+}
 
-    retVal = LinkProgram(retVal);
-    if (!retVal) {
-        error("VS&FS link failed.");
+void AddToProgramBatch(ProgramBatch& _batch, GLuint* _pProgram, const ProgramDesc& _desc)
+{
+    size_t count = _desc.stages.size();
+    if (count == 0 || count > MAX) {
+        error("AddToProgramBatch: %u stages, at most %u are supported.", uint32(count), uint32(MAX));
     }
 
-    return retVal;
+    std::lock_guard<std::mutex> lock(shaderMutex);
+    ProgramBatchEntry entry;
+    entry.pProgram = _pProgram;
+    entry.count = count;
+    entry.shaderPrefix = _desc.shaderPrefix;
+    entry.cacheKey = 0;
+    entry.program = 0;
+    for (size_t i = 0; i < count; i++) {
+        const ShaderStageDesc& stage = _desc.stages[i];
+        entry.types[i] = stage.type;
+        if (!stage.filename.empty()) {
+            entry.filenames[i] = stage.filename;
+            entry.sources[i] = PreprocessShader(stage.filename);
+        } else {
+            // Compile logs name string stages by position.
+            char name[32];
+            snprintf(name, sizeof(name), "<string %u>", uint32(i));
+            std::shared_ptr<PreprocessedShader> pString = std::make_shared<PreprocessedShader>();
+            pString->text = stage.source;
+            pString->data = pString->text.c_str();
+            pString->size = pString->text.size();
+            pString->hash = Fnv1a64(kFnv1a64Basis, pString->data, pString->size);
+            pString->names.assign(1, name);
+            entry.filenames[i] = name;
+            entry.sources[i] = pString;
+        }
+        entry.defines[i] = SelectDefines(entry.sources[i].get(), _desc.shaderPrefix);
+        entry.variantKeys[i] = ShaderVariantKey(stage.type, entry.sources[i].get(), entry.defines[i]);
+    }
+    _batch.programs.push_back(entry);
 }
 
-static GLuint LinkVSTessFSShaders(GLuint _vs, GLuint _tcs, GLuint _tes, GLuint _fs)
+void BuildProgramBatch(ProgramBatch& _batch)
 {
-    GLuint retVal = glCreateProgram();
-    glAttachShader(retVal, _vs);
-    glAttachShader(retVal, _tes);
-    glAttachShader(retVal, _tcs);
-    glAttachShader(retVal, _fs);
+    PROFILE_SCOPE("BuildProgramBatch");
+    std::lock_guard<std::mutex> lock(shaderMutex);
+    std::vector<ProgramBatchEntry>& programs = _batch.programs;
+    std::vector<bool> compiling(programs.size(), false);
+    size_t compilingCount = 0;
+
+    for (size_t p = 0; p < programs.size(); p++) {
+        ProgramBatchEntry& entry = programs[p];
+        if (IsProgramCacheEnabled()) {
+            entry.cacheKey = ProgramCacheKey(entry.variantKeys, entry.count);
+            entry.program = LoadCachedProgram(entry.cacheKey);
+            // Cache hits skip FinishBatchProgram but are reloaded from their files all the same.
+            if (entry.program && IsHotReloadEnabled()) {
+                TrackProgram(entry);
+            }
+        }
+        if (!entry.program) {
+            compiling[p] = true;
+            compilingCount++;
+        }
+    }
+
+    // Submit every compile, then every link, without a single status query in between: the
+    // driver may run them all on its compiler threads while we keep queueing.
+    ShaderVariantMap variants;
+    bool parallel = compilingCount > 0 && UseParallelShaderCompile();
+    {
+        PROFILE_SCOPE("SubmitShaders");
+        for (size_t p = 0; p < programs.size(); p++) {
+            if (!compiling[p])
+                continue;
+            ProgramBatchEntry& entry = programs[p];
+            for (size_t i = 0; i < entry.count; i++) {
+                ShaderVariant& variant = variants[entry.variantKeys[i]];
+                if (!variant.shader) {
+                    variant.shader = glCreateShader(entry.types[i]);
+                    variant.status = -1;
+                    SubmitShaderSource(variant.shader, entry.sources[i].get(), entry.defines[i]);
+                } else {
+                    debug("Shader variant of '%s' already compiled, sharing it", entry.filenames[i].c_str());
+                }
+            }
+        }
+        for (size_t p = 0; p < programs.size(); p++) {
+            if (!compiling[p])
+                continue;
+            ProgramBatchEntry& entry = programs[p];
+            entry.program = glCreateProgram();
+            if (IsProgramCacheEnabled()) {
+                glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+            for (size_t i = 0; i < entry.count; i++) {
+                glAttachShader(entry.program, variants[entry.variantKeys[i]].shader);
+            }
+            glLinkProgram(entry.program);
+        }
+    }
 
-    retVal = LinkProgram(retVal);
-    if (!retVal) {
-        error("VS&FS link failed.");
+    // Collect in completion order. Without the extension the first query simply blocks.
+    {
+        PROFILE_SCOPE("WaitForPrograms");
+        std::vector<bool> pending = compiling;
+        size_t pendingCount = compilingCount;
+        while (pendingCount > 0) {
+            bool progress = false;
+            for (size_t p = 0; p < programs.size(); p++) {
+                if (!pending[p])
+                    continue;
+                if (parallel) {
+                    GLint complete = GL_FALSE;
+                    glGetProgramiv(programs[p].program, GL_COMPLETION_STATUS_KHR, &complete);
+                    if (complete != GL_TRUE)
+                        continue;
+                }
+                FinishBatchProgram(programs[p], variants, _batch.linkErrorsFatal);
+                pending[p] = false;
+                pendingCount--;
+                progress = true;
+            }
+            if (!progress) {
+                std::this_thread::yield();
+            }
+        }
     }
 
-    return retVal;
+    // Linked programs keep their executables; the shader objects can go right away.
+    for (size_t p = 0; p < programs.size(); p++) {
+        if (!compiling[p] || !programs[p].program)
+            continue;
+        for (size_t i = 0; i < programs[p].count; i++) {
+            glDetachShader(programs[p].program, variants[programs[p].variantKeys[i]].shader);
+        }
+    }
+    for (ShaderVariantMap::iterator it = variants.begin(); it != variants.end(); ++it) {
+        glDeleteShader(it->second.shader);
+    }
+
+    for (size_t p = 0; p < programs.size(); p++) {
+        if (programs[p].pProgram) {
+            *programs[p].pProgram = programs[p].program;
+        }
+    }
+    programs.clear();
 }
 
-static GLuint LinkVSTessGSFSShaders(GLuint _vs, GLuint _tcs, GLuint _tes, GLuint _gs, GLuint _fs)
+void CreatePrograms(const ProgramDesc* _descs, size_t _count, GLuint* _programs)
 {
-    GLuint retVal = glCreateProgram();
-    glAttachShader(retVal, _vs);
-    glAttachShader(retVal, _tes);
-    glAttachShader(retVal, _gs);
-    glAttachShader(retVal, _tcs);
-    glAttachShader(retVal, _fs);
-
-    retVal = LinkProgram(retVal);
-    if (!retVal) {
-        error("VS&FS link failed.");
+    PROFILE_SCOPE("CreatePrograms");
+    ProgramBatch batch;
+    for (size_t i = 0; i < _count; i++) {
+        AddToProgramBatch(batch, &_programs[i], _descs[i]);
     }
+    BuildProgramBatch(batch);
+}
 
-    return retVal;
+GLuint CreateProgram(const ProgramDesc& _desc)
+{
+    GLuint retProgram = 0;
+    CreatePrograms(&_desc, 1, &retProgram);
+    return retProgram;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -266,117 +806,60 @@ GLuint CreateProgram(const std::string& _vsFilename, const std::string& _psFilen
 // --------------------------------------------------------------------------------------------------------------------
 GLuint CreateProgram(const std::string& _vsFilename, const std::string& _psFilename, const std::string& _shaderPrefix)
 {
-    GLuint vs = CompileShaderFromFile(GL_VERTEX_SHADER, _vsFilename, _shaderPrefix),
-           fs = CompileShaderFromFile(GL_FRAGMENT_SHADER, _psFilename, _shaderPrefix);
-
-    // If any are 0, dump out early.
-    if ((vs * fs) == 0) {
-        return 0;
-    }
-
-    GLuint retProgram = LinkVSFSShaders(vs, fs);
-
-    glDeleteShader(fs);
-    glDeleteShader(vs);
-
-    return retProgram;
+    PROFILE_SCOPE("CreateProgram");
+    ProgramDesc desc;
+    desc.Stage(GL_VERTEX_SHADER, _vsFilename).Stage(GL_FRAGMENT_SHADER, _psFilename);
+    desc.shaderPrefix = _shaderPrefix;
+    return CreateProgram(desc);
 }
 
-GLuint CreateVSGSFSProgram(const std::string& _vsFilename, const std::string& _gsFilename, const std::string& _psFilename)
+GLuint CreateVSGSFSProgram(const std::string& _vsFilename, const std::string& _gsFilename, const std::string& _psFilename,
+                           const std::string& _shaderPrefix)
 {
-    std::string _shaderPrefix = "";
-    GLuint vs = CompileShaderFromFile(GL_VERTEX_SHADER, _vsFilename, _shaderPrefix),
-           gs = CompileShaderFromFile(GL_GEOMETRY_SHADER, _gsFilename, _shaderPrefix),
-           fs = CompileShaderFromFile(GL_FRAGMENT_SHADER, _psFilename, _shaderPrefix);
-
-    // If any are 0, dump out early.
-    if ((vs * gs * fs) == 0)
-    {
-        return 0;
-    }
-
-    GLuint retProgram = LinkVSGSFSShaders(vs, gs, fs);
-
-    glDeleteShader(fs);
-    glDeleteShader(gs);
-    glDeleteShader(vs);
-
-    return retProgram;
+    PROFILE_SCOPE("CreateVSGSFSProgram");
+    ProgramDesc desc;
+    desc.Stage(GL_VERTEX_SHADER, _vsFilename).Stage(GL_GEOMETRY_SHADER, _gsFilename).Stage(GL_FRAGMENT_SHADER, _psFilename);
+    desc.shaderPrefix = _shaderPrefix;
+    return CreateProgram(desc);
 }
 
 
 GLuint CreateVSTessFSProgram(const std::string& _vsFilename, const std::string& _tcsFilename,
-                            const std::string& _tesFilename, const std::string& _psFilename)
+                            const std::string& _tesFilename, const std::string& _psFilename,
+                            const std::string& _shaderPrefix)
 {
-    std::string _shaderPrefix = "";
-    GLuint vs = CompileShaderFromFile(GL_VERTEX_SHADER, _vsFilename, _shaderPrefix),
-           tcs = CompileShaderFromFile(GL_TESS_CONTROL_SHADER, _tcsFilename, _shaderPrefix),
-           tes = CompileShaderFromFile(GL_TESS_EVALUATION_SHADER, _tesFilename, _shaderPrefix),
-           fs = CompileShaderFromFile(GL_FRAGMENT_SHADER, _psFilename, _shaderPrefix);
-
-    // If any are 0, dump out early.
-    if ((vs * tcs * tes * fs) == 0) {
-        return 0;
-    }
-
-    GLuint retProgram = LinkVSTessFSShaders(vs, tcs, tes, fs);
-
-    glDeleteShader(fs);
-    glDeleteShader(tes);
-    glDeleteShader(tcs);
-    glDeleteShader(vs);
-
-    return retProgram;
+    PROFILE_SCOPE("CreateVSTessFSProgram");
+    ProgramDesc desc;
+    desc.Stage(GL_VERTEX_SHADER, _vsFilename).Stage(GL_TESS_CONTROL_SHADER, _tcsFilename)
+        .Stage(GL_TESS_EVALUATION_SHADER, _tesFilename).Stage(GL_FRAGMENT_SHADER, _psFilename);
+    desc.shaderPrefix = _shaderPrefix;
+    return CreateProgram(desc);
 }
 
 
 GLuint CreateVSTessGSFSProgram(const std::string& _vsFilename, const std::string& _tcsFilename, const std::string& _tesFilename,
-                               const std::string& _gsFilename, const std::string& _psFilename)
+                               const std::string& _gsFilename, const std::string& _psFilename,
+                               const std::string& _shaderPrefix)
 {
-    std::string _shaderPrefix = "";
-    GLuint vs = CompileShaderFromFile(GL_VERTEX_SHADER, _vsFilename, _shaderPrefix),
-           tcs = CompileShaderFromFile(GL_TESS_CONTROL_SHADER, _tcsFilename, _shaderPrefix),
-           tes = CompileShaderFromFile(GL_TESS_EVALUATION_SHADER, _tesFilename, _shaderPrefix),
-           gs = CompileShaderFromFile(GL_GEOMETRY_SHADER, _gsFilename, _shaderPrefix),
-           fs = CompileShaderFromFile(GL_FRAGMENT_SHADER, _psFilename, _shaderPrefix);
-
-    // If any are 0, dump out early.
-    if ((vs * tcs * tes * gs * fs) == 0) {
-        return 0;
-    }
-
-    GLuint retProgram = LinkVSTessGSFSShaders(vs, tcs, tes, gs, fs);
-
-    glDeleteShader(fs);
-    glDeleteShader(gs);
-    glDeleteShader(tes);
-    glDeleteShader(tcs);
-    glDeleteShader(vs);
-
-    return retProgram;
+    PROFILE_SCOPE("CreateVSTessGSFSProgram");
+    ProgramDesc desc;
+    desc.Stage(GL_VERTEX_SHADER, _vsFilename).Stage(GL_TESS_CONTROL_SHADER, _tcsFilename)
+        .Stage(GL_TESS_EVALUATION_SHADER, _tesFilename).Stage(GL_GEOMETRY_SHADER, _gsFilename)
+        .Stage(GL_FRAGMENT_SHADER, _psFilename);
+    desc.shaderPrefix = _shaderPrefix;
+    return CreateProgram(desc);
 }
 
 GLuint CreateProgramFromStrings(GLenum *pShaderType, std::string *pStr, GLuint count)
 {
+    PROFILE_SCOPE("CreateProgramFromStrings");
     // VS, TCS, TES, GS, FS. Or CS
-    GLuint shaderId[6] = { 0 };
-    if (count >= 6)
-    {
-        return -1;
-    }
-
-    GLuint retVal = glCreateProgram();
+    ProgramDesc desc;
     for (GLuint i = 0; i < count; i++)
     {
-        shaderId[i] = CompileShaderFromString(pShaderType[i], pStr[i]);
-        glAttachShader(retVal, shaderId[i]);
+        desc.SourceStage(pShaderType[i], pStr[i]);
     }
-
-    retVal = LinkProgram(retVal);
-    if (!retVal) {
-        error("VS&FS link failed.");
-    }
-    return retVal;
+    return CreateProgram(desc);
 }
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path)
@@ -387,6 +870,7 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 
 bool ValidateProgramPipeline(GLuint pipelineName)
 {
+    PROFILE_SCOPE("ValidateProgramPipeline");
     GLint Status(0);
     glValidateProgramPipeline(pipelineName);
     glGetProgramPipelineiv(pipelineName, GL_VALIDATE_STATUS, &Status);
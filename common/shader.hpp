@@ -1,11 +1,15 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <memory>
 #include <string>
+#include <vector>
 using namespace std;
 
 #include <GL/glew.h>
 
+#include "main.h"
+
 enum type
 {
 	VERTEX,
@@ -16,16 +20,87 @@ enum type
 	MAX
 };
 
+struct PreprocessedShader;
+typedef std::shared_ptr<const PreprocessedShader> PreprocessedShaderRef;
+
+/// One stage of a ProgramDesc: the file filename, or source when filename is empty.
+struct ShaderStageDesc
+{
+	GLenum		type;
+	std::string	filename;
+	std::string	source;				///< no #include resolution, not hot reloaded
+};
+
+/// Any set of stages (VS/TCS/TES/GS/FS, or CS) making one program:
+///   ProgramDesc desc;
+///   desc.Stage(GL_VERTEX_SHADER, "VS.vert").Stage(GL_FRAGMENT_SHADER, "FS.frag");
+struct ProgramDesc
+{
+	std::vector<ShaderStageDesc> stages;
+	std::string	shaderPrefix;		///< #define lines, each stage gets those it uses
+
+	ProgramDesc& Stage(GLenum _type, const std::string& _filename);
+	ProgramDesc& SourceStage(GLenum _type, const std::string& _source);
+};
+
+/// One program of a ProgramBatch; filled in by AddToProgramBatch().
+struct ProgramBatchEntry
+{
+	GLuint*		pProgram;			///< receives the program, 0 if a stage failed to compile
+	size_t		count;
+	GLenum		types[MAX];
+	std::string	filenames[MAX];
+	PreprocessedShaderRef sources[MAX];	///< #include expanded; keeps the files mapped until the batch is built
+	std::string	defines[MAX];		///< lines of the shader prefix each stage uses
+	std::string	shaderPrefix;
+	::uint64	variantKeys[MAX];
+	::uint64	cacheKey;
+	GLuint		program;
+};
+
+/// Programs built together: BuildProgramBatch() submits every stage of every program and
+/// every link before it queries any status, then collects the programs as the driver
+/// finishes them (GL_COMPLETION_STATUS_KHR with KHR/ARB_parallel_shader_compile). A stage
+/// several programs of the batch use with the same defines is compiled once and attached
+/// to each; it is not kept for later batches.
+struct ProgramBatch
+{
+	std::vector<ProgramBatchEntry> programs;
+	bool		linkErrorsFatal;	///< false: a program that fails to link gives 0 like a compile error
+
+	ProgramBatch() : linkErrorsFatal(true) {}
+};
+
+/// Queue the program _desc describes; its files are mapped right away.
+void AddToProgramBatch(ProgramBatch& _batch, GLuint* _pProgram, const ProgramDesc& _desc);
+/// Compile and link everything queued and store the results; empties the batch.
+void BuildProgramBatch(ProgramBatch& _batch);
+
+/// Build _count programs as one batch into _programs; 0 for a program with a stage that
+/// failed to compile.
+void CreatePrograms(const ProgramDesc* _descs, size_t _count, GLuint* _programs);
+/// A batch of one; the CreateProgram family below builds its ProgramDesc.
+GLuint CreateProgram(const ProgramDesc& _desc);
+
 GLuint CreateProgram(const string& _vsFilename, const string& _psFilename);
 GLuint CreateProgram(const string& _vsFilename, const string& _psFilename, const string& _shaderPrefix);
 GLuint CreateVSTessGSFSProgram(const std::string& _vsFilename, const std::string& _tcsFilename, const std::string& _tesFilename,
-                               const std::string& _gsFilename, const std::string& _psFilename);
+                               const std::string& _gsFilename, const std::string& _psFilename,
+                               const std::string& _shaderPrefix = std::string());
 GLuint CreateVSTessFSProgram(const std::string& _vsFilename, const std::string& _tcsFilename,
-                            const std::string& _tesFilename, const std::string& _psFilename);
-GLuint CreateVSGSFSProgram(const std::string& _vsFilename, const std::string& _gsFilename, const std::string& _psFilename);
+                            const std::string& _tesFilename, const std::string& _psFilename,
+                            const std::string& _shaderPrefix = std::string());
+GLuint CreateVSGSFSProgram(const std::string& _vsFilename, const std::string& _gsFilename, const std::string& _psFilename,
+                           const std::string& _shaderPrefix = std::string());
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 GLuint CreateProgramFromStrings(GLenum* pShaderType, std::string* pStr, GLuint count);
-std::string FileContentsToString(std::string _filename);
+std::string FileContentsToString(const std::string& _filename);
+/// _filename as the variant for _shaderPrefix compiles it (see CreateProgram), for
+/// glCreateShaderProgramv and other calls that take plain strings.
+std::string ShaderVariantSource(const std::string& _filename, const std::string& _shaderPrefix);
+/// Key of the _type stage compiled from ShaderVariantSource(): hashes the type, the contents
+/// of the file and its #include files and the defines it uses, without building the source.
+::uint64 ShaderStageKey(GLenum _type, const std::string& _filename, const std::string& _shaderPrefix);
 bool CheckProgram(GLuint ProgramName);
 bool ValidateProgramPipeline(GLuint pipelineName);
 
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "shader_source.h"
+#include "profiler.h"
+#include "hash.h"
+
+struct MappedSource : ShaderSource
+{
+    std::string     fullPath;
+    uint64          fileSize;
+    uint64          modified;   ///< platform timestamp, only compared for equality
+    std::string     copy;       ///< the contents when the mapping could not be read
+    bool            mapped;
+#ifdef _WIN32
+    HANDLE          mapping;
+#endif
+
+    MappedSource() : mapped(false) {}
+    ~MappedSource();
+};
+
+/// The current mapping of every file loaded so far.
+static std::unordered_map<std::string, std::shared_ptr<MappedSource> > sources;
+
+// ----------------------------------------------------------------------------------------------------------------
+static bool GetFullPath(const std::string& _filename, char* _fullPath, size_t _size)
+{
+#ifdef _WIN32
+    return _fullpath(_fullPath, _filename.c_str(), _size) != NULL;
+#else
+    char resolved[PATH_MAX];
+    if (!realpath(_filename.c_str(), resolved))
+        return false;
+    strncpy(_fullPath, resolved, _size - 1);
+    _fullPath[_size - 1] = '\0';
+    return true;
+#endif
+}
+
+static bool GetFileStamp(const char* _path, uint64& _size, uint64& _modified)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(_path, GetFileExInfoStandard, &attributes))
+        return false;
+    _size = (uint64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    _modified = (uint64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat info;
+    if (stat(_path, &info) != 0)
+        return false;
+    _size = uint64(info.st_size);
+    _modified = uint64(info.st_mtim.tv_sec) * 1000000000ull + uint64(info.st_mtim.tv_nsec);
+#endif
+    return true;
+}
+
+static void Unmap(MappedSource& _mapped)
+{
+    if (!_mapped.mapped)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(_mapped.data);
+    CloseHandle(_mapped.mapping);
+    _mapped.mapping = NULL;
+#else
+    munmap((void*)_mapped.data, _mapped.size);
+#endif
+    _mapped.mapped = false;
+    _mapped.data = "";
+    _mapped.size = 0;
+}
+
+MappedSource::~MappedSource()
+{
+    Unmap(*this);
+}
+
+#ifdef _WIN32
+// Windows refuses to truncate a file that is mapped.
+static bool HashMapping(MappedSource& _mapped)
+{
+    _mapped.hash = Fnv1a64(kFnv1a64Basis, _mapped.data, _mapped.size);
+    return true;
+}
+#else
+// Reading a mapping past the end of a file truncated in place raises SIGBUS. Hashing reads
+// all of it, right after mapping, so a file cut while it was being mapped faults there:
+// the handler jumps back out and the file is read instead.
+static thread_local sigjmp_buf* pBusGuard = NULL;
+
+static void HandleBusError(int _signal)
+{
+    if (pBusGuard)
+        siglongjmp(*pBusGuard, 1);
+    signal(_signal, SIG_DFL);   // not a guarded read: fault again and crash as usual
+}
+
+static bool HashMapping(MappedSource& _mapped)
+{
+    struct sigaction action, previous;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = HandleBusError;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, &previous);
+
+    sigjmp_buf guard;
+    volatile bool complete = false;
+    if (sigsetjmp(guard, 1) == 0)
+    {
+        pBusGuard = &guard;
+        _mapped.hash = Fnv1a64(kFnv1a64Basis, _mapped.data, _mapped.size);
+        complete = true;
+    }
+    pBusGuard = NULL;
+    sigaction(SIGBUS, &previous, NULL);
+    return complete;
+}
+#endif
+
+static bool ReadCopy(MappedSource& _mapped)
+{
+    FILE* file = 0;
+    fopen_s(&file, _mapped.fullPath.c_str(), "rb");
+    if (!file)
+        return false;
+    char buffer[4096];
+    size_t read;
+    _mapped.copy.clear();
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        _mapped.copy.append(buffer, read);
+    }
+    fclose(file);
+    _mapped.data = _mapped.copy.c_str();
+    _mapped.size = _mapped.copy.size();
+    _mapped.hash = Fnv1a64(kFnv1a64Basis, _mapped.data, _mapped.size);
+    return true;
+}
+
+// Empty files are not mapped; they point at a static "".
+static bool Map(MappedSource& _mapped)
+{
+    PROFILE_SCOPE("MapShaderSource");
+    _mapped.data = "";
+    _mapped.size = 0;
+    _mapped.path = _mapped.fullPath.c_str();
+    if (_mapped.fileSize > 0)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(_mapped.fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        _mapped.mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file);
+        if (!_mapped.mapping)
+            return false;
+        void* view = MapViewOfFile(_mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+        {
+            CloseHandle(_mapped.mapping);
+            _mapped.mapping = NULL;
+            return false;
+        }
+#else
+        int fd = open(_mapped.fullPath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        void* view = mmap(NULL, size_t(_mapped.fileSize), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED)
+            return false;
+#endif
+        _mapped.data = (const char*)view;
+        _mapped.size = size_t(_mapped.fileSize);
+        _mapped.mapped = true;
+    }
+    if (HashMapping(_mapped))
+        return true;
+
+    warn("Shader source '%s' was truncated while it was mapped, reading it instead", _mapped.path);
+    Unmap(_mapped);
+    return ReadCopy(_mapped);
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+ShaderSourceRef LoadShaderSource(const std::string& _filename)
+{
+    char fullPath[4096];
+    uint64 size = 0, modified = 0;
+    if (!GetFullPath(_filename, fullPath, sizeof(fullPath)) || !GetFileStamp(fullPath, size, modified))
+    {
+        error("Unable to locate file '%s'", _filename.c_str());
+    }
+
+    std::shared_ptr<MappedSource>& pCurrent = sources[fullPath];
+    if (pCurrent)
+    {
+        if (pCurrent->fileSize == size && pCurrent->modified == modified)
+            return pCurrent;
+
+        // Holders of the old mapping keep it until they let go of it.
+        debug("Shader source '%s' changed on disk, mapping it again", fullPath);
+    }
+
+    std::shared_ptr<MappedSource> pMapped = std::make_shared<MappedSource>();
+    pMapped->fullPath = fullPath;
+    pMapped->fileSize = size;
+    pMapped->modified = modified;
+    if (!Map(*pMapped))
+    {
+        error("Unable to map file '%s'", fullPath);
+    }
+    pCurrent = pMapped;
+    return pCurrent;
+}
@@ -0,0 +1,32 @@
+#ifndef _SHADER_SOURCE_H_
+#define _SHADER_SOURCE_H_
+
+#include <memory>
+#include <string>
+
+#include "main.h"
+
+// Read-only, memory-mapped shader sources shared by the whole process. A file is mapped
+// the first time it is loaded and handed out as a pointer/length pair that goes straight
+// to glShaderSource; later loads of the same file (by absolute path, so equally named
+// files of different scenes stay apart) only stat it and return the same mapping. A file
+// whose size or modification time changed is mapped again into a new ShaderSource; the
+// old mapping is unmapped once the last reference to it is dropped, so a program batch
+// holding it keeps reading valid memory.
+
+struct ShaderSource
+{
+    const char* data;           ///< not NUL-terminated
+    size_t      size;
+    uint64      hash;           ///< FNV-1a of the contents
+    const char* path;           ///< absolute path
+};
+
+typedef std::shared_ptr<const ShaderSource> ShaderSourceRef;
+
+/// The mapped file; error() if it does not exist. A file truncated in place while it is
+/// being mapped is read into memory instead. Not thread safe; shader.cpp serializes its
+/// calls.
+ShaderSourceRef LoadShaderSource(const std::string& _filename);
+
+#endif
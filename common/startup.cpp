@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "startup.h"
+#include "benchmark.h"
+#include "profiler.h"
+
+struct StartupPhase
+{
+    const char* name;
+    uint64      beginNs;
+    uint64      endNs;
+    char        note[64];
+};
+
+static StartupPhase phases[kStartupMaxPhases];
+static uint32 phaseCount = 0;
+static bool phaseOpen = false;
+
+// ----------------------------------------------------------------------------------------------------------------
+void StartupPhaseBegin(const char* _name)
+{
+    if (phaseOpen)
+        StartupPhaseEnd();
+    if (phaseCount >= kStartupMaxPhases)
+        return;
+
+    StartupPhase& phase = phases[phaseCount];
+    phase.name = _name;
+    phase.note[0] = '\0';
+    phase.beginNs = GetTimeNs();
+    phase.endNs = phase.beginNs;
+    phaseOpen = true;
+    ProfilerBeginEvent(_name);
+}
+
+void StartupPhaseEnd(const char* _note)
+{
+    if (!phaseOpen)
+        return;
+
+    StartupPhase& phase = phases[phaseCount++];
+    phase.endNs = GetTimeNs();
+    if (_note)
+    {
+        strncpy(phase.note, _note, sizeof(phase.note) - 1);
+        phase.note[sizeof(phase.note) - 1] = '\0';
+    }
+    phaseOpen = false;
+    ProfilerEndEvent();
+}
+
+void PrintStartupReport()
+{
+    if (phaseOpen)
+        StartupPhaseEnd();
+    if (phaseCount == 0)
+        return;
+
+    log("Startup time:");
+    for (uint32 i = 0; i < phaseCount; i++)
+    {
+        const StartupPhase& phase = phases[i];
+        log("  %-20s %9.3f ms%s%s", phase.name, float64(phase.endNs - phase.beginNs) * 1e-6,
+            phase.note[0] ? "  " : "", phase.note);
+    }
+    log("  %-20s %9.3f ms", "total", float64(phases[phaseCount - 1].endNs - phases[0].beginNs) * 1e-6);
+}
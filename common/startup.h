@@ -0,0 +1,20 @@
+#ifndef _STARTUP_H_
+#define _STARTUP_H_
+
+#include "main.h"
+
+// Wall-clock breakdown of the window-system startup (display, config selection,
+// window, context). Always collected, it is only a few clock reads, and printed
+// once the context is current. Every phase is also a --trace event.
+
+static const uint32 kStartupMaxPhases = 16;
+
+/// Phases do not nest; _name must be a string literal.
+void StartupPhaseBegin(const char* _name);
+
+/// _note is printed next to the phase time, e.g. "cached"; copied.
+void StartupPhaseEnd(const char* _note = NULL);
+
+void PrintStartupReport();
+
+#endif
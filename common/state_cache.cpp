@@ -0,0 +1,275 @@
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#include "state_cache.h"
+#include "harness.h"
+#include "gl_record.h"
+
+enum StateCategory
+{
+    STATE_PROGRAM,
+    STATE_PIPELINE,
+    STATE_VERTEX_ARRAY,
+    STATE_BUFFER,
+    STATE_TEXTURE,
+    STATE_ENABLE,
+    STATE_ATTRIB_ARRAY,
+    STATE_POLYGON_MODE,
+    STATE_CATEGORIES
+};
+
+static const char* categoryNames[STATE_CATEGORIES] =
+{
+    "program", "pipeline", "vertex array", "buffer", "texture", "enable", "attrib array", "polygon mode"
+};
+
+// Value of a binding the shadow does not know; no GL name or enum is ~0.
+static const GLuint kUnknown = ~0u;
+
+struct VertexArrayState
+{
+    GLuint  elementBuffer;
+    uint32  knownArrays;            ///< attribute arrays whose enable is known, bit per index
+    uint32  enabledArrays;
+};
+
+static GLuint program = kUnknown;
+static GLuint pipeline = kUnknown;
+static GLuint vertexArray = kUnknown;
+static GLuint activeUnit = kUnknown;
+static GLenum polygonMode = kUnknown;
+// Node based, so the pointer to the bound vertex array survives inserting others.
+static std::unordered_map<GLuint, VertexArrayState> vertexArrays;
+static VertexArrayState* pVertexArray = NULL;
+static std::unordered_map<GLenum, GLuint> buffers;
+static std::unordered_map<uint64, GLuint> indexedBuffers;      ///< target << 32 | index
+static std::unordered_map<uint64, GLuint> textures;            ///< unit << 32 | target
+static std::unordered_map<GLenum, bool> caps;
+
+static bool inFrame = false;
+static uint32 frames = 0;
+static uint64 calls[STATE_CATEGORIES];
+static uint64 skipped[STATE_CATEGORIES];
+
+// Count a call made during a frame; true if it is redundant and may be dropped.
+static bool Skip(StateCategory _category, bool _redundant)
+{
+    if (inFrame)
+    {
+        calls[_category]++;
+        if (_redundant)
+            skipped[_category]++;
+    }
+    return _redundant && !g_harnessOptions.noStateCache;
+}
+
+static GLuint Lookup(const std::unordered_map<uint64, GLuint>& _bindings, uint64 _key)
+{
+    std::unordered_map<uint64, GLuint>::const_iterator it = _bindings.find(_key);
+    return it != _bindings.end() ? it->second : kUnknown;
+}
+
+static void SetCap(GLenum _cap, bool _enabled)
+{
+    std::unordered_map<GLenum, bool>::const_iterator it = caps.find(_cap);
+    if (Skip(STATE_ENABLE, it != caps.end() && it->second == _enabled))
+        return;
+
+    if (_enabled)
+        glEnable(_cap);
+    else
+        glDisable(_cap);
+    caps[_cap] = _enabled;
+}
+
+static void SetAttribArray(GLuint _index, bool _enabled)
+{
+    uint32 bit = _index < 32 ? 1u << _index : 0u;
+    bool redundant = pVertexArray && (pVertexArray->knownArrays & bit) &&
+                     ((pVertexArray->enabledArrays & bit) != 0) == _enabled;
+    if (Skip(STATE_ATTRIB_ARRAY, redundant))
+        return;
+
+    if (_enabled)
+        glEnableVertexAttribArray(_index);
+    else
+        glDisableVertexAttribArray(_index);
+    if (pVertexArray)
+    {
+        pVertexArray->knownArrays |= bit;
+        pVertexArray->enabledArrays = _enabled ? pVertexArray->enabledArrays | bit : pVertexArray->enabledArrays & ~bit;
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------------------
+void StateUseProgram(GLuint _program)
+{
+    if (Skip(STATE_PROGRAM, program == _program))
+        return;
+    glUseProgram(_program);
+    program = _program;
+}
+
+void StateBindProgramPipeline(GLuint _pipeline)
+{
+    if (Skip(STATE_PIPELINE, pipeline == _pipeline))
+        return;
+    glBindProgramPipeline(_pipeline);
+    pipeline = _pipeline;
+}
+
+void StateBindVertexArray(GLuint _vertexArray)
+{
+    if (Skip(STATE_VERTEX_ARRAY, vertexArray == _vertexArray))
+        return;
+    glBindVertexArray(_vertexArray);
+    vertexArray = _vertexArray;
+
+    // A vertex array first seen here may have been set up with raw calls.
+    std::unordered_map<GLuint, VertexArrayState>::iterator it = vertexArrays.find(_vertexArray);
+    if (it == vertexArrays.end())
+    {
+        VertexArrayState state = { kUnknown, 0, 0 };
+        it = vertexArrays.insert(std::make_pair(_vertexArray, state)).first;
+    }
+    pVertexArray = &it->second;
+}
+
+void StateBindBuffer(GLenum _target, GLuint _buffer)
+{
+    if (_target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        if (Skip(STATE_BUFFER, pVertexArray && pVertexArray->elementBuffer == _buffer))
+            return;
+        glBindBuffer(_target, _buffer);
+        if (pVertexArray)
+            pVertexArray->elementBuffer = _buffer;
+        return;
+    }
+
+    std::unordered_map<GLenum, GLuint>::const_iterator it = buffers.find(_target);
+    if (Skip(STATE_BUFFER, it != buffers.end() && it->second == _buffer))
+        return;
+    glBindBuffer(_target, _buffer);
+    buffers[_target] = _buffer;
+}
+
+void StateBindBufferBase(GLenum _target, GLuint _index, GLuint _buffer)
+{
+    uint64 key = (uint64(_target) << 32) | _index;
+    std::unordered_map<GLenum, GLuint>::const_iterator it = buffers.find(_target);
+    bool redundant = Lookup(indexedBuffers, key) == _buffer && it != buffers.end() && it->second == _buffer;
+    if (Skip(STATE_BUFFER, redundant))
+        return;
+    glBindBufferBase(_target, _index, _buffer);
+    indexedBuffers[key] = _buffer;
+    buffers[_target] = _buffer;
+}
+
+void StateBindTexture(GLuint _unit, GLenum _target, GLuint _texture)
+{
+    uint64 key = (uint64(_unit) << 32) | _target;
+    if (Skip(STATE_TEXTURE, Lookup(textures, key) == _texture))
+        return;
+    if (activeUnit != _unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + _unit);
+        activeUnit = _unit;
+    }
+    glBindTexture(_target, _texture);
+    textures[key] = _texture;
+}
+
+void StateEnable(GLenum _cap)
+{
+    SetCap(_cap, true);
+}
+
+void StateDisable(GLenum _cap)
+{
+    SetCap(_cap, false);
+}
+
+void StateEnableVertexAttribArray(GLuint _index)
+{
+    SetAttribArray(_index, true);
+}
+
+void StateDisableVertexAttribArray(GLuint _index)
+{
+    SetAttribArray(_index, false);
+}
+
+void StatePolygonMode(GLenum _mode)
+{
+    if (Skip(STATE_POLYGON_MODE, polygonMode == _mode))
+        return;
+    glPolygonMode(GL_FRONT_AND_BACK, _mode);
+    polygonMode = _mode;
+}
+
+void StateCacheInvalidate()
+{
+    program = pipeline = vertexArray = activeUnit = kUnknown;
+    polygonMode = kUnknown;
+    vertexArrays.clear();
+    pVertexArray = NULL;
+    buffers.clear();
+    indexedBuffers.clear();
+    textures.clear();
+    caps.clear();
+}
+
+void StateCacheBeginFrame()
+{
+    inFrame = true;
+}
+
+void StateCacheEndFrame()
+{
+    inFrame = false;
+    frames++;
+}
+
+StateCacheSummary StateCacheSummarize()
+{
+    StateCacheSummary summary = { frames, 0.0, 0.0 };
+    if (frames)
+    {
+        for (int i = 0; i < STATE_CATEGORIES; i++)
+        {
+            summary.callsPerFrame += float64(calls[i]) / frames;
+            summary.skippedPerFrame += float64(skipped[i]) / frames;
+        }
+    }
+    return summary;
+}
+
+void StateCacheEndScene()
+{
+    StateCacheSummary summary = StateCacheSummarize();
+    if (summary.callsPerFrame > 0.0)
+    {
+        std::string perCategory;
+        for (int i = 0; i < STATE_CATEGORIES; i++)
+        {
+            if (!skipped[i])
+                continue;
+            char text[64];
+            snprintf(text, sizeof(text), "%s%s %.1f", perCategory.empty() ? "" : ", ", categoryNames[i],
+                     float64(skipped[i]) / frames);
+            perCategory += text;
+        }
+        log("State cache: %.1f of %.1f calls per frame redundant%s%s%s", summary.skippedPerFrame,
+            summary.callsPerFrame, perCategory.empty() ? "" : " (", perCategory.c_str(), perCategory.empty() ? "" : ")");
+        if (g_harnessOptions.noStateCache)
+            log("  --no-state-cache: redundant calls were made anyway");
+    }
+
+    StateCacheInvalidate();
+    inFrame = false;
+    frames = 0;
+    memset(calls, 0, sizeof(calls));
+    memset(skipped, 0, sizeof(skipped));
+}
@@ -0,0 +1,54 @@
+#ifndef _STATE_CACHE_H_
+#define _STATE_CACHE_H_
+
+#include <GL/glew.h>
+
+#include "main.h"
+
+// Shadow of the GL state scenes set every frame: the program, the program pipeline, the
+// vertex array, generic and indexed buffer bindings, the texture of every unit, enables,
+// the polygon mode, and per vertex array its element buffer and enabled attribute arrays.
+// The State*() calls drop a call that would set what is already set and count it, per
+// category and frame. The shadow starts unknown, so the first call of each kind always
+// reaches GL. Code that changes shadowed state with raw GL calls, or deletes a bound
+// object and reuses its name, must call StateCacheInvalidate() afterwards.
+// With --no-state-cache every call reaches GL, and redundant calls are still counted, so
+// the two runs compare the cost of the redundant calls.
+
+void StateUseProgram(GLuint _program);
+void StateBindProgramPipeline(GLuint _pipeline);
+void StateBindVertexArray(GLuint _vertexArray);
+/// GL_ELEMENT_ARRAY_BUFFER is kept per vertex array, like GL does.
+void StateBindBuffer(GLenum _target, GLuint _buffer);
+/// Also sets the generic _target binding, like GL does.
+void StateBindBufferBase(GLenum _target, GLuint _index, GLuint _buffer);
+/// Selects _unit with glActiveTexture only when the texture changes.
+void StateBindTexture(GLuint _unit, GLenum _target, GLuint _texture);
+void StateEnable(GLenum _cap);
+void StateDisable(GLenum _cap);
+/// Of the bound vertex array.
+void StateEnableVertexAttribArray(GLuint _index);
+void StateDisableVertexAttribArray(GLuint _index);
+/// GL_FRONT_AND_BACK, the only face a core profile accepts.
+void StatePolygonMode(GLenum _mode);
+
+/// Forget everything; the next call of each kind reaches GL.
+void StateCacheInvalidate();
+
+/// Calls and skipped calls per frame of the scene so far.
+struct StateCacheSummary
+{
+    uint32  frames;
+    float64 callsPerFrame;
+    float64 skippedPerFrame;
+};
+
+/// The harness brackets every frame with these.
+void StateCacheBeginFrame();
+void StateCacheEndFrame();
+
+StateCacheSummary StateCacheSummarize();
+/// Log the scene's skipped calls per category, then reset the counters and the shadow.
+void StateCacheEndScene();
+
+#endif
@@ -4,6 +4,10 @@
 
 #include <common/shader.hpp>
 #include <common/main.h>
+#include <common/scene.h>
+#include <common/state_cache.h>
+
+namespace test1_red_triangle {
 
 GLuint vertexbuffer;
 GLuint VertexArrayID;
@@ -16,25 +20,11 @@ void ProcessCommandLine(int argc, char* argv[])
 
 bool InitGL(size_t Width, size_t Height)
 {
-    // Initialize GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK)
-    {
-        error("Failed to initialize GLEW\n");
-        return false;
-    }
-
-    const char* versionGL = "\0";
-    versionGL = (char*)(glGetString(GL_VERSION));
-    log("OpenGL version: %s\n", versionGL);
-    log("GLEW version: %d.%d.%d.%d\n",  GLEW_VERSION, GLEW_VERSION_MAJOR,
-                                        GLEW_VERSION_MINOR, GLEW_VERSION_MICRO);
-
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
     glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
 
     // Create and compile our GLSL program from the shaders
     programID = LoadShaders( "SimpleVertexShader.vert", "SimpleFragmentShader.frag" );
@@ -46,7 +36,7 @@ bool InitGL(size_t Width, size_t Height)
     };
     
     glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
 
     return true;
@@ -63,11 +53,11 @@ void DrawGLScene(void)
     glClear( GL_COLOR_BUFFER_BIT );
 
     // Use our shader
-    glUseProgram(programID);
+    StateUseProgram(programID);
 
     // 1rst attribute buffer : vertices
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateEnableVertexAttribArray(0);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glVertexAttribPointer(
         0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
         3,                  // size
@@ -79,8 +69,6 @@ void DrawGLScene(void)
 
     // Draw the triangle !
     glDrawArrays(GL_TRIANGLES, 0, 3); // 3 indices starting at 0 -> 1 triangle
-
-    glDisableVertexAttribArray(0);
 }
 
 void DeInitGL(void)
@@ -91,3 +79,7 @@ void DeInitGL(void)
     glDeleteProgram(programID);
     return;
 }
+
+} // namespace test1_red_triangle
+
+REGISTER_SCENE(test1_red_triangle);
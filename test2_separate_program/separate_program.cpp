@@ -2,7 +2,10 @@
 #include <GL/glew.h>
 
 #include <common/shader.hpp>
+#include <common/pipeline_cache.h>
 #include <common/main.h>
+#include <common/scene.h>
+#include <common/state_cache.h>
 
 
 #ifdef _WIN32
@@ -13,6 +16,8 @@
 #endif
 #endif
 
+namespace test2_separate_program {
+
 GLuint vertexbuffer;
 GLuint VertexArrayID;
 GLuint programID;
@@ -90,65 +95,20 @@ GLuint SeparateProgramName[MAX];
 
 bool InitSeparateProgram()
 {
-    bool Validated = true;
+    // VS, TCS, TES, GS, FS
+    static const std::string filenames[MAX] = { "SepVertexShader.vert", "", "", "", "SepFragmentShader.frag" };
+    PipelineName = CreateSeparablePipeline(filenames, SeparateProgramName);
 
-    if (Validated)
-    {
-        std::string VertexSourceContent = FileContentsToString("SepVertexShader.vert");
-        char const* VertexSourcePointer = VertexSourceContent.c_str();
-        SeparateProgramName[VERTEX] = glCreateShaderProgramv(GL_VERTEX_SHADER, 1, &VertexSourcePointer);
-    }
-
-    if (Validated)
-    {
-        std::string FragmentSourceContent = FileContentsToString("SepFragmentShader.frag");
-        char const* FragmentSourcePointer = FragmentSourceContent.c_str();
-        SeparateProgramName[FRAGMENT] = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, &FragmentSourcePointer);
-    }
-
-    if (Validated)
-    {
-        Validated = Validated && CheckProgram(SeparateProgramName[VERTEX]);
-        Validated = Validated && CheckProgram(SeparateProgramName[FRAGMENT]);
-    }
-
-    if (Validated)
-    {
-        glGenProgramPipelines(1, &PipelineName);
-        glUseProgramStages(PipelineName, GL_VERTEX_SHADER_BIT, SeparateProgramName[VERTEX]);
-        glUseProgramStages(PipelineName, GL_FRAGMENT_SHADER_BIT, SeparateProgramName[FRAGMENT]);
-    }
-
-    if (Validated)
-    {
-        //SeparateUniformMVP = glGetUniformLocation(SeparateProgramName[program::VERTEX], "MVP");
-        //SeparateUniformDiffuse = glGetUniformLocation(SeparateProgramName[program::FRAGMENT], "Diffuse");
-    }
-
-    return Validated && CheckError("initProgram");
+    return PipelineName != 0 && CheckError("initProgram");
 }
 
 bool InitGL(size_t Width, size_t Height)
 {
-    // Initialize GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK)
-    {
-        error("Failed to initialize GLEW\n");
-        return false;
-    }
-
-    const char* versionGL = "\0";
-    versionGL = (char*)(glGetString(GL_VERSION));
-    log("OpenGL version: %s\n", versionGL);
-    log("GLEW version: %d.%d.%d.%d\n",  GLEW_VERSION, GLEW_VERSION_MAJOR,
-                                        GLEW_VERSION_MINOR, GLEW_VERSION_MICRO);
-
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
     glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
 
     // Create and compile our GLSL program from the shaders
     if (!useSep)
@@ -168,7 +128,7 @@ bool InitGL(size_t Width, size_t Height)
     };
     
     glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
 
     return true;
@@ -187,17 +147,17 @@ void DrawGLScene(void)
     // Use our shader
     if (!useSep)
     {
-        glUseProgram(programID);
+        StateUseProgram(programID);
     }
     else
     {
-        glUseProgram(0);
-        glBindProgramPipeline(PipelineName);
+        StateUseProgram(0);
+        StateBindProgramPipeline(PipelineName);
     }
 
     // 1rst attribute buffer : vertices
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateEnableVertexAttribArray(0);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glVertexAttribPointer(
         0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
         3,                  // size
@@ -209,17 +169,6 @@ void DrawGLScene(void)
 
     // Draw the triangle !
     glDrawArrays(GL_TRIANGLES, 0, 3); // 3 indices starting at 0 -> 1 triangle
-
-    glDisableVertexAttribArray(0);
-
-    if (!useSep)
-    {
-        glUseProgram(0);
-    }
-    else
-    {
-        glBindProgramPipeline(0);
-    }
 }
 
 
@@ -229,14 +178,15 @@ void DeInitGL(void)
     glDeleteBuffers(1, &vertexbuffer);
     glDeleteVertexArrays(1, &VertexArrayID);
 
+    // With --sep the pipeline cache owns the pipeline and its stages.
     if (!useSep)
     {
         glDeleteProgram(programID);
     }
-    else
-    {
-        glDeleteProgramPipelines(1, &PipelineName);
-    }
 
     return;
 }
+
+} // namespace test2_separate_program
+
+REGISTER_SCENE(test2_separate_program);
@@ -2,7 +2,10 @@
 #include <GL/glew.h>
 
 #include <common/shader.hpp>
+#include <common/pipeline_cache.h>
 #include <common/main.h>
+#include <common/scene.h>
+#include <common/state_cache.h>
 
 #ifdef _WIN32
 #include <common/_getopt.h>
@@ -12,6 +15,8 @@
 #endif
 #endif
 
+namespace test4_tess {
+
 GLuint vertexbuffer;
 GLuint VertexArrayID;
 GLuint programID;
@@ -88,85 +93,22 @@ GLuint SeparateProgramName[MAX];
 
 bool InitSeparateProgram()
 {
-    bool Validated = true;
-
     log("Init Separate Program!\n");
 
-    if (Validated)
-    {
-        std::string VertexSourceContent = FileContentsToString("SepVertexShader.vert");
-        char const* VertexSourcePointer = VertexSourceContent.c_str();
-        SeparateProgramName[VERTEX] = glCreateShaderProgramv(GL_VERTEX_SHADER, 1, &VertexSourcePointer);
-    }
-
-    if (Validated)
-    {
-        std::string TcsSourceContent = FileContentsToString("SepTcsShader.tesc");
-        char const* TcsSourcePointer = TcsSourceContent.c_str();
-        SeparateProgramName[TESS_CONTROL] = glCreateShaderProgramv(GL_TESS_CONTROL_SHADER, 1, &TcsSourcePointer);
-    }
-
-    if (Validated)
-    {
-        std::string TesSourceContent = FileContentsToString("SepTesShader.tese");
-        char const* TesSourcePointer = TesSourceContent.c_str();
-        SeparateProgramName[TESS_EVALUATION] = glCreateShaderProgramv(GL_TESS_EVALUATION_SHADER, 1, &TesSourcePointer);
-    }
-
-    if (Validated)
-    {
-        std::string FragmentSourceContent = FileContentsToString("SepFragmentShader.frag");
-        char const* FragmentSourcePointer = FragmentSourceContent.c_str();
-        SeparateProgramName[FRAGMENT] = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, &FragmentSourcePointer);
-    }
-
-    if (Validated)
-    {
-        Validated = Validated && CheckProgram(SeparateProgramName[VERTEX]);
-        Validated = Validated && CheckProgram(SeparateProgramName[TESS_CONTROL]);
-        Validated = Validated && CheckProgram(SeparateProgramName[TESS_EVALUATION]);
-        Validated = Validated && CheckProgram(SeparateProgramName[FRAGMENT]);
-    }
-
-    if (Validated)
-    {
-        glGenProgramPipelines(1, &PipelineName);
-        glUseProgramStages(PipelineName, GL_VERTEX_SHADER_BIT, SeparateProgramName[VERTEX]);
-        glUseProgramStages(PipelineName, GL_TESS_CONTROL_SHADER_BIT, SeparateProgramName[TESS_CONTROL]);
-        glUseProgramStages(PipelineName, GL_TESS_EVALUATION_SHADER_BIT, SeparateProgramName[TESS_EVALUATION]);
-        glUseProgramStages(PipelineName, GL_FRAGMENT_SHADER_BIT, SeparateProgramName[FRAGMENT]);
-    }
+    // VS, TCS, TES, GS, FS
+    static const std::string filenames[MAX] = { "SepVertexShader.vert", "SepTcsShader.tesc", "SepTesShader.tese", "", "SepFragmentShader.frag" };
+    PipelineName = CreateSeparablePipeline(filenames, SeparateProgramName);
 
-    if (Validated)
-    {
-        //SeparateUniformMVP = glGetUniformLocation(SeparateProgramName[program::VERTEX], "MVP");
-        //SeparateUniformDiffuse = glGetUniformLocation(SeparateProgramName[program::FRAGMENT], "Diffuse");
-    }
-
-    return Validated && CheckError("initProgram");
+    return PipelineName != 0 && CheckError("initProgram");
 }
 
 bool InitGL(size_t Width, size_t Height)
 {
-    // Initialize GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK)
-    {
-        error("Failed to initialize GLEW\n");
-        return false;
-    }
-
-    const char* versionGL = "\0";
-    versionGL = (char*)(glGetString(GL_VERSION));
-    log("OpenGL version: %s\n", versionGL);
-    log("GLEW version: %d.%d.%d.%d\n",  GLEW_VERSION, GLEW_VERSION_MAJOR,
-                                        GLEW_VERSION_MINOR, GLEW_VERSION_MICRO);
-
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
     glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
 
     // Create and compile our GLSL program from the shaders
     if (!useSep)
@@ -187,12 +129,12 @@ bool InitGL(size_t Width, size_t Height)
     };
     
     glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
 
     if (enWireFrame)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        StatePolygonMode(GL_LINE);
     }
 
     glPatchParameteri(GL_PATCH_VERTICES, 3);
@@ -217,17 +159,17 @@ void DrawGLScene(void)
     // Use our shader
     if (!useSep)
     {
-        glUseProgram(programID);
+        StateUseProgram(programID);
     }
     else
     {
-        glUseProgram(0);
-        glBindProgramPipeline(PipelineName);
+        StateUseProgram(0);
+        StateBindProgramPipeline(PipelineName);
     }
 
     // 1rst attribute buffer : vertices
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateEnableVertexAttribArray(0);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glVertexAttribPointer(
         0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
         3,                  // size
@@ -239,17 +181,6 @@ void DrawGLScene(void)
 
     // Draw the triangle !
     glDrawArrays(GL_PATCHES, 0, 3);
-
-    glDisableVertexAttribArray(0);
-
-    if (!useSep)
-    {
-        glUseProgram(0);
-    }
-    else
-    {
-        glBindProgramPipeline(0);
-    }
 }
 
 
@@ -259,14 +190,15 @@ void DeInitGL(void)
     glDeleteBuffers(1, &vertexbuffer);
     glDeleteVertexArrays(1, &VertexArrayID);
 
+    // With --sep the pipeline cache owns the pipeline and its stages.
     if (!useSep)
     {
         glDeleteProgram(programID);
     }
-    else
-    {
-        glDeleteProgramPipelines(1, &PipelineName);
-    }
 
     return;
 }
+
+} // namespace test4_tess
+
+REGISTER_SCENE(test4_tess);
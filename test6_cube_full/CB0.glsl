@@ -0,0 +1,5 @@
+// Vertex color scale of the vertex shaders, bound to UBO binding 1 by InitGL.
+uniform CB0
+{
+	vec3 diffuseColor;
+} cb0;
@@ -17,6 +17,10 @@ out gl_PerVertex
 // Values that stay constant for the whole mesh.
 uniform mat4 MVP;
 
+#ifdef USE_UBO
+#include "CB0.glsl"
+#endif
+
 void main(){	
 
 	// Output position of the vertex, in clip space : MVP * position
@@ -24,6 +28,10 @@ void main(){
 
 	// The color of each vertex will be interpolated
 	// to produce the color of each fragment
+#ifdef USE_UBO
+	Out.Color = vertexColor * cb0.diffuseColor;
+#else
 	Out.Color = vertexColor;
+#endif
 }
 
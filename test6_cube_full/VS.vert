@@ -17,10 +17,18 @@ out gl_PerVertex
 
 uniform mat4 MV;
 
+#ifdef USE_UBO
+#include "CB0.glsl"
+#endif
+
 void main(){	
 
 	gl_Position =  MV * vec4(vertexPosition_modelspace,1);
 	Out.Center = MV[3];
+#ifdef USE_UBO
+	Out.Color = vertexColor * cb0.diffuseColor;
+#else
 	Out.Color = vertexColor;
+#endif
 }
 
@@ -1,10 +1,23 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
 // Include GLEW
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
 #include <common/shader.hpp>
+#include <common/hot_reload.h>
+#include <common/pipeline_cache.h>
+#include <common/program_reflection.h>
+#include <common/benchmark.h>
 #include <common/main.h>
+#include <common/scene.h>
+#include <common/state_cache.h>
+#include <common/gpu_timer.h>
+#include <common/pacing.h>
 
 #ifdef _WIN32
 #include <common/_getopt.h>
@@ -14,29 +27,26 @@
 #endif
 #endif
 
+namespace test6_cube_full {
+
 GLuint vertexbuffer = -1;
 GLuint VertexArrayID = -1;
 GLuint colorbuffer = -1;
 GLuint elementsbuffer = -1;
 GLuint elementCount = 0;
-GLuint programID = -1;
 glm::mat4 MVP;
-GLuint uniformMVP = -1;
 glm::mat4 MV;
-GLuint uniformMV = -1;
 glm::mat4 P;
-GLuint uniformP = -1;
-GLuint uniformTessLevel = -1;
-GLuint uniformNormScale = -1;
-GLuint ubo_cb0 = -1;
-GLuint ubo_cb1 = -1;
-GLuint ubo_cb2 = -1;
-GLuint ubo_cb3 = -1;
+GLuint ubo_cb0 = 0;
+GLuint ubo_cb1 = 0;
+GLuint ubo_cb2 = 0;
+GLuint ubo_cb3 = 0;
 
 static int enWireFrame = 0;
 static int verboseFlag = 0;
 static int useSep = 0;
 static int useGS = 0, useUBO = 0, useTess = 0;
+static int switchFrames = 0;
 
 void ProcessCommandLine(int argc, char* argv[])
 {
@@ -59,6 +69,8 @@ void ProcessCommandLine(int argc, char* argv[])
         {"tess",    no_argument, 0, 't'},
         // Enable All features except separate shader objects.
         {"all",     no_argument, 0, 'a'},
+        // Cycle through all 8 GS/UBO/Tess combinations, one every N frames.
+        {"switch",  required_argument, 0, 'w'},
 
         {"help",    no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -69,7 +81,7 @@ void ProcessCommandLine(int argc, char* argv[])
     {
         /* getopt_long stores the option index here. */
         int option_index = 0;
-        c = getopt_long(argc, argv, "aghstuv", long_options, &option_index);
+        c = getopt_long(argc, argv, "aghstuvw:", long_options, &option_index);
 
         /* Detect the end of the options. */
         if (c == -1)
@@ -99,6 +111,9 @@ void ProcessCommandLine(int argc, char* argv[])
         case 'a':
             useGS = useUBO = useTess = 1;
             break;
+        case 'w':
+            switchFrames = atoi(optarg);
+            break;
 
         case 's':
             useSep = 1;
@@ -115,6 +130,7 @@ void ProcessCommandLine(int argc, char* argv[])
                 "  --gs, -g      : Enable GS; default pipeline is VS/FS\n"
                 "  --tess, -t    : Enable Tessellation.\n"
                 "  --all, -a     : Enable All features except separate shader objects.\n"
+                "  --switch N, -w N : Cycle through the 8 GS/UBO/Tess combinations, one every N frames.\n"
                 "  --help, -h    : Print this help.\n");
             break;
 
@@ -130,256 +146,199 @@ void ProcessCommandLine(int argc, char* argv[])
 
 
 
-GLuint SeparateProgramName[MAX];
-GLuint PipelineName = -1;
-
-bool InitSeparateProgram()
+// One combination of the GS/UBO/Tess features. With --switch all 8 are built up front,
+// so switching only binds another program or pipeline; otherwise just the selected one.
+struct CubeVariant
 {
-    bool Validated = true;
-    log("Init Separate Program!\n");
-
-    std::string vsFile = "SimpleVertexShader.vert";
-    std::string tcsFile = "";
-    std::string tesFile = "";
-    std::string gsFile = "";
-    if (!useUBO)
-    {
-        if (!useGS)
-        {
-            if (!useTess)
-            {
-            }
-            else
-            {
-                vsFile = "VS.vert";
-                tcsFile = "Tcs.tesc";
-                tesFile = "Tes.tese";
-            }
-        }
-        else
-        {
-            if (!useTess)
-            {
-                vsFile = "VS.vert";
-                gsFile = "GS.geom";
-            }
-            else
-            {
-                vsFile = "VS.vert";
-                tcsFile = "Tcs.tesc";
-                tesFile = "TesForGS.tese";
-                gsFile = "GS.geom";
-            }
-        }
-    }
-    else
-    {
-        if (!useGS)
-        {
-            if (!useTess)
-            {
-                vsFile = "UBOSimpleVS.vert";
-            }
-            else
-            {
-                vsFile = "UBOVS.vert";
-                tcsFile = "UBOTcs.tesc";
-                tesFile = "UBOTes.tese";
-            }
-        }
-        else
-        {
-            if (!useTess)
-            {
-                vsFile = "UBOVS.vert";
-                gsFile = "UBOGS.geom";
-            }
-            else
-            {
-                vsFile = "UBOVS.vert";
-                tcsFile = "UBOTcs.tesc";
-                tesFile = "UBOTesForGS.tese";
-                gsFile = "UBOGS.geom";
-            }
-        }
-    }
+    int     gs, ubo, tess;
+    bool    built;
+    GLuint  program;                ///< monolithic program; 0 with --sep
+    GLuint  pipeline;               ///< --sep, owned by the pipeline cache
+    GLuint  stages[MAX];            ///< --sep, 0 for the stages the variant does not use
+    UniformHandle uniformMVP, uniformMV, uniformP, uniformTessLevel, uniformNormScale;
+};
+
+static CubeVariant variants[8];
+static int currentVariant = 0;
+static int framesInVariant = 0;
+
+// --switch benchmark: CPU time from binding the program or pipeline through the draw,
+// which is where drivers validate and emit the state of a switch. The first draw of every
+// variant is left out: drivers finish compiling there.
+struct SwitchStats
+{
+    uint32  switches;
+    std::vector<float64> switchUs;  ///< frames that switched variant
+    std::vector<float64> steadyUs;  ///< the others
+    bool    drawn[8];
+};
 
-    glGenProgramPipelines(1, &PipelineName);
+static SwitchStats switchStats;
 
-    if (Validated)
-    {
-        std::string VertexSourceContent = FileContentsToString(vsFile);
-        char const* VertexSourcePointer = VertexSourceContent.c_str();
-        SeparateProgramName[VERTEX] = glCreateShaderProgramv(GL_VERTEX_SHADER, 1, &VertexSourcePointer);
-    }
+static int VariantIndex(int _gs, int _ubo, int _tess)
+{
+    return (_gs ? 1 : 0) | (_ubo ? 2 : 0) | (_tess ? 4 : 0);
+}
 
-    if (Validated && useTess)
-    {
-        std::string TcsSourceContent = FileContentsToString(tcsFile);
-        char const* TcsSourcePointer = TcsSourceContent.c_str();
-        SeparateProgramName[TESS_CONTROL] = glCreateShaderProgramv(GL_TESS_CONTROL_SHADER, 1, &TcsSourcePointer);
-        CheckProgram(SeparateProgramName[TESS_CONTROL]);
-        glUseProgramStages(PipelineName, GL_TESS_CONTROL_SHADER_BIT, SeparateProgramName[TESS_CONTROL]);
-    }
+// Shader permutation of the variant. Every stage file handles all of them; defines a
+// stage does not use are dropped, so e.g. the fragment shader is shared.
+static std::string ShaderDefines(const CubeVariant& _variant)
+{
+    std::string defines;
+    if (_variant.ubo)
+        defines += "#define USE_UBO 1\n";
+    if (_variant.gs)
+        defines += "#define WITH_GS 1\n";
+    return defines;
+}
 
-    if (Validated && useTess)
-    {
-        std::string TesSourceContent = FileContentsToString(tesFile);
-        char const* TesSourcePointer = TesSourceContent.c_str();
-        SeparateProgramName[TESS_EVALUATION] = glCreateShaderProgramv(GL_TESS_EVALUATION_SHADER, 1, &TesSourcePointer);
-        CheckProgram(SeparateProgramName[TESS_EVALUATION]);
-        glUseProgramStages(PipelineName, GL_TESS_EVALUATION_SHADER_BIT, SeparateProgramName[TESS_EVALUATION]);
-    }
+// VS, TCS, TES, GS, FS of the variant; "" for the stages it does not use.
+static void CubeStageFiles(const CubeVariant& _variant, std::string (&_filenames)[MAX])
+{
+    _filenames[VERTEX] = (_variant.gs || _variant.tess) ? "VS.vert" : "SimpleVertexShader.vert";
+    _filenames[TESS_CONTROL] = _variant.tess ? "Tcs.tesc" : "";
+    _filenames[TESS_EVALUATION] = _variant.tess ? "Tes.tese" : "";
+    _filenames[GEOMETRY] = _variant.gs ? "GS.geom" : "";
+    _filenames[FRAGMENT] = "SimpleFragmentShader.frag";
+}
 
-    if (Validated && useGS)
+// The monolithic program of the variant.
+static ProgramDesc CubeProgramDesc(const CubeVariant& _variant)
+{
+    static const GLenum stageTypes[MAX] =
     {
-        std::string GeometrySourceContent = FileContentsToString(gsFile);
-        char const* GeometrySourcePointer = GeometrySourceContent.c_str();
-        SeparateProgramName[GEOMETRY] = glCreateShaderProgramv(GL_GEOMETRY_SHADER, 1, &GeometrySourcePointer);
-        CheckProgram(SeparateProgramName[GEOMETRY]);
-        glUseProgramStages(PipelineName, GL_GEOMETRY_SHADER_BIT, SeparateProgramName[GEOMETRY]);
-    }
+        GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER
+    };
+    std::string filenames[MAX];
+    CubeStageFiles(_variant, filenames);
 
-    if (Validated)
+    ProgramDesc desc;
+    for (int i = 0; i < MAX; i++)
     {
-        std::string FragmentSourceContent = FileContentsToString("SimpleFragmentShader.frag");
-        char const* FragmentSourcePointer = FragmentSourceContent.c_str();
-        SeparateProgramName[FRAGMENT] = glCreateShaderProgramv(GL_FRAGMENT_SHADER, 1, &FragmentSourcePointer);
+        if (!filenames[i].empty())
+        {
+            desc.Stage(stageTypes[i], filenames[i]);
+        }
     }
+    desc.shaderPrefix = ShaderDefines(_variant);
+    return desc;
+}
 
-    if (Validated)
-    {
-        Validated = Validated && CheckProgram(SeparateProgramName[VERTEX]);
-        Validated = Validated && CheckProgram(SeparateProgramName[FRAGMENT]);
-    }
+// Uniform block binding points of CB0..CB3; the buffers stay bound there for every variant.
+static const uint32 uniformBlockHashes[] =
+{
+    ReflectionHash("CB0"), ReflectionHash("CB1"), ReflectionHash("CB2"), ReflectionHash("CB3")
+};
+static const GLuint uniformBlockBindings[] = { 1, 2, 3, 4 };
+
+static GLuint CreateUniformBuffer(GLuint _binding, const void* _data, GLsizeiptr _size)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    StateBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, _size, _data, GL_DYNAMIC_DRAW);
+    StateBindBuffer(GL_UNIFORM_BUFFER, 0);
+    StateBindBufferBase(GL_UNIFORM_BUFFER, _binding, buffer);
+    return buffer;
+}
 
-    if (Validated)
+// Bind the variant's blocks and resolve its uniforms from the reflection of its program or
+// pipeline; with --sep a uniform's handle lists every stage program declaring it. The frame
+// only uses the handles.
+static void ResolveVariant(CubeVariant& _variant)
+{
+    const ProgramReflection& reflection = useSep ? ReflectPipeline(_variant.pipeline) : ReflectProgram(_variant.program);
+    for (size_t i = 0; i < ArraySize(uniformBlockHashes); i++)
     {
-        glUseProgramStages(PipelineName, GL_VERTEX_SHADER_BIT, SeparateProgramName[VERTEX]);
-        glUseProgramStages(PipelineName, GL_FRAGMENT_SHADER_BIT, SeparateProgramName[FRAGMENT]);
-        ValidateProgramPipeline(PipelineName);
+        BindUniformBlock(reflection, uniformBlockHashes[i], uniformBlockBindings[i]);
     }
 
-    return Validated && CheckError("initProgram");
+    _variant.uniformMVP = GetUniformHandle(reflection, ReflectionHash("MVP"));
+    _variant.uniformMV = GetUniformHandle(reflection, ReflectionHash("MV"));
+    _variant.uniformP = GetUniformHandle(reflection, ReflectionHash("P"));
+    _variant.uniformTessLevel = GetUniformHandle(reflection, ReflectionHash("tessLevel"));
+    _variant.uniformNormScale = GetUniformHandle(reflection, ReflectionHash("normScale"));
 }
 
-
-bool InitGL(size_t Width, size_t Height)
+// --hot-reload replaced a variant's program: handles and block bindings belong to the program.
+static void ProgramReloaded(GLuint _program)
 {
-    // Initialize GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK)
+    for (size_t i = 0; i < ArraySize(variants); i++)
     {
-        error("Failed to initialize GLEW\n");
-        return false;
+        if (variants[i].program == _program)
+        {
+            ResolveVariant(variants[i]);
+        }
     }
+}
 
-    const char* versionGL = "\0";
-    versionGL = (char*)(glGetString(GL_VERSION));
-    log("OpenGL version: %s\n", versionGL);
-    log("GLEW version: %d.%d.%d.%d\n",  GLEW_VERSION, GLEW_VERSION_MAJOR,
-                                        GLEW_VERSION_MINOR, GLEW_VERSION_MICRO);
-
-    // Dark blue background
-    glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
-
-    glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
-
-    // Create and compile our GLSL program from the shaders
-    if (!useSep)
-    {
-        if (!useUBO)
+// Build the variants as one batch of programs, or from the stage and pipeline caches with
+// --sep; either way a stage shared by several variants is compiled once.
+static void InitVariants()
+{
+    int selected = VariantIndex(useGS, useUBO, useTess);
+    std::vector<ProgramDesc> descs;
+    std::vector<GLuint> programs;
+    for (int i = 0; i < int(ArraySize(variants)); i++)
+    {
+        CubeVariant& variant = variants[i];
+        memset(&variant, 0, sizeof(variant));
+        variant.gs = i & 1;
+        variant.ubo = (i >> 1) & 1;
+        variant.tess = (i >> 2) & 1;
+        variant.built = switchFrames > 0 || i == selected;
+        if (!variant.built)
+            continue;
+
+        if (!useSep)
         {
-            if (!useGS)
-            {
-                if (!useTess)
-                {
-                    programID = LoadShaders("SimpleVertexShader.vert", "SimpleFragmentShader.frag");
-                }
-                else
-                {
-                    programID = CreateVSTessFSProgram("VS.vert", "Tcs.tesc",
-                        "Tes.tese", "SimpleFragmentShader.frag");
-                }
-            }
-            else
-            {
-                if (!useTess)
-                {
-                    programID = CreateVSGSFSProgram("VS.vert", "GS.geom", "SimpleFragmentShader.frag");
-                }
-                else
-                {
-                    programID = CreateVSTessGSFSProgram("VS.vert", "Tcs.tesc", "TesForGS.tese",
-                        "GS.geom", "SimpleFragmentShader.frag");
-                }
-            }
+            descs.push_back(CubeProgramDesc(variant));
         }
         else
         {
-            if (!useGS)
-            {
-                if (!useTess)
-                {
-                    programID = LoadShaders("UBOSimpleVS.vert", "SimpleFragmentShader.frag");
-                }
-                else
-                {
-                    programID = CreateVSTessFSProgram("UBOVS.vert", "UBOTcs.tesc",
-                        "UBOTes.tese", "SimpleFragmentShader.frag");
-                }
-            }
-            else
-            {
-                if (!useTess)
-                {
-                    programID = CreateVSGSFSProgram("UBOVS.vert", "UBOGS.geom", "SimpleFragmentShader.frag");
-                }
-                else
-                {
-                    programID = CreateVSTessGSFSProgram("UBOVS.vert", "UBOTcs.tesc", "UBOTesForGS.tese",
-                        "UBOGS.geom", "SimpleFragmentShader.frag");
-                }
-            }
+            std::string filenames[MAX];
+            CubeStageFiles(variant, filenames);
+            variant.pipeline = CreateSeparablePipeline(filenames, variant.stages, ShaderDefines(variant));
+            ResolveVariant(variant);
         }
     }
-    else
-    {
-        InitSeparateProgram();
-    }
 
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    // Handle default UBO
-	// Get a handle for our "MVP" uniform
     if (!useSep)
     {
-        uniformMVP = glGetUniformLocation(programID, "MVP");
-        uniformMV = glGetUniformLocation(programID, "MV");
-        uniformP = glGetUniformLocation(programID, "P");
-        uniformTessLevel = glGetUniformLocation(programID, "tessLevel");
-        uniformNormScale = glGetUniformLocation(programID, "normScale");
-    }
-    else
-    {
-        uniformMVP = glGetUniformLocation(SeparateProgramName[VERTEX], "MVP");
-        uniformMV = glGetUniformLocation(SeparateProgramName[VERTEX], "MV");
-        if (useGS)
+        programs.resize(descs.size());
+        CreatePrograms(descs.data(), descs.size(), programs.data());
+        size_t next = 0;
+        for (size_t i = 0; i < ArraySize(variants); i++)
         {
-            uniformP = glGetUniformLocation(SeparateProgramName[GEOMETRY], "P");
-            uniformNormScale = glGetUniformLocation(SeparateProgramName[GEOMETRY], "normScale");
-        }
+            CubeVariant& variant = variants[i];
+            if (!variant.built)
+                continue;
 
-        if (useTess)
-        {
-            if (!useGS)
+            variant.program = programs[next++];
+            ResolveVariant(variant);
+            if (variant.program)
             {
-                uniformP = glGetUniformLocation(SeparateProgramName[TESS_EVALUATION], "P");
+                WatchProgram(&variant.program, ProgramReloaded);
             }
-            uniformTessLevel = glGetUniformLocation(SeparateProgramName[TESS_CONTROL], "tessLevel");
         }
     }
 
+    currentVariant = selected;
+    framesInVariant = 0;
+    switchStats = SwitchStats();
+}
+
+bool InitGL(size_t Width, size_t Height)
+{
+    // Dark blue background
+    glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+
+    glGenVertexArrays(1, &VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
+
+    // Create and compile our GLSL programs from the shaders
+    InitVariants();
+
 	// Projection matrix : 45° Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	glm::mat4 Projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
 	// Camera matrix
@@ -397,95 +356,17 @@ bool InitGL(size_t Width, size_t Height)
 
 
     /////////////////////////////////////////////////////////////////////////////////////////////
-    // Handle UBO
-    if (useUBO)
-    {
-        GLuint proID = programID;
-
-        if (useSep)
-        {
-            proID = SeparateProgramName[VERTEX];
-        }
-        GLuint uniformBlockSize = 0;
-        GLuint cb0 = glGetUniformBlockIndex(proID, "CB0");  // VS
-        if (cb0 == GL_INVALID_INDEX)
-        {
-            log("UBO CB0: glGetUniformBlockIndex returns GL_INVALID_INDEX.\n");
-        }
-        else
-        {
-            glUniformBlockBinding(proID, cb0, 1);
-            glm::vec3 cb0_diffuse = glm::vec3(0.2, 0.4, 0.6);
-            uniformBlockSize = sizeof(cb0_diffuse);
-            glGenBuffers(1, &ubo_cb0);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo_cb0);
-            glBufferData(GL_UNIFORM_BUFFER, uniformBlockSize, glm::value_ptr(cb0_diffuse), GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
-            glBindBufferBase(GL_UNIFORM_BUFFER, 1, ubo_cb0);
-        }
-
-        if (useSep)
-        {
-            proID = SeparateProgramName[GEOMETRY];
-        }
-        GLuint cb1 = glGetUniformBlockIndex(proID, "CB1");  // GS
-        if (cb1 == GL_INVALID_INDEX)
-        {
-            log("UBO CB1: glGetUniformBlockIndex returns GL_INVALID_INDEX.\n");
-        }
-        else
-        {
-            glUniformBlockBinding(proID, cb1, 2);
-            glm::vec3 cb1_new = glm::vec3(0.6, 0.01, 0.1);
-            uniformBlockSize = sizeof(cb1_new);
-            glGenBuffers(1, &ubo_cb1);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo_cb1);
-            glBufferData(GL_UNIFORM_BUFFER, uniformBlockSize, glm::value_ptr(cb1_new), GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
-            glBindBufferBase(GL_UNIFORM_BUFFER, 2, ubo_cb1);
-        }
-
-        if (useSep)
-        {
-            proID = SeparateProgramName[TESS_CONTROL];
-        }
-        GLuint cb2 = glGetUniformBlockIndex(proID, "CB2");  // TCS Color
-        if (cb2 == GL_INVALID_INDEX)
-        {
-            log("UBO CB2: glGetUniformBlockIndex returns GL_INVALID_INDEX.\n");
-        }
-        else
-        {
-            glUniformBlockBinding(proID, cb2, 3);
-            glm::vec3 cb2_color = glm::vec3(0.1, 0.2, 0.5);
-            uniformBlockSize = sizeof(cb2_color);
-            glGenBuffers(1, &ubo_cb2);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo_cb2);
-            glBufferData(GL_UNIFORM_BUFFER, uniformBlockSize, glm::value_ptr(cb2_color), GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
-            glBindBufferBase(GL_UNIFORM_BUFFER, 3, ubo_cb2);
-        }
-
-        if (useSep)
-        {
-            proID = SeparateProgramName[TESS_EVALUATION];
-        }
-        GLuint cb3 = glGetUniformBlockIndex(proID, "CB3");  // TES
-        if (cb3 == GL_INVALID_INDEX)
-        {
-            log("UBO CB3: glGetUniformBlockIndex returns GL_INVALID_INDEX.\n");
-        }
-        else
-        {
-            glUniformBlockBinding(proID, cb3, 4);
-            GLfloat cb3_scale = 0.7;
-            uniformBlockSize = sizeof(cb3_scale);
-            glGenBuffers(1, &ubo_cb3);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo_cb3);
-            glBufferData(GL_UNIFORM_BUFFER, uniformBlockSize, &(cb3_scale), GL_DYNAMIC_DRAW);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
-            glBindBufferBase(GL_UNIFORM_BUFFER, 4, ubo_cb3);
-        }
+    // Handle UBO: CB0 VS, CB1 GS, CB2 TCS color, CB3 TES
+    if (useUBO || switchFrames)
+    {
+        glm::vec3 cb0_diffuse = glm::vec3(0.2, 0.4, 0.6);
+        ubo_cb0 = CreateUniformBuffer(uniformBlockBindings[0], glm::value_ptr(cb0_diffuse), sizeof(cb0_diffuse));
+        glm::vec3 cb1_new = glm::vec3(0.6, 0.01, 0.1);
+        ubo_cb1 = CreateUniformBuffer(uniformBlockBindings[1], glm::value_ptr(cb1_new), sizeof(cb1_new));
+        glm::vec3 cb2_color = glm::vec3(0.1, 0.2, 0.5);
+        ubo_cb2 = CreateUniformBuffer(uniformBlockBindings[2], glm::value_ptr(cb2_color), sizeof(cb2_color));
+        GLfloat cb3_scale = 0.7;
+        ubo_cb3 = CreateUniformBuffer(uniformBlockBindings[3], &cb3_scale, sizeof(cb3_scale));
     }
 
 
@@ -540,20 +421,20 @@ bool InitGL(size_t Width, size_t Height)
     elementCount = sizeof(g_elements_data) / sizeof(GLuint);
 
     glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
 
     glGenBuffers(1, &colorbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_color_buffer_data), g_color_buffer_data, GL_STATIC_DRAW);
 
     glGenBuffers (1, &elementsbuffer);
-	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, elementsbuffer);
+	StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementsbuffer);
 	glBufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (g_elements_data), g_elements_data, GL_STATIC_DRAW );
 
     // 2nd attribute buffer : colors
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
+    StateEnableVertexAttribArray(1);
+    StateBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
     glVertexAttribPointer(
         1,                                // attribute 1. must match the layout in the shader.
         3,                                // size
@@ -564,8 +445,8 @@ bool InitGL(size_t Width, size_t Height)
     );
 
     // 1st attribute buffer : pos
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateEnableVertexAttribArray(0);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glVertexAttribPointer(
         0,                  // attribute 0. must match the layout in the shader.
         3,                  // size
@@ -576,13 +457,13 @@ bool InitGL(size_t Width, size_t Height)
     );
 
     // Must enable Z test, otherwize the cube will be ugly!!!
-    glEnable (GL_DEPTH_TEST);
+    StateEnable(GL_DEPTH_TEST);
     if (enWireFrame)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        StatePolygonMode(GL_LINE);
     }
 
-    if (useTess)
+    if (useTess || switchFrames)
     {
         glPatchParameteri(GL_PATCH_VERTICES, 3);
     }
@@ -602,109 +483,157 @@ void DrawGLScene(void)
     r = glm::rotate(r, glm::radians(float32(rotation)), glm::vec3(0.0f, 0.0f, 1.0f));
     glm::mat4 m = glm::mat4(1.0f);
 
+    // The cube keeps spinning, so on-demand pacing has to keep drawing.
+    RequestRedraw();
+
+    // The harness' --replay frames keep the variant and stay out of the switch statistics.
+    bool measured = !IsReplayBenchmarkRunning();
+    bool switched = false;
+    if (measured && switchFrames && ++framesInVariant > switchFrames)
+    {
+        currentVariant = (currentVariant + 1) % int(ArraySize(variants));
+        framesInVariant = 1;
+        switched = true;
+        switchStats.switches++;
+    }
+    const CubeVariant& variant = variants[currentVariant];
+
     // Clear the screen
-    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    {
+        GPU_SCOPE("clear");
+        glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    }
 
-    glBindVertexArray(VertexArrayID);
+    uint64 submitBegin = GetTimeNs();
+    StateBindVertexArray(VertexArrayID);
     // Use our shader
     if (!useSep)
     {
-        glUseProgram(programID);
+        StateUseProgram(variant.program);
     }
     else
     {
-        glUseProgram(0);
-        glBindProgramPipeline(PipelineName);
+        StateUseProgram(0);
+        StateBindProgramPipeline(variant.pipeline);
     }
 
-    if (uniformMVP != -1)
+    // Handles list the programs holding the uniform, every stage program declaring it with --sep.
+    const UniformHandle& hMVP = variant.uniformMVP;
+    if (hMVP.count)
     {
-        if (useSep)
+        m = MVP * r;
+        for (uint32 s = 0; s < hMVP.count; s++)
         {
-            glActiveShaderProgram(PipelineName, SeparateProgramName[VERTEX]);
+            glProgramUniformMatrix4fv(hMVP.programs[s], hMVP.locations[s], 1, GL_FALSE, glm::value_ptr(m));
         }
-
-        m = MVP * r;
-        glUniformMatrix4fv(uniformMVP, 1, GL_FALSE, glm::value_ptr(m));
     }
-    if (uniformMV != -1)
+    const UniformHandle& hMV = variant.uniformMV;
+    if (hMV.count)
     {
-        if (useSep)
+        m = MV * r;
+        for (uint32 s = 0; s < hMV.count; s++)
         {
-            glActiveShaderProgram(PipelineName, SeparateProgramName[VERTEX]);
+            glProgramUniformMatrix4fv(hMV.programs[s], hMV.locations[s], 1, GL_FALSE, glm::value_ptr(m));
         }
-
-        m = MV * r;
-        glUniformMatrix4fv(uniformMV, 1, GL_FALSE, glm::value_ptr(m));
     }
-    if (uniformP != -1)
+    const UniformHandle& hP = variant.uniformP;
+    for (uint32 s = 0; s < hP.count; s++)
     {
-        if (useSep)
-        {
-            GLuint program = useGS ? SeparateProgramName[GEOMETRY] : SeparateProgramName[TESS_EVALUATION];
-            glActiveShaderProgram(PipelineName, program);
-        }
-
-        glUniformMatrix4fv(uniformP, 1, GL_FALSE, glm::value_ptr(P));
+        glProgramUniformMatrix4fv(hP.programs[s], hP.locations[s], 1, GL_FALSE, glm::value_ptr(P));
     }
-    if (uniformTessLevel != -1)
+    const UniformHandle& hTessLevel = variant.uniformTessLevel;
+    for (uint32 s = 0; s < hTessLevel.count; s++)
     {
-        if (useSep)
-        {
-            glActiveShaderProgram(PipelineName, SeparateProgramName[TESS_CONTROL]);
-        }
-        glUniform2f(uniformTessLevel, 8.0, 4.0);
+        glProgramUniform2f(hTessLevel.programs[s], hTessLevel.locations[s], 8.0, 4.0);
     }
-    if (uniformNormScale != -1)
+    const UniformHandle& hNormScale = variant.uniformNormScale;
+    if (hNormScale.count)
     {
-        if (useSep)
+        GLfloat tmp = variant.tess ? 0.2 : 0.5;
+        for (uint32 s = 0; s < hNormScale.count; s++)
         {
-            glActiveShaderProgram(PipelineName, SeparateProgramName[GEOMETRY]);
+            glProgramUniform1f(hNormScale.programs[s], hNormScale.locations[s], tmp);
         }
-
-        GLfloat tmp = useTess ? 0.2 : 0.5;
-        glUniform1f(uniformNormScale, tmp);
     }
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    StateEnableVertexAttribArray(0);
+    StateEnableVertexAttribArray(1);
 
     // Draw the cube
-    if (!useTess)
+    if (!variant.tess)
     {
+        GPU_SCOPE("draw");
         glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0);
     }
     else
     {
+        GPU_SCOPE("tess draw");
         glDrawElements(GL_PATCHES, elementCount, GL_UNSIGNED_INT, 0);
     }
+    uint64 submitNs = GetTimeNs() - submitBegin;
 
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    if (!useSep)
+    if (measured && switchStats.drawn[currentVariant])
     {
-        glUseProgram(0);
+        std::vector<float64>& samples = switched ? switchStats.switchUs : switchStats.steadyUs;
+        samples.push_back(float64(submitNs) / 1000.0);
     }
-    else
+    switchStats.drawn[currentVariant] = true;
+}
+
+// Drivers stall a frame now and then (e.g. recompiling for new state), so the median
+// tells more than the mean.
+static void SubmitTimeStats(std::vector<float64>& _samples, float64& _median, float64& _mean)
+{
+    _median = _mean = 0.0;
+    if (_samples.empty())
+        return;
+
+    std::nth_element(_samples.begin(), _samples.begin() + _samples.size() / 2, _samples.end());
+    _median = _samples[_samples.size() / 2];
+    for (size_t i = 0; i < _samples.size(); i++)
     {
-        glBindProgramPipeline(0);
+        _mean += _samples[i];
     }
+    _mean /= _samples.size();
 }
 
 void DeInitGL(void)
 {
+    if (switchFrames)
+    {
+        float64 switchMedian, switchMean, steadyMedian, steadyMean;
+        SubmitTimeStats(switchStats.switchUs, switchMedian, switchMean);
+        SubmitTimeStats(switchStats.steadyUs, steadyMedian, steadyMean);
+        log("Switch benchmark (%s): %u switches. Submit median %.1f us (mean %.1f) on %u switch frames, "
+            "median %.1f us (mean %.1f) on %u other frames",
+            useSep ? "SSO pipelines" : "monolithic programs", switchStats.switches,
+            switchMedian, switchMean, uint32(switchStats.switchUs.size()),
+            steadyMedian, steadyMean, uint32(switchStats.steadyUs.size()));
+    }
+
     // Cleanup VBO
     glDeleteBuffers(1, &vertexbuffer);
+    glDeleteBuffers(1, &colorbuffer);
+    glDeleteBuffers(1, &elementsbuffer);
     glDeleteVertexArrays(1, &VertexArrayID);
-    glDeleteProgram(programID);
 
-    if (ubo_cb0 != -1)
-    {
-        glDeleteBuffers(1, &ubo_cb0);
-    }
-    if (ubo_cb1 != -1)
+    // With --sep the pipeline cache owns the pipelines and their stages.
+    for (size_t i = 0; i < ArraySize(variants); i++)
     {
-        glDeleteBuffers(1, &ubo_cb1);
+        if (variants[i].program)
+        {
+            glDeleteProgram(variants[i].program);
+        }
     }
+
+    glDeleteBuffers(1, &ubo_cb0);
+    glDeleteBuffers(1, &ubo_cb1);
+    glDeleteBuffers(1, &ubo_cb2);
+    glDeleteBuffers(1, &ubo_cb3);
+    ubo_cb0 = ubo_cb1 = ubo_cb2 = ubo_cb3 = 0;
     return;
 }
+
+} // namespace test6_cube_full
+
+REGISTER_SCENE(test6_cube_full);
@@ -4,7 +4,11 @@
 #include <glm/ext.hpp>
 
 #include <common/shader.hpp>
+#include <common/program_reflection.h>
 #include <common/main.h>
+#include <common/scene.h>
+#include <common/state_cache.h>
+#include <common/pacing.h>
 
 #ifdef _WIN32
 #include <common/_getopt.h>
@@ -16,6 +20,8 @@
 
 #include <vector>
 
+namespace test7_mem_stress {
+
 GLuint vertexbuffer = -1;
 GLuint VertexArrayID = -1;
 GLuint colorbuffer = -1;
@@ -23,11 +29,12 @@ GLuint elementsbuffer = -1;
 GLuint elementCount = 0;
 GLuint programID = -1;
 glm::mat4 MVP;
-GLuint uniformMVP = -1;
+UniformHandle uniformMVP = { 0 };
 glm::mat4 MV;
-GLuint uniformMV = -1;
+UniformHandle uniformMV = { 0 };
 glm::mat4 P;
-GLuint uniformP = -1;
+UniformHandle uniformP = { 0 };
+bool hasCB0 = false;
 
 std::vector<GLuint> vUBOId;
 GLfloat* g_pData = NULL;
@@ -116,33 +123,27 @@ void ProcessCommandLine(int argc, char* argv[])
 }
 
 
+// CB0 was bound to binding point 1 in InitGL, when the program was reflected.
 static GLuint UpdateUBO(GLuint size, GLfloat* pData)
 {
-    GLuint proID = programID;
     GLuint ubo = -1;
-    GLuint cb0 = glGetUniformBlockIndex(proID, "CB0");  // VS
-    if (cb0 == GL_INVALID_INDEX)
-    {
-        log("UBO CB0: glGetUniformBlockIndex returns GL_INVALID_INDEX.\n");
-    }
-    else
+    if (hasCB0)
     {
-        glUniformBlockBinding(proID, cb0, 1);
         glGenBuffers(1, &ubo);
-        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        StateBindBuffer(GL_UNIFORM_BUFFER, ubo);
         glBufferData(GL_UNIFORM_BUFFER, size, pData, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 1, ubo);
+        StateBindBuffer(GL_UNIFORM_BUFFER, 0);
+        StateBindBufferBase(GL_UNIFORM_BUFFER, 1, ubo);
     }
 
-    //GLuint cb1 = glGetUniformBlockIndex(proID, "CB1");  // FS
+    //GLuint cb1 = glGetUniformBlockIndex(programID, "CB1");  // FS
     //if (cb1 == GL_INVALID_INDEX)
     //{
     //    log("UBO CB1: glGetUniformBlockIndex returns GL_INVALID_INDEX.\n");
     //}
     //else
     //{
-    //    glUniformBlockBinding(proID, cb1, 2);
+    //    glUniformBlockBinding(programID, cb1, 2);
     //    glm::vec3 cb1_new = glm::vec3(0.6, 0.01, 0.1);
     //    uniformBlockSize = sizeof(cb1_new);
     //    glGenBuffers(1, &ubo_cb1);
@@ -157,25 +158,11 @@ static GLuint UpdateUBO(GLuint size, GLfloat* pData)
 
 bool InitGL(size_t Width, size_t Height)
 {
-    // Initialize GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK)
-    {
-        error("Failed to initialize GLEW\n");
-        return false;
-    }
-
-    const char* versionGL = "\0";
-    versionGL = (char*)(glGetString(GL_VERSION));
-    log("OpenGL version: %s\n", versionGL);
-    log("GLEW version: %d.%d.%d.%d\n",  GLEW_VERSION, GLEW_VERSION_MAJOR,
-                                        GLEW_VERSION_MINOR, GLEW_VERSION_MICRO);
-
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
     glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
 
     // Create and compile our GLSL program from the shaders
     programID = LoadShaders("VS.vert", "FS.frag");
@@ -184,9 +171,16 @@ bool InitGL(size_t Width, size_t Height)
     // Handle default UBO
 	// Get a handle for our "MVP" uniform
 
-    uniformMVP = glGetUniformLocation(programID, "MVP");
-    uniformMV = glGetUniformLocation(programID, "MV");
-    uniformP = glGetUniformLocation(programID, "P");
+    const ProgramReflection& reflection = ReflectProgram(programID);
+    uniformMVP = GetUniformHandle(reflection, ReflectionHash("MVP"));
+    uniformMV = GetUniformHandle(reflection, ReflectionHash("MV"));
+    uniformP = GetUniformHandle(reflection, ReflectionHash("P"));
+
+    hasCB0 = BindUniformBlock(reflection, ReflectionHash("CB0"), 1);  // FS
+    if (!hasCB0)
+    {
+        log("UBO CB0: the program has no uniform block CB0, no UBO is allocated.\n");
+    }
 
 	// Projection matrix : 45° Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
 	glm::mat4 Projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
@@ -254,20 +248,20 @@ bool InitGL(size_t Width, size_t Height)
     elementCount = sizeof(g_elements_data) / sizeof(GLuint);
 
     glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
 
     glGenBuffers(1, &colorbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
+    StateBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
     glBufferData(GL_ARRAY_BUFFER, sizeof(g_color_buffer_data), g_color_buffer_data, GL_STATIC_DRAW);
 
     glGenBuffers (1, &elementsbuffer);
-	glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, elementsbuffer);
+	StateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementsbuffer);
 	glBufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (g_elements_data), g_elements_data, GL_STATIC_DRAW );
 
     // 2nd attribute buffer : colors
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
+    StateEnableVertexAttribArray(1);
+    StateBindBuffer(GL_ARRAY_BUFFER, colorbuffer);
     glVertexAttribPointer(
         1,                                // attribute 1. must match the layout in the shader.
         3,                                // size
@@ -278,8 +272,8 @@ bool InitGL(size_t Width, size_t Height)
     );
 
     // 1st attribute buffer : pos
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    StateEnableVertexAttribArray(0);
+    StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glVertexAttribPointer(
         0,                  // attribute 0. must match the layout in the shader.
         3,                  // size
@@ -290,10 +284,10 @@ bool InitGL(size_t Width, size_t Height)
     );
 
     // Must enable Z test, otherwize the cube will be ugly!!!
-    glEnable (GL_DEPTH_TEST);
+    StateEnable(GL_DEPTH_TEST);
     if (enWireFrame)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        StatePolygonMode(GL_LINE);
     }
 
     allocLoopCount = totalUboSize / uboSize + 1;
@@ -313,12 +307,15 @@ void DrawGLScene(void)
     r = glm::rotate(r, glm::radians(float32(rotation)), glm::vec3(0.0f, 0.0f, 1.0f));
     glm::mat4 m = glm::mat4(1.0f);
 
+    // The cube keeps spinning, so on-demand pacing has to keep drawing.
+    RequestRedraw();
+
     // Clear the screen
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
-    glBindVertexArray(VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
 
-    glUseProgram(programID);
+    StateUseProgram(programID);
 
     static GLuint index = 0;
     static float32 angle = 0.3f;
@@ -334,30 +331,32 @@ void DrawGLScene(void)
         index++;
     }
 
-    if (uniformMVP != -1)
+    if (uniformMVP.count)
     {
         m = MVP * r;
-        glUniformMatrix4fv(uniformMVP, 1, GL_FALSE, glm::value_ptr(m));
+        for (uint32 s = 0; s < uniformMVP.count; s++)
+        {
+            glProgramUniformMatrix4fv(uniformMVP.programs[s], uniformMVP.locations[s], 1, GL_FALSE, glm::value_ptr(m));
+        }
     }
-    if (uniformMV != -1)
+    if (uniformMV.count)
     {
         m = MV * r;
-        glUniformMatrix4fv(uniformMV, 1, GL_FALSE, glm::value_ptr(m));
+        for (uint32 s = 0; s < uniformMV.count; s++)
+        {
+            glProgramUniformMatrix4fv(uniformMV.programs[s], uniformMV.locations[s], 1, GL_FALSE, glm::value_ptr(m));
+        }
     }
-    if (uniformP != -1)
+    for (uint32 s = 0; s < uniformP.count; s++)
     {
-        glUniformMatrix4fv(uniformP, 1, GL_FALSE, glm::value_ptr(P));
+        glProgramUniformMatrix4fv(uniformP.programs[s], uniformP.locations[s], 1, GL_FALSE, glm::value_ptr(P));
     }
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    StateEnableVertexAttribArray(0);
+    StateEnableVertexAttribArray(1);
 
     // Draw the cube
     glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0);
-
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glUseProgram(0);
 }
 
 void DeInitGL(void)
@@ -376,3 +375,7 @@ void DeInitGL(void)
 
     return;
 }
+
+} // namespace test7_mem_stress
+
+REGISTER_SCENE(test7_mem_stress);
@@ -4,6 +4,8 @@
 
 #include <common/shader.hpp>
 #include <common/main.h>
+#include <common/scene.h>
+#include <common/state_cache.h>
 
 #ifdef _WIN32
 #include <common/_getopt.h>
@@ -13,6 +15,8 @@
 #endif
 #endif
 
+namespace test8_compat_triangle {
+
 GLuint vertexbuffer;
 GLuint VertexArrayID;
 GLuint programID;
@@ -93,25 +97,11 @@ void ProcessCommandLine(int argc, char* argv[])
 
 bool InitGL(size_t Width, size_t Height)
 {
-    // Initialize GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK)
-    {
-        error("Failed to initialize GLEW\n");
-        return false;
-    }
-
-    const char* versionGL = "\0";
-    versionGL = (char*)(glGetString(GL_VERSION));
-    log("OpenGL version: %s\n", versionGL);
-    log("GLEW version: %d.%d.%d.%d\n",  GLEW_VERSION, GLEW_VERSION_MAJOR,
-                                        GLEW_VERSION_MINOR, GLEW_VERSION_MICRO);
-
     // Dark blue background
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 
     glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    StateBindVertexArray(VertexArrayID);
 
     // Create and compile our GLSL program from the shaders
     //programID = LoadShaders( "SimpleVertexShader.vert", "SimpleFragmentShader.frag" );
@@ -133,7 +123,7 @@ bool InitGL(size_t Width, size_t Height)
     if (!bBeginEnd)
     {
         glGenBuffers(1, &vertexbuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+        StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
         glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
     }
 
@@ -151,7 +141,7 @@ void DrawGLScene(void)
     glClear( GL_COLOR_BUFFER_BIT );
 
     // Use our shader
-    glUseProgram(programID);
+    StateUseProgram(programID);
 
     if (bBeginEnd)
     {
@@ -185,8 +175,8 @@ void DrawGLScene(void)
     else
     {
         // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+        StateEnableVertexAttribArray(0);
+        StateBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
         glVertexAttribPointer(
             0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
             3,                  // size
@@ -198,8 +188,6 @@ void DrawGLScene(void)
 
         // Draw the triangle !
         glDrawArrays(GL_TRIANGLES, 0, 3); // 3 indices starting at 0 -> 1 triangle
-
-        glDisableVertexAttribArray(0);
     }
 }
 
@@ -211,3 +199,7 @@ void DeInitGL(void)
     glDeleteProgram(programID);
     return;
 }
+
+} // namespace test8_compat_triangle
+
+REGISTER_SCENE(test8_compat_triangle);